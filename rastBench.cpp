@@ -0,0 +1,186 @@
+#include "helper.h"
+extern "C"{
+#include "rasterizer.h"
+#include "rast_types.h"
+#include "zbuff.h"
+}
+
+#include <chrono>
+
+using namespace std;
+
+/*
+
+   Rast Bench
+     Common throughput driver for the gold models. regress -b builds
+     it against each submission's gold directory in place of
+     rastTest.cpp, so the same loops time every implementation of
+
+       triangle  rasterize_triangle into a fresh z-buffer
+       setup     triangle_setup + rasterize_triangle_setup, for gold
+                 models that have them (-DBENCH_SETUP)
+       bbox      get_bounding_box
+       sample    sample_test on the grid of each bounding box, at
+                 most BENCH_SAMPLES per triangle
+
+     over the valid triangles of each vector, at each MSAA level in
+     place of the one in the vector header. bbox and sample repeat
+     their loop for at least BENCH_MIN_SECONDS, which would otherwise
+     be too short to time. Every repetition prints
+
+       BENCH <vector> <engine> <msaa> <rep> <calls> <samples> <seconds>
+
+     where samples are the grid samples of the bounding boxes the
+     calls covered; regress turns them into the leaderboard.
+
+     Build (from a gold directory):
+       gcc -O2 -c rasterizer.c zbuff.c
+       g++ -O2 -I. -o rast_bench rastBench.cpp helper.cpp rasterizer.o zbuff.o
+
+     Usage:
+       rast_bench [-r reps] [-m msaa,...] <vector>...
+*/
+
+#define BENCH_SAMPLES 64
+#define BENCH_MIN_SECONDS 0.2   // bbox and sample loops repeat at least this long
+
+static void set_msaa(Config& config, int msaa)
+{
+    config.r_shift = 10;
+    config.ss = msaa;
+    config.ss_w_lg2 = 0;
+    while( (1 << (2 * config.ss_w_lg2)) < msaa )
+        config.ss_w_lg2++;
+    config.ss_w = 1 << config.ss_w_lg2;
+    config.ss_i = 1024 / config.ss_w;
+}
+
+static void free_zbuff(ZBuff* z)
+{
+    free(z->frame_buffer);
+    free(z->depth_buffer);
+    free(z);
+}
+
+static double since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(size_t vec, const char* engine, int msaa, int rep,
+                   size_t calls, long long samples, double seconds)
+{
+    printf("BENCH %zu %s %d %d %zu %lld %.9f\n", vec, engine, msaa, rep, calls, samples, seconds);
+}
+
+int main(int argc, char **argv)
+{
+    int reps = 5;
+    vector<int> msaas;
+    vector<char*> files;
+
+    for( int i = 1 ; i < argc ; i++ ){
+        if( !strcmp(argv[i], "-r") && i + 1 < argc ){
+            reps = atoi(argv[++i]);
+        } else if( !strcmp(argv[i], "-m") && i + 1 < argc ){
+            for( char* p = strtok(argv[++i], ",") ; p ; p = strtok(NULL, ",") )
+                msaas.push_back(atoi(p));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if( files.empty() )
+        abort_("Usage: rast_bench [-r reps] [-m msaa,...] <vector>...");
+    if( msaas.empty() ){
+        msaas.push_back(1);
+        msaas.push_back(4);
+        msaas.push_back(16);
+        msaas.push_back(64);
+    }
+
+    for( size_t f = 0 ; f < files.size() ; f++ ){
+        vector<Triangle> triangles;
+        Screen screen;
+        Config config;
+        config.r_shift = 10;
+        load_file(files[f], triangles, screen, config);
+
+        for( size_t m = 0 ; m < msaas.size() ; m++ ){
+            int msaa = msaas[m];
+            set_msaa(config, msaa);
+
+            // Grid samples of every box, and the ones the sample test times
+            vector<BoundingBox> boxes(triangles.size());
+            vector<Sample> samples;
+            vector<int> owner;
+            long long box_samples = 0;
+            for( size_t t = 0 ; t < triangles.size() ; t++ ){
+                BoundingBox& b = boxes[t];
+                b = get_bounding_box(triangles[t], screen, config);
+                if( !b.valid || b.upper_right.x < b.lower_left.x || b.upper_right.y < b.lower_left.y )
+                    continue;
+                int ss_i = (int)config.ss_i;
+                box_samples += (long long)((b.upper_right.x - b.lower_left.x) / ss_i + 1) *
+                               ((b.upper_right.y - b.lower_left.y) / ss_i + 1);
+                int taken = 0;
+                for( int x = b.lower_left.x ; x <= b.upper_right.x && taken < BENCH_SAMPLES ; x += ss_i ){
+                    for( int y = b.lower_left.y ; y <= b.upper_right.y && taken < BENCH_SAMPLES ; y += ss_i ){
+                        Sample s;
+                        s.x = x;
+                        s.y = y;
+                        samples.push_back(s);
+                        owner.push_back((int)t);
+                        taken++;
+                    }
+                }
+            }
+
+            for( int rep = 0 ; rep < reps ; rep++ ){
+                ZBuff* z = zbuff_init(screen, config);
+                auto start = chrono::steady_clock::now();
+                long long hits = 0;
+                for( size_t t = 0 ; t < triangles.size() ; t++ )
+                    hits += rasterize_triangle(triangles[t], z, screen, config);
+                report(f, "triangle", msaa, rep, triangles.size(), box_samples, since(start));
+                free_zbuff(z);
+
+#ifdef BENCH_SETUP
+                z = zbuff_init(screen, config);
+                start = chrono::steady_clock::now();
+                for( size_t t = 0 ; t < triangles.size() ; t++ ){
+                    TriangleSetup setup = triangle_setup(triangles[t]);
+                    hits -= rasterize_triangle_setup(triangles[t], &setup, z, screen, config);
+                }
+                report(f, "setup", msaa, rep, triangles.size(), box_samples, since(start));
+                free_zbuff(z);
+                if( hits != 0 )
+                    abort_("rasterize_triangle_setup and rasterize_triangle disagree");
+#endif
+
+                start = chrono::steady_clock::now();
+                int valid = 0;
+                size_t passes = 0;
+                do {
+                    for( size_t t = 0 ; t < triangles.size() ; t++ )
+                        valid += get_bounding_box(triangles[t], screen, config).valid;
+                    passes++;
+                } while( since(start) < BENCH_MIN_SECONDS );
+                report(f, "bbox", msaa, rep, passes * triangles.size(), passes * box_samples, since(start));
+
+                start = chrono::steady_clock::now();
+                passes = 0;
+                do {
+                    for( size_t i = 0 ; i < samples.size() ; i++ )
+                        valid += sample_test(triangles[owner[i]], samples[i]);
+                    passes++;
+                } while( !samples.empty() && since(start) < BENCH_MIN_SECONDS );
+                report(f, "sample", msaa, rep, passes * samples.size(), passes * samples.size(), since(start));
+
+                // Keep the loops from being optimized away
+                if( valid < 0 )
+                    printf("%d\n", valid);
+            }
+        }
+    }
+    return 0;
+}
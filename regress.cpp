@@ -0,0 +1,871 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+
+   Regress
+     Cross-submission regression of the gold models, the parallel
+     version of script.sh. Each submission's gold sources are built
+     into their own rasterizer_gold under the cache directory, then
+     every (submission, vector) pair runs as a process of its own,
+     at most -j at a time:
+
+       rasterizer_gold <cache>/run/<sub>-<vec>.ppm <vector>
+
+     Each image is compared with the vector's _ref.ppm, as script.sh
+     does, and with the image most submissions produce for the vector.
+
+     Builds are cached by a hash of the gold sources and the compile
+     commands, results by that and a hash of the vector, so a rerun
+     only builds and runs what changed.
+
+     A submission's gold directory is <sub>/gold, <sub> or
+     <sub>/<any>/gold, whichever has rasterizer.c and rastTest.cpp. The
+     sources are those in its files.f (every .c and .cpp without one),
+     less rasterizer_sv_interface.c, which needs the simulator's
+     svdpi.h and is not part of rasterizer_gold.
+
+     With -b it is a throughput leaderboard instead: rastBench.cpp,
+     the common benchmark driver, is built against each gold model in
+     place of rastTest.cpp, and the models run it one at a time, with
+     nothing else running, for -r repetitions at each -m MSAA level.
+     Each model's rasterize_triangle (and rasterize_triangle_setup
+     where it has one) is ranked by triangles per second over all the
+     vectors, with the spread over the repetitions, alongside samples
+     per second and the get_bounding_box and sample_test rates. -g
+     keeps a baseline of those rates in a file: the first run writes
+     it, later runs fail if a model got more than BENCH_SLOWDOWN
+     slower.
+
+     Build:
+       g++ -O2 -o regress regress.cpp
+
+     Usage:
+       regress [-j jobs] [-c cache_dir] [-t seconds] [-s submissions] [-k] [vector]...
+       regress -b [-r reps] [-m msaa,...] [-g baseline] [-B driver] [...] [vector]...
+
+       -j  processes at once, default the number of cores
+       -c  cache directory, default regress_cache
+       -t  CPU seconds per run, default 3600
+       -s  file listing the submission directories, default
+           sub_names.txt, else every submission_* directory
+       -k  keep the images in <cache>/run
+       -r  benchmark repetitions, default 5
+       -m  MSAA levels benchmarked, default 1,4,16,64
+       -B  benchmark driver, default rastBench.cpp
+
+       The vectors default to script.sh's six under $EE271_VECT.
+
+     Prints a matrix with a column per vector
+
+       P  same as the reference    F  differs from the reference
+       =  no reference, same as    ~  no reference, differs from
+          the majority                the majority
+       B  build failed             X  run failed
+       T  out of CPU time          -  no gold model found
+
+     and then each vector's majority and the submissions that differ
+     from it. Exits with 1 if any build or run failed, or any image
+     differs from its reference.
+*/
+
+#define REGRESS_BUILD_ID "gcc -O2 -c; g++ -O2 -pthread -c; g++ -pthread -lm"
+#define BENCH_SLOWDOWN 0.10     // slower than the baseline by more than this fails -g
+
+static const char* default_vectors[] = {
+    "vec_271_00_sv.dat", "vec_271_01_sv.dat", "vec_271_01_sv_short.dat",
+    "vec_271_02_sv.dat", "vec_271_02_sv_short.dat", "vec_271_03_sv_short.dat",
+};
+
+enum { RUN_PENDING, RUN_OK, RUN_FAILED, RUN_TIMEOUT, RUN_NO_BUILD, RUN_NO_GOLD };
+
+typedef struct {
+    string         name;       // directory
+    string         gold;       // gold directory, empty if none
+    vector<string> sources;
+    uint64_t       key;        // sources and compile commands
+    string         dir;        // <cache>/bin/<key>
+    bool           setup;      // has rasterize_triangle_setup
+} Submission;
+
+typedef struct {
+    string   path;
+    string   ref;              // reference image, empty if none
+    uint64_t key;
+    uint64_t ref_image;
+} Vector;
+
+typedef struct {
+    int      status;
+    uint64_t image;            // hash of the image when RUN_OK
+} RunResult;
+
+enum { JOB_BUILD, JOB_RUN, JOB_BENCH };
+
+typedef struct {
+    int kind;
+    int sub;
+    int vec;
+} Job;
+
+static void abort_(const char* s, ...)
+{
+    va_list args;
+    va_start(args, s);
+    vfprintf(stderr, s, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    exit(2);
+}
+
+/*
+ *  FNV-1a, over names and contents: cache keys, and image identity
+ *  for the majority vote.
+ */
+#define FNV_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static uint64_t hash_bytes(uint64_t h, const void* p, size_t n)
+{
+    const unsigned char* b = (const unsigned char*)p;
+    for( size_t i = 0 ; i < n ; i++ )
+        h = (h ^ b[i]) * FNV_PRIME;
+    return h;
+}
+
+static uint64_t hash_string(uint64_t h, const string& s)
+{
+    return hash_bytes(h, s.c_str(), s.size() + 1);
+}
+
+// false if the file can't be read
+static bool hash_file(const string& path, uint64_t& h)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if( f == NULL )
+        return false;
+    vector<char> buf(1 << 20);
+    size_t n;
+    while( (n = fread(buf.data(), 1, buf.size(), f)) > 0 )
+        h = hash_bytes(h, buf.data(), n);
+    fclose(f);
+    return true;
+}
+
+static string hex(uint64_t v)
+{
+    char s[17];
+    snprintf(s, sizeof(s), "%016llx", (unsigned long long)v);
+    return s;
+}
+
+static bool exists(const string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+static bool is_dir(const string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void make_dir(const string& path)
+{
+    if( mkdir(path.c_str(), 0755) != 0 && !is_dir(path) )
+        abort_("Cannot create %s", path.c_str());
+}
+
+static vector<string> list_dir(const string& path)
+{
+    vector<string> names;
+    DIR* d = opendir(path.c_str());
+    if( d == NULL )
+        return names;
+    struct dirent* e;
+    while( (e = readdir(d)) != NULL ){
+        if( e->d_name[0] != '.' )
+            names.push_back(e->d_name);
+    }
+    closedir(d);
+    sort(names.begin(), names.end());
+    return names;
+}
+
+static bool ends_with(const string& s, const char* suffix)
+{
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// For /bin/sh
+static string quote(const string& s)
+{
+    string q = "'";
+    for( size_t i = 0 ; i < s.size() ; i++ ){
+        if( s[i] == '\'' )
+            q += "'\\''";
+        else
+            q += s[i];
+    }
+    return q + "'";
+}
+
+static bool is_gold_dir(const string& dir)
+{
+    return exists(dir + "/rasterizer.c") && exists(dir + "/rastTest.cpp");
+}
+
+static string find_gold(const string& sub)
+{
+    if( is_gold_dir(sub + "/gold") )
+        return sub + "/gold";
+    if( is_gold_dir(sub) )
+        return sub;
+    vector<string> names = list_dir(sub);
+    for( size_t i = 0 ; i < names.size() ; i++ ){
+        string dir = sub + "/" + names[i] + "/gold";
+        if( is_gold_dir(dir) )
+            return dir;
+    }
+    return "";
+}
+
+static bool is_source(const string& name)
+{
+    return (ends_with(name, ".c") || ends_with(name, ".cpp")) &&
+           name != "rasterizer_sv_interface.c";
+}
+
+static void load_submission(Submission& s)
+{
+    s.gold = find_gold(s.name);
+    s.key = FNV_BASIS;
+    s.setup = false;
+    if( s.gold.empty() )
+        return;
+
+    ifstream header((s.gold + "/rasterizer.h").c_str());
+    string line;
+    while( getline(header, line) )
+        s.setup = s.setup || line.find("rasterize_triangle_setup") != string::npos;
+
+    ifstream files((s.gold + "/files.f").c_str());
+    string name;
+    while( files >> name ){
+        if( is_source(name) && exists(s.gold + "/" + name) &&
+            find(s.sources.begin(), s.sources.end(), name) == s.sources.end() )
+            s.sources.push_back(name);
+    }
+    if( s.sources.empty() ){
+        vector<string> names = list_dir(s.gold);
+        for( size_t i = 0 ; i < names.size() ; i++ ){
+            if( is_source(names[i]) )
+                s.sources.push_back(names[i]);
+        }
+    }
+
+    // Every source and header in the directory, since any may be included
+    s.key = hash_string(s.key, REGRESS_BUILD_ID);
+    for( size_t i = 0 ; i < s.sources.size() ; i++ )
+        s.key = hash_string(s.key, s.sources[i]);
+    vector<string> names = list_dir(s.gold);
+    for( size_t i = 0 ; i < names.size() ; i++ ){
+        if( ends_with(names[i], ".c") || ends_with(names[i], ".cpp") || ends_with(names[i], ".h") ){
+            s.key = hash_string(s.key, names[i]);
+            hash_file(s.gold + "/" + names[i], s.key);
+        }
+    }
+}
+
+// rasterizer_gold, or with a driver, rast_bench: the driver in place of rastTest.cpp
+static string build_command(const Submission& s, const string& driver)
+{
+    string prog = driver.empty() ? "rasterizer_gold" : "rast_bench";
+    string cmd = "cd " + quote(s.dir);
+    string objs;
+    for( size_t i = 0 ; i < s.sources.size() ; i++ ){
+        const string& src = s.sources[i];
+        if( !driver.empty() && src == "rastTest.cpp" )
+            continue;
+        string obj = hex(hash_string(FNV_BASIS, src)) + ".o";
+        cmd += " && ";
+        cmd += ends_with(src, ".c") ? "gcc -O2 -c " : "g++ -O2 -pthread -c ";
+        cmd += "-I" + quote(s.gold) + " " + quote(s.gold + "/" + src) + " -o " + obj;
+        objs += " " + obj;
+    }
+    if( !driver.empty() ){
+        cmd += " && g++ -O2 -pthread -c -I" + quote(s.gold) + (s.setup ? " -DBENCH_SETUP " : " ") +
+               quote(driver) + " -o driver.o";
+        objs += " driver.o";
+    }
+    cmd += " && g++ -pthread -o " + prog + ".part" + objs + " -lm";
+    cmd += " && mv " + prog + ".part " + prog;
+    return cmd;
+}
+
+static string result_file(const string& cache, const Submission& s, const Vector& v)
+{
+    return cache + "/run/" + hex(s.key) + "-" + hex(v.key);
+}
+
+static bool load_result(const string& file, RunResult& r)
+{
+    FILE* f = fopen((file + ".res").c_str(), "r");
+    if( f == NULL )
+        return false;
+    unsigned long long image;
+    bool ok = fscanf(f, "%d %llx", &r.status, &image) == 2 &&
+              (r.status == RUN_OK || r.status == RUN_FAILED);
+    r.image = image;
+    fclose(f);
+    return ok;
+}
+
+static void save_result(const string& file, const RunResult& r)
+{
+    FILE* f = fopen((file + ".res").c_str(), "w");
+    if( f != NULL ){
+        fprintf(f, "%d %s\n", r.status, hex(r.image).c_str());
+        fclose(f);
+    }
+}
+
+// The job's process: /bin/sh -c cmd, output to log
+static pid_t spawn(const string& cmd, const string& log, int cpu_seconds)
+{
+    pid_t pid = fork();
+    if( pid < 0 )
+        abort_("fork failed");
+    if( pid == 0 ){
+        int fd = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if( fd >= 0 ){
+            dup2(fd, 1);
+            dup2(fd, 2);
+            close(fd);
+        }
+        if( cpu_seconds > 0 ){
+            struct rlimit r = { (rlim_t)cpu_seconds, (rlim_t)cpu_seconds + 5 };
+            setrlimit(RLIMIT_CPU, &r);
+        }
+        execl("/bin/sh", "sh", "-c", cmd.c_str(), (char*)NULL);
+        _exit(127);
+    }
+    return pid;
+}
+
+/*
+ *  Leaderboard from the BENCH lines of each model's bench.log (see
+ *  rastBench.cpp): per repetition the rate over all the vectors, then
+ *  the mean and spread over the repetitions.
+ */
+typedef struct {
+    double calls;
+    double samples;
+    double seconds;
+} BenchTotal;
+
+typedef struct {
+    double mean;
+    double sd;
+} Rate;
+
+typedef struct {
+    int    sub;
+    string engine;
+    Rate   tris;
+    Rate   samples;
+    Rate   bbox;
+    Rate   sample_test;
+} BenchEntry;
+
+typedef map< string, map< int, map<int, BenchTotal> > > BenchLog; // engine, msaa, rep
+
+static void load_bench(const string& file, BenchLog& log)
+{
+    ifstream in(file.c_str());
+    string line;
+    while( getline(in, line) ){
+        char engine[32];
+        size_t vec;
+        int msaa, rep;
+        double calls, samples, seconds;
+        if( sscanf(line.c_str(), "BENCH %zu %31s %d %d %lf %lf %lf", &vec, engine, &msaa, &rep,
+                   &calls, &samples, &seconds) != 7 )
+            continue;
+        BenchTotal& t = log[engine][msaa][rep];
+        t.calls += calls;
+        t.samples += samples;
+        t.seconds += seconds;
+    }
+}
+
+static Rate bench_rate(BenchLog& log, const string& engine, int msaa, bool samples)
+{
+    vector<double> v;
+    map<int, BenchTotal>& reps = log[engine][msaa];
+    for( map<int, BenchTotal>::iterator it = reps.begin() ; it != reps.end() ; ++it ){
+        if( it->second.seconds > 0 )
+            v.push_back((samples ? it->second.samples : it->second.calls) / it->second.seconds);
+    }
+    Rate r = { 0, 0 };
+    for( size_t i = 0 ; i < v.size() ; i++ )
+        r.mean += v[i] / v.size();
+    for( size_t i = 1 < v.size() ? 0 : v.size() ; i < v.size() ; i++ )
+        r.sd += (v[i] - r.mean) * (v[i] - r.mean) / (v.size() - 1);
+    r.sd = sqrt(r.sd);
+    return r;
+}
+
+static bool bench_report(const vector<Submission>& subs, const vector<int>& leader,
+                         const vector<int>& bench_status, const vector<int>& msaas,
+                         const string& baseline)
+{
+    bool failed = false;
+    vector<BenchLog> logs(subs.size());
+    vector<BenchEntry> entries;
+    for( size_t s = 0 ; s < subs.size() ; s++ ){
+        if( subs[s].gold.empty() )
+            printf("%s: no gold model\n", subs[s].name.c_str());
+        if( leader[s] != (int)s || subs[s].gold.empty() )
+            continue;
+        if( bench_status[s] != RUN_OK ){
+            printf("%s: %s\n", subs[s].name.c_str(),
+                   bench_status[s] == RUN_NO_BUILD ? "build failed" :
+                   bench_status[s] == RUN_TIMEOUT ? "benchmark out of CPU time" : "benchmark failed");
+            failed = true;
+            continue;
+        }
+        load_bench(subs[s].dir + "/bench.log", logs[s]);
+    }
+
+    map<string, double> base;
+    bool have_base = false;
+    if( !baseline.empty() ){
+        ifstream in(baseline.c_str());
+        string name, engine;
+        int msaa;
+        double rate;
+        have_base = in.is_open();
+        while( in >> name >> engine >> msaa >> rate )
+            base[name + " " + engine + " " + to_string(msaa)] = rate;
+    }
+    FILE* out = NULL;
+    if( !baseline.empty() && !have_base && (out = fopen(baseline.c_str(), "w")) == NULL )
+        abort_("Cannot write %s", baseline.c_str());
+
+    for( size_t m = 0 ; m < msaas.size() ; m++ ){
+        int msaa = msaas[m];
+        vector< pair<double, BenchEntry> > ranked;
+        for( size_t s = 0 ; s < subs.size() ; s++ ){
+            for( int e = 0 ; e < 2 ; e++ ){
+                BenchEntry b;
+                b.sub = s;
+                b.engine = e ? "setup" : "triangle";
+                if( !logs[s].count(b.engine) || !logs[s][b.engine].count(msaa) )
+                    continue;
+                b.tris = bench_rate(logs[s], b.engine, msaa, false);
+                b.samples = bench_rate(logs[s], b.engine, msaa, true);
+                b.bbox = bench_rate(logs[s], "bbox", msaa, false);
+                b.sample_test = bench_rate(logs[s], "sample", msaa, false);
+                ranked.push_back(make_pair(-b.tris.mean, b));
+            }
+        }
+        stable_sort(ranked.begin(), ranked.end(),
+                    [](const pair<double, BenchEntry>& a, const pair<double, BenchEntry>& b){ return a.first < b.first; });
+
+        printf("\nMSAA %d\n%4s  %-28s %-9s %13s %6s %14s %14s %14s\n", msaa, "rank", "gold model", "engine",
+               "triangles/s", "+-", "samples/s", "bbox/s", "sample_test/s");
+        for( size_t r = 0 ; r < ranked.size() ; r++ ){
+            const BenchEntry& b = ranked[r].second;
+            const string& name = subs[b.sub].name;
+            int same = 0;
+            for( size_t s = 0 ; s < subs.size() ; s++ )
+                same += leader[s] == b.sub && (int)s != b.sub;
+            string label = same ? name + " (+" + to_string(same) + ")" : name;
+            printf("%4zu  %-28s %-9s %13.1f %5.1f%% %14.0f %14.0f %14.0f", r + 1, label.c_str(), b.engine.c_str(),
+                   b.tris.mean, b.tris.mean > 0 ? 100.0 * b.tris.sd / b.tris.mean : 0.0,
+                   b.samples.mean, b.bbox.mean, b.sample_test.mean);
+
+            string key = name + " " + b.engine + " " + to_string(msaa);
+            if( out != NULL )
+                fprintf(out, "%s %.3f\n", key.c_str(), b.tris.mean);
+            if( base.count(key) && b.tris.mean < base[key] * (1.0 - BENCH_SLOWDOWN) ){
+                printf("  SLOWER than %.1f", base[key]);
+                failed = true;
+            }
+            printf("\n");
+        }
+    }
+    if( out != NULL ){
+        fclose(out);
+        printf("\nBaseline written to %s\n", baseline.c_str());
+    }
+    return failed;
+}
+
+int main(int argc, char** argv)
+{
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int cpu_seconds = 3600;
+    bool keep = false;
+    string cache = "regress_cache";
+    string sub_list = "sub_names.txt";
+    vector<string> vec_paths;
+    bool bench = false;
+    int reps = 5;
+    string msaa_list = "1,4,16,64";
+    string baseline;
+    string driver = "rastBench.cpp";
+
+    for( int i = 1 ; i < argc ; i++ ){
+        if( argv[i][0] == '-' && argv[i][1] && !argv[i][2] && strchr("jctsrmgB", argv[i][1]) && i + 1 < argc ){
+            switch( argv[i][1] ){
+            case 'j': jobs = atoi(argv[++i]); break;
+            case 'c': cache = argv[++i]; break;
+            case 't': cpu_seconds = atoi(argv[++i]); break;
+            case 's': sub_list = argv[++i]; break;
+            case 'r': reps = atoi(argv[++i]); break;
+            case 'm': msaa_list = argv[++i]; break;
+            case 'g': baseline = argv[++i]; break;
+            case 'B': driver = argv[++i]; break;
+            }
+        } else if( !strcmp(argv[i], "-k") ){
+            keep = true;
+        } else if( !strcmp(argv[i], "-b") ){
+            bench = true;
+        } else if( argv[i][0] == '-' ){
+            abort_("Usage: regress [-j jobs] [-c cache_dir] [-t seconds] [-s submissions] [-k] [vector]...\n"
+                   "       regress -b [-r reps] [-m msaa,...] [-g baseline] [-B driver] [...] [vector]...");
+        } else {
+            vec_paths.push_back(argv[i]);
+        }
+    }
+    if( jobs < 1 )
+        jobs = 1;
+
+    if( vec_paths.empty() ){
+        const char* dir = getenv("EE271_VECT");
+        if( dir == NULL )
+            abort_("No vectors given and EE271_VECT is not set");
+        for( size_t i = 0 ; i < sizeof(default_vectors) / sizeof(default_vectors[0]) ; i++ )
+            vec_paths.push_back(string(dir) + "/" + default_vectors[i]);
+    }
+
+    // Submissions
+    vector<Submission> subs;
+    {
+        ifstream list(sub_list.c_str());
+        string name;
+        if( list.is_open() ){
+            while( list >> name ){
+                subs.push_back(Submission());
+                subs.back().name = name;
+            }
+        } else {
+            vector<string> names = list_dir(".");
+            for( size_t i = 0 ; i < names.size() ; i++ ){
+                if( names[i].compare(0, 11, "submission_") == 0 && is_dir(names[i]) ){
+                    subs.push_back(Submission());
+                    subs.back().name = names[i];
+                }
+            }
+        }
+    }
+    if( subs.empty() )
+        abort_("No submissions in %s", sub_list.c_str());
+
+    // Vectors and their references, named as script.sh does
+    vector<Vector> vecs(vec_paths.size());
+    for( size_t v = 0 ; v < vecs.size() ; v++ ){
+        Vector& vec = vecs[v];
+        vec.path = vec_paths[v];
+        vec.key = FNV_BASIS;
+        if( !hash_file(vec.path, vec.key) )
+            abort_("Failed to Open Vector %s", vec.path.c_str());
+        if( vec.path[0] != '/' ){
+            char cwd[4096];
+            if( getcwd(cwd, sizeof(cwd)) != NULL )
+                vec.path = string(cwd) + "/" + vec.path;
+        }
+        string ref = ends_with(vec.path, ".dat") ? vec.path.substr(0, vec.path.size() - 4) + "_ref.ppm" : "";
+        vec.ref_image = FNV_BASIS;
+        if( !ref.empty() && hash_file(ref, vec.ref_image) )
+            vec.ref = ref;
+    }
+
+    // The driver is part of every benchmark build's key
+    vector<int> msaas;
+    uint64_t driver_key = hash_string(FNV_BASIS, "bench " + msaa_list);
+    if( bench ){
+        for( size_t p = 0 ; p < msaa_list.size() ; p = msaa_list.find(',', p) == string::npos ? msaa_list.size() : msaa_list.find(',', p) + 1 )
+            msaas.push_back(atoi(msaa_list.c_str() + p));
+        if( !hash_file(driver, driver_key) )
+            abort_("Failed to Open Benchmark Driver %s", driver.c_str());
+        if( driver[0] != '/' ){
+            char cwd[4096];
+            if( getcwd(cwd, sizeof(cwd)) != NULL )
+                driver = string(cwd) + "/" + driver;
+        }
+    }
+    const char* prog = bench ? "rast_bench" : "rasterizer_gold";
+
+    make_dir(cache);
+    make_dir(cache + "/bin");
+    make_dir(cache + "/run");
+    if( cache[0] != '/' ){
+        char cwd[4096];
+        if( getcwd(cwd, sizeof(cwd)) != NULL )
+            cache = string(cwd) + "/" + cache;
+    }
+
+    auto start = chrono::steady_clock::now();
+
+    // Builds first, so their runs can start while the others compile
+    vector< vector<RunResult> > results(subs.size(), vector<RunResult>(vecs.size()));
+    deque<Job> ready;
+    deque<Job> runs;
+    deque<Job> benches;
+    vector<int> bench_status(subs.size(), RUN_PENDING);
+    vector<int> leader(subs.size());     // first submission with the same gold sources
+    map<uint64_t, int> first;
+    int cached = 0;
+    for( size_t s = 0 ; s < subs.size() ; s++ ){
+        Submission& sub = subs[s];
+        load_submission(sub);
+        if( bench )
+            sub.key = hash_bytes(sub.key, &driver_key, sizeof(driver_key));
+        for( size_t v = 0 ; v < vecs.size() ; v++ )
+            results[s][v] = RunResult{ sub.gold.empty() ? RUN_NO_GOLD : RUN_PENDING, 0 };
+        leader[s] = s;
+        if( sub.gold.empty() )
+            continue;
+
+        // Identical gold models are built and run once
+        if( first.count(sub.key) ){
+            leader[s] = first[sub.key];
+            continue;
+        }
+        first[sub.key] = s;
+
+        if( sub.gold[0] != '/' ){
+            char cwd[4096];
+            if( getcwd(cwd, sizeof(cwd)) != NULL )
+                sub.gold = string(cwd) + "/" + sub.gold;
+        }
+        sub.dir = cache + "/bin/" + hex(sub.key);
+        make_dir(sub.dir);
+
+        if( exists(sub.dir + "/FAILED") ){
+            for( size_t v = 0 ; v < vecs.size() ; v++ )
+                results[s][v].status = RUN_NO_BUILD;
+            bench_status[s] = RUN_NO_BUILD;
+        } else if( !exists(sub.dir + "/" + prog) ){
+            ready.push_back(Job{ JOB_BUILD, (int)s, -1 });
+        } else if( bench ){
+            benches.push_back(Job{ JOB_BENCH, (int)s, -1 });
+        } else {
+            for( size_t v = 0 ; v < vecs.size() ; v++ )
+                runs.push_back(Job{ JOB_RUN, (int)s, (int)v });
+        }
+    }
+
+    // Runs with a result from an earlier sweep don't run again
+    for( size_t i = 0 ; i < runs.size() ; i++ ){
+        const Job& j = runs[i];
+        if( load_result(result_file(cache, subs[j.sub], vecs[j.vec]), results[j.sub][j.vec]) )
+            cached++;
+        else
+            ready.push_back(j);
+    }
+    ready.insert(ready.end(), benches.begin(), benches.end());
+
+    // The pool: at most jobs processes, a finished build queues its runs.
+    // A benchmark runs alone, after every build ahead of it.
+    map<pid_t, Job> running;
+    int builds = 0, done = 0;
+    bool timing = false;
+    while( !ready.empty() || !running.empty() ){
+        while( (int)running.size() < jobs && !ready.empty() && !timing ){
+            if( ready.front().kind == JOB_BENCH && !running.empty() )
+                break;
+            Job j = ready.front();
+            ready.pop_front();
+            Submission& sub = subs[j.sub];
+            pid_t pid;
+            if( j.kind == JOB_BUILD ){
+                pid = spawn(build_command(sub, bench ? driver : ""), sub.dir + "/build.log", 0);
+            } else if( j.kind == JOB_BENCH ){
+                string cmd = "exec " + quote(sub.dir + "/rast_bench") + " -r " + to_string(reps) +
+                             " -m " + quote(msaa_list);
+                for( size_t v = 0 ; v < vecs.size() ; v++ )
+                    cmd += " " + quote(vecs[v].path);
+                pid = spawn(cmd, sub.dir + "/bench.log", cpu_seconds);
+                timing = true;
+            } else {
+                string file = result_file(cache, sub, vecs[j.vec]);
+                pid = spawn("exec " + quote(sub.dir + "/rasterizer_gold") + " " + quote(file + ".ppm") +
+                            " " + quote(vecs[j.vec].path), file + ".log", cpu_seconds);
+            }
+            running[pid] = j;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if( pid < 0 )
+            abort_("wait failed");
+        map<pid_t, Job>::iterator it = running.find(pid);
+        if( it == running.end() )
+            continue;
+        Job j = it->second;
+        running.erase(it);
+        Submission& sub = subs[j.sub];
+        bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+        bool out_of_time = WIFSIGNALED(status) && (WTERMSIG(status) == SIGXCPU || WTERMSIG(status) == SIGKILL);
+
+        if( j.kind == JOB_BENCH ){
+            bench_status[j.sub] = ok ? RUN_OK : out_of_time ? RUN_TIMEOUT : RUN_FAILED;
+            timing = false;
+            done++;
+            continue;
+        }
+
+        if( j.kind == JOB_BUILD ){
+            builds++;
+            if( ok && bench ){
+                ready.push_back(Job{ JOB_BENCH, j.sub, -1 });
+            } else if( ok ){
+                for( size_t v = 0 ; v < vecs.size() ; v++ )
+                    ready.push_back(Job{ JOB_RUN, j.sub, (int)v });
+            } else {
+                FILE* f = fopen((sub.dir + "/FAILED").c_str(), "w");
+                if( f != NULL )
+                    fclose(f);
+                for( size_t v = 0 ; v < vecs.size() ; v++ )
+                    results[j.sub][v].status = RUN_NO_BUILD;
+                bench_status[j.sub] = RUN_NO_BUILD;
+                printf("%s: build failed, see %s/build.log\n", sub.name.c_str(), sub.dir.c_str());
+            }
+            continue;
+        }
+
+        string file = result_file(cache, sub, vecs[j.vec]);
+        RunResult& r = results[j.sub][j.vec];
+        r.image = FNV_BASIS;
+        if( out_of_time ){
+            r.status = RUN_TIMEOUT;
+        } else if( ok && hash_file(file + ".ppm", r.image) ){
+            r.status = RUN_OK;
+        } else {
+            r.status = RUN_FAILED;
+        }
+        if( r.status != RUN_TIMEOUT )
+            save_result(file, r);
+        if( !keep )
+            unlink((file + ".ppm").c_str());
+        done++;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if( bench ){
+        bool failed = bench_report(subs, leader, bench_status, msaas, baseline);
+        printf("\n%zu submissions (%zu gold models), %zu vectors: %d builds, %d benchmarks, %.1f s\n",
+               subs.size(), first.size(), vecs.size(), builds, done, seconds);
+        return failed ? 1 : 0;
+    }
+
+    for( size_t s = 0 ; s < subs.size() ; s++ )
+        results[s] = results[leader[s]];
+
+    // Majority image of each vector
+    vector<uint64_t> majority(vecs.size(), 0);
+    vector<int> votes(vecs.size(), 0), voters(vecs.size(), 0);
+    for( size_t v = 0 ; v < vecs.size() ; v++ ){
+        map<uint64_t, int> count;
+        for( size_t s = 0 ; s < subs.size() ; s++ ){
+            if( results[s][v].status == RUN_OK ){
+                int c = ++count[results[s][v].image];
+                voters[v]++;
+                if( c > votes[v] ){
+                    votes[v] = c;
+                    majority[v] = results[s][v].image;
+                }
+            }
+        }
+    }
+
+    printf("\n");
+    for( size_t v = 0 ; v < vecs.size() ; v++ )
+        printf("%3zu  %s%s\n", v + 1, vecs[v].path.c_str(), vecs[v].ref.empty() ? "  (no reference)" : "");
+    printf("\n%-24s", "submission");
+    for( size_t v = 0 ; v < vecs.size() ; v++ )
+        printf("%3zu", v + 1);
+    printf("   passed\n");
+
+    bool failed = false;
+    for( size_t s = 0 ; s < subs.size() ; s++ ){
+        int passed = 0;
+        printf("%-24s", subs[s].name.c_str());
+        for( size_t v = 0 ; v < vecs.size() ; v++ ){
+            const RunResult& r = results[s][v];
+            char c = '?';
+            switch( r.status ){
+            case RUN_OK:
+                if( !vecs[v].ref.empty() )
+                    c = r.image == vecs[v].ref_image ? 'P' : 'F';
+                else
+                    c = r.image == majority[v] ? '=' : '~';
+                break;
+            case RUN_FAILED:   c = 'X'; break;
+            case RUN_TIMEOUT:  c = 'T'; break;
+            case RUN_NO_BUILD: c = 'B'; break;
+            case RUN_NO_GOLD:  c = '-'; break;
+            }
+            passed += c == 'P';
+            failed = failed || c == 'F' || c == 'X' || c == 'T' || c == 'B';
+            printf("%3c", c);
+        }
+        printf("   %d/%zu\n", passed, vecs.size());
+    }
+
+    printf("\n");
+    for( size_t v = 0 ; v < vecs.size() ; v++ ){
+        printf("%3zu  majority %d of %d runs%s", v + 1, votes[v], voters[v],
+               !vecs[v].ref.empty() && voters[v] && majority[v] != vecs[v].ref_image ?
+               ", not the reference image" : "");
+        string odd;
+        for( size_t s = 0 ; s < subs.size() ; s++ ){
+            if( results[s][v].status == RUN_OK && results[s][v].image != majority[v] )
+                odd += " " + subs[s].name;
+        }
+        printf("%s%s\n", odd.empty() ? "" : ", differ:", odd.c_str());
+    }
+
+    printf("\n%zu submissions (%zu gold models), %zu vectors: %d builds, %d runs, %d cached, %.1f s with %d jobs\n",
+           subs.size(), first.size(), vecs.size(), builds, done, cached, seconds, jobs);
+    return failed ? 1 : 0;
+}
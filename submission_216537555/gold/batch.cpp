@@ -0,0 +1,93 @@
+#include "batch.h"
+#include "pipeline.h"
+extern "C"{
+#include "zbuff.h"
+}
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+/* File Format:
+   /
+   /   One job per line: <vector> <file_out>
+   /   Blank lines and lines starting with # are skipped
+*/
+
+void load_batch_file(char* file_name, vector<BatchJob>& jobs)
+{
+    ifstream myfile (file_name);
+
+    if( ! myfile.is_open() )
+        abort_("Failed to Open Batch File for Read");
+
+    string line;
+    int line_num = 0;
+    while( getline(myfile, line) ){
+        line_num++;
+
+        istringstream fields(line);
+        BatchJob job;
+        if( !(fields >> job.file_in) || job.file_in[0] == '#' )
+            continue;
+        if( !(fields >> job.file_out) )
+            abort_("Batch line %d: expected <vector> <file_out>", line_num);
+
+        jobs.push_back(job);
+    }
+}
+
+static void batch_worker(vector<BatchJob>* jobs, atomic<size_t>* next, mutex* log,
+                         atomic<int>* failed)
+{
+    ZBuff *cache = NULL;
+    PipelineConfig pc = pipeline_defaults();
+
+    for( size_t i = next->fetch_add(1) ; i < jobs->size() ; i = next->fetch_add(1) ){
+        BatchJob& job = (*jobs)[i];
+
+        auto t0 = chrono::steady_clock::now();
+        string error;
+        size_t count = render_pipelined( &job.file_in[0], &job.file_out[0], pc, &cache, &error );
+        auto t1 = chrono::steady_clock::now();
+
+        lock_guard<mutex> lock(*log);
+        if( ! error.empty() ){
+            failed->fetch_add(1);
+            printf( "[%zu/%zu] %s -> %s: FAILED: %s\n", i + 1, jobs->size(),
+                    job.file_in.c_str(), job.file_out.c_str(), error.c_str() );
+            continue;
+        }
+        printf( "[%zu/%zu] %s -> %s: %zu triangles, %.3f s\n", i + 1, jobs->size(),
+                job.file_in.c_str(), job.file_out.c_str(), count,
+                chrono::duration<double>(t1 - t0).count() );
+    }
+
+    if( cache != NULL )
+        zbuff_free( cache );
+}
+
+int render_batch(vector<BatchJob>& jobs, int workers)
+{
+    if( workers <= 0 )
+        workers = max( 1, (int)thread::hardware_concurrency() / 3 );
+    workers = min( workers, (int)jobs.size() );
+
+    atomic<size_t> next(0);
+    atomic<int> failed(0);
+    mutex log;
+
+    vector<thread> pool;
+    for( int i = 0 ; i < workers ; i++ )
+        pool.push_back( thread( batch_worker, &jobs, &next, &log, &failed ) );
+    for( int i = 0 ; i < workers ; i++ )
+        pool[i].join();
+
+    if( failed > 0 )
+        printf( "%d of %zu jobs failed\n", failed.load(), jobs.size() );
+    return failed;
+}
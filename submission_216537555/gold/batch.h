@@ -0,0 +1,26 @@
+#if !defined( J_BATCH )
+#define J_BATCH
+
+#include "helper.h"
+
+using namespace std;
+
+typedef struct { // one line of a batch list
+  string file_in;
+  string file_out;
+} BatchJob;
+
+void load_batch_file(char* file_name, vector<BatchJob>& jobs);
+
+/*
+ *  Render every job of the list in this process. Jobs run on
+ *  `workers` threads (0 picks one per three cores, as each job
+ *  is itself a three stage pipeline), and each worker keeps its
+ *  z-buffer between jobs with the same screen and MSAA.
+ *
+ *  A job that fails is reported and skipped, the rest still run.
+ *  Returns the number of failed jobs.
+ */
+int render_batch(vector<BatchJob>& jobs, int workers);
+
+#endif
@@ -0,0 +1,316 @@
+#include "helper.h"
+extern "C"{
+#include "dpi_trace.h"
+#include "rasterizer_sv_interface.h"
+}
+
+#include <stdint.h>
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+
+   DPI Replay
+     Re-runs the checker calls recorded by a simulation with
+     RAST_DPI_RECORD=<trace> (see dpi_trace.h) against the gold
+     model this program is linked with, and reports every check
+     whose verdict differs from the one seen in simulation.
+
+     Calls of one gold context stay in order on one worker; the
+     stateless checks (bbox, hash, hit count) are spread over all
+     workers in chunks. Images written by check_zbuff_write_ppm and
+     snapshots saved by check_zbuff_save go to replay_<name> in the
+     current directory; restores read the recorded snapshot itself.
+
+     Build:
+       gcc -O2 -pthread -I$VCS_HOME/include -c rasterizer.c zbuff.c rasterizer_sv_interface.c
+       g++ -O2 -pthread -I$VCS_HOME/include -o dpi_replay dpiReplay.cpp gold_ahead.cpp helper.cpp \
+           rasterizer.o zbuff.o rasterizer_sv_interface.o
+
+     Usage:
+       dpi_replay [-j workers] <trace>
+*/
+
+#define REPLAY_CHUNK 4096 // stateless records handed to one worker at a time
+
+typedef struct {
+    uint64_t calls[DPI_OP_COUNT];
+    uint64_t failed[DPI_OP_COUNT];   // checks that fail with this gold model
+    uint64_t changed[DPI_OP_COUNT];  // verdicts that differ from the simulation
+} ReplayStats;
+
+typedef struct {
+    vector<size_t> records;          // offsets into the trace, in trace order
+    int ctx_map[GOLD_MAX_CONTEXTS];  // recorded handle -> replayed handle
+    ReplayStats stats;
+} ReplayWorker;
+
+static const char* op_names[DPI_OP_COUNT] = {
+    "", "bounding box", "sample test", "hit count", "hash", "sample lanes",
+    "zbuff init", "zbuff open", "zbuff close", "fragment", "fragments", "write ppm",
+    "zbuff save", "zbuff restore"
+};
+
+// Argument count matches what the op reads
+static bool record_ok(int op, int nargs, const int32_t* a)
+{
+    static const int fixed[DPI_OP_COUNT] = { 0, 17, 10, 12, 7, -1, 3, 3, 1, 9, -1, -1, -1, -1 };
+    if( op <= 0 || op >= DPI_OP_COUNT )
+        return false;
+    if( fixed[op] >= 0 )
+        return nargs == fixed[op];
+    if( nargs < 2 || a[1] < 0 )
+        return false;
+
+    switch( op ){
+    case DPI_OP_SAMPLE_LANES:
+        return a[1] <= FUSED_MAX_LANES && nargs == 11 + 9 * a[1];
+    case DPI_OP_FRAGMENTS:
+        return nargs >= 3 && a[2] >= 0 && a[2] <= FUSED_MAX_LANES && nargs == 3 + 8 * a[2];
+    case DPI_OP_ZBUFF_SAVE:
+        return nargs >= 6 && a[5] >= 0 && nargs == 6 + (a[5] + 3) / 4;
+    case DPI_OP_ZBUFF_RESTORE:
+        return nargs >= 4 && a[3] >= 0 && nargs == 4 + (a[3] + 3) / 4;
+    default: // DPI_OP_WRITE_PPM
+        return nargs == 2 + (a[1] + 3) / 4;
+    }
+}
+
+// Worker owning a gold context, or -1 for calls that need no context
+static int record_context(int op, int result, const int32_t* a)
+{
+    switch( op ){
+    case DPI_OP_SAMPLE_TEST:
+    case DPI_OP_SAMPLE_LANES:
+    case DPI_OP_ZBUFF_CLOSE:
+    case DPI_OP_FRAGMENT:
+    case DPI_OP_FRAGMENTS:
+    case DPI_OP_WRITE_PPM:
+    case DPI_OP_ZBUFF_SAVE:
+    case DPI_OP_ZBUFF_RESTORE:
+        return a[0];
+    case DPI_OP_ZBUFF_INIT:
+        return GOLD_DEFAULT_CONTEXT;
+    case DPI_OP_ZBUFF_OPEN:
+        return result;
+    default:
+        return -1;
+    }
+}
+
+static int replay_ctx(ReplayWorker& w, int ctx)
+{
+    if( ctx < 0 || ctx >= GOLD_MAX_CONTEXTS )
+        return -1;
+    return ctx == GOLD_DEFAULT_CONTEXT ? ctx : w.ctx_map[ctx];
+}
+
+// 64-bit snapshot tag recorded as lo, hi
+static long long record_tag(const int32_t* a)
+{
+    return (long long)(((unsigned long long)(uint32_t)a[1] << 32) | (uint32_t)a[0]);
+}
+
+/*
+ *  Run one recorded call. Returns the check's result, 1 for calls
+ *  that don't check anything.
+ */
+static int replay_record(ReplayWorker& w, int op, int result, const int32_t* a)
+{
+    switch( op ){
+    case DPI_OP_BBOX:
+        return check_bounding_box(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8],
+                                  a[9], a[10], a[11], a[12], a[13], a[14], a[15], a[16]);
+    case DPI_OP_SAMPLE_TEST:
+        return check_sample_test_ctx(replay_ctx(w, a[0]), a[1], a[2], a[3], a[4], a[5], a[6],
+                                     a[7], a[8], a[9]);
+    case DPI_OP_HIT_COUNT:
+        return check_hit_count(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9],
+                               a[10], a[11]);
+    case DPI_OP_HASH:
+        return check_hash(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+    case DPI_OP_SAMPLE_LANES: {
+        int lanes = a[1];
+        const int32_t* tri = &a[2];
+        const int32_t* sample = &a[9];
+        const int32_t* hit = sample + 2 * lanes;
+        const int32_t* hash = hit + lanes + 1;
+        return check_sample_lanes_ctx(replay_ctx(w, a[0]), tri, a[8], sample, hit,
+                                      hit[lanes], hash, hash[6 * lanes], lanes);
+    }
+    case DPI_OP_ZBUFF_INIT:
+        return check_zbuff_init(a[0], a[1], a[2]);
+    case DPI_OP_ZBUFF_OPEN:
+        if( result >= 0 && result < GOLD_MAX_CONTEXTS )
+            w.ctx_map[result] = check_zbuff_open(a[0], a[1], a[2]);
+        return 1;
+    case DPI_OP_ZBUFF_CLOSE:
+        return check_zbuff_close(replay_ctx(w, a[0]));
+    case DPI_OP_FRAGMENT:
+        return check_zbuff_process_fragment_ctx(replay_ctx(w, a[0]), a[1], a[2], a[3], a[4],
+                                                a[5], a[6], a[7], a[8]);
+    case DPI_OP_FRAGMENTS:
+        return check_zbuff_process_fragments_ctx(replay_ctx(w, a[0]), a[1], &a[3], a[2]);
+    case DPI_OP_WRITE_PPM: {
+        string name((const char*)&a[2], a[1]);
+        size_t slash = name.rfind('/');
+        if( slash != string::npos )
+            name = name.substr(slash + 1);
+        name = "replay_" + name;
+        return check_zbuff_write_ppm_ctx(replay_ctx(w, a[0]), name.c_str());
+    }
+    case DPI_OP_ZBUFF_SAVE: {
+        string name((const char*)&a[6], a[5]);
+        size_t slash = name.rfind('/');
+        if( slash != string::npos )
+            name = name.substr(slash + 1);
+        name = "replay_" + name;
+        return check_zbuff_save_ctx(replay_ctx(w, a[0]), name.c_str(), a[1], record_tag(&a[2]), a[4]);
+    }
+    case DPI_OP_ZBUFF_RESTORE: {
+        // a snapshot holding other triangles than recorded is a failure
+        string name((const char*)&a[4], a[3]);
+        long long tag;
+        int triangles = check_zbuff_restore_ctx(replay_ctx(w, a[0]), name.c_str(), &tag);
+        return tag == record_tag(&a[1]) ? triangles : -1;
+    }
+    default:
+        return 1;
+    }
+}
+
+// A check fails on 0, the fused lanes check on a non-zero error bitmap,
+// a restore on -1
+static bool check_failed(int op, int result)
+{
+    if( op == DPI_OP_ZBUFF_RESTORE )
+        return result < 0;
+    return op == DPI_OP_SAMPLE_LANES ? result != 0 : result == 0;
+}
+
+static void replay_worker(const uchar* trace, ReplayWorker* w)
+{
+    for( size_t k = 0 ; k < w->records.size() ; k++ ){
+        const uchar* r = trace + w->records[k];
+        uint32_t word;
+        int32_t result;
+        memcpy(&word, r, sizeof(word));
+        memcpy(&result, r + 4, sizeof(result));
+        int op = DPI_TRACE_OP(word);
+
+        int replayed = replay_record(*w, op, result, (const int32_t*)(r + 8));
+
+        w->stats.calls[op]++;
+        if( check_failed(op, replayed) )
+            w->stats.failed[op]++;
+        if( result != -1 && op != DPI_OP_ZBUFF_OPEN && replayed != result )
+            w->stats.changed[op]++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int workers = (int)thread::hardware_concurrency();
+    const char* file = NULL;
+
+    for( int i = 1 ; i < argc ; i++ ){
+        if( !strcmp(argv[i], "-j") && i + 1 < argc )
+            workers = atoi(argv[++i]);
+        else
+            file = argv[i];
+    }
+    if( file == NULL )
+    {
+        abort_("Usage: dpi_replay [-j workers] <trace>");
+    }
+    workers = workers < 1 ? 1 : workers;
+
+    int fd = open(file, O_RDONLY);
+    struct stat st;
+    if( fd < 0 || fstat(fd, &st) || (size_t)st.st_size < sizeof(DpiTraceHeader) )
+        abort_("Failed to Open DPI Trace for Read");
+
+    size_t size = st.st_size;
+    const uchar* trace = (const uchar*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( trace == MAP_FAILED )
+        abort_("Failed to Map DPI Trace");
+
+    DpiTraceHeader h;
+    memcpy(&h, trace, sizeof(h));
+    if( h.magic != DPI_TRACE_MAGIC || h.version != DPI_TRACE_VERSION )
+        abort_("Not a DPI Trace");
+
+    // Split the records: by context, stateless ones in chunks
+    vector<ReplayWorker> w(workers);
+    for( int i = 0 ; i < workers ; i++ ){
+        for( int c = 0 ; c < GOLD_MAX_CONTEXTS ; c++ )
+            w[i].ctx_map[c] = -1;
+        memset(&w[i].stats, 0, sizeof(ReplayStats));
+    }
+
+    size_t pos = sizeof(h);
+    size_t records = 0;
+    while( pos + 8 <= size ){
+        uint32_t word;
+        int32_t result;
+        memcpy(&word, trace + pos, sizeof(word));
+        memcpy(&result, trace + pos + 4, sizeof(result));
+        int op = DPI_TRACE_OP(word);
+        int nargs = DPI_TRACE_NARGS(word);
+        size_t bytes = 8 + 4 * (size_t)nargs;
+        if( pos + bytes > size || !record_ok(op, nargs, (const int32_t*)(trace + pos + 8)) ){
+            printf("[ERROR] DPI trace ends in a broken record after %zu calls\n", records);
+            break;
+        }
+
+        int ctx = record_context(op, result, (const int32_t*)(trace + pos + 8));
+        int owner = ctx >= 0 ? ctx % workers : (int)((records / REPLAY_CHUNK) % workers);
+        w[owner].records.push_back(pos);
+
+        pos += bytes;
+        records++;
+    }
+
+    auto start = chrono::steady_clock::now();
+
+    vector<thread> threads;
+    for( int i = 0 ; i < workers ; i++ )
+        threads.push_back(thread(replay_worker, trace, &w[i]));
+    for( size_t i = 0 ; i < threads.size() ; i++ )
+        threads[i].join();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    ReplayStats total;
+    memset(&total, 0, sizeof(total));
+    for( int i = 0 ; i < workers ; i++ ){
+        for( int op = 0 ; op < DPI_OP_COUNT ; op++ ){
+            total.calls[op] += w[i].stats.calls[op];
+            total.failed[op] += w[i].stats.failed[op];
+            total.changed[op] += w[i].stats.changed[op];
+        }
+    }
+
+    printf("\nReplayed %zu calls on %d workers in %.2f s\n", records, workers, seconds);
+    printf("  %-14s %12s %10s %10s\n", "call", "calls", "failed", "changed");
+    uint64_t failed = 0, changed = 0;
+    for( int op = 1 ; op < DPI_OP_COUNT ; op++ ){
+        if( total.calls[op] == 0 )
+            continue;
+        printf("  %-14s %12llu %10llu %10llu\n", op_names[op],
+               (unsigned long long)total.calls[op],
+               (unsigned long long)total.failed[op],
+               (unsigned long long)total.changed[op]);
+        failed += total.failed[op];
+        changed += total.changed[op];
+    }
+
+    munmap((void*)trace, size);
+    return failed || changed ? 1 : 0;
+}
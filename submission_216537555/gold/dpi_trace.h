@@ -0,0 +1,70 @@
+#ifndef DPI_TRACE_H
+#define DPI_TRACE_H
+
+#include <stdint.h>
+
+/*
+ *  DPI call trace.
+ *
+ *  With RAST_DPI_RECORD=<file> set, rasterizer_sv_interface.c appends
+ *  every checker call it receives from the testbench to <file>, and
+ *  dpi_replay (dpiReplay.cpp) re-runs them against whichever gold
+ *  model it is linked with, without the simulator.
+ *
+ *  The file is a DpiTraceHeader followed by records of
+ *
+ *    uint32  DPI_TRACE_WORD(op, nargs)
+ *    int32   result   what the check returned in simulation (-1: not known)
+ *    int32   args[nargs]
+ *
+ *  Args per op, as passed to the check_* call of the same name:
+ *
+ *    BBOX          the 17 check_bounding_box arguments
+ *    SAMPLE_TEST   ctx, v0_x .. v2_y, s_x, s_y, hit
+ *    HIT_COUNT     the 12 check_hit_count arguments (deferred checks too)
+ *    HASH          the 7 check_hash arguments
+ *    SAMPLE_LANES  ctx, lanes, tri[6], valid_samp, sample[lanes][2],
+ *                  hit[lanes], hash_valid, hash[lanes][6], ss_w_lg2
+ *    ZBUFF_INIT    w, h, ss_w                     (GOLD_DEFAULT_CONTEXT)
+ *    ZBUFF_OPEN    w, h, ss_w                     result: the handle
+ *    ZBUFF_CLOSE   ctx
+ *    FRAGMENT      ctx, x, y, ss_x, ss_y, d, R, G, B
+ *    FRAGMENTS     ctx, valid, lanes, frag[lanes][8]
+ *    WRITE_PPM     ctx, length, file name packed 4 chars per arg
+ *    ZBUFF_SAVE    ctx, triangles, tag lo, tag hi, compress, length,
+ *                  file name
+ *    ZBUFF_RESTORE ctx, tag lo, tag hi, length, file name
+ *                                                 result: its triangles
+ *
+ *  Checks with a gold-ahead stream are recorded as plain SAMPLE_LANES.
+ */
+#define DPI_TRACE_MAGIC 0x5452444a // "JDRT"
+#define DPI_TRACE_VERSION 2
+
+#define DPI_TRACE_WORD(op, nargs) (((uint32_t)(op) << 24) | (uint32_t)(nargs))
+#define DPI_TRACE_OP(word)        ((int)((word) >> 24))
+#define DPI_TRACE_NARGS(word)     ((int)((word) & 0xffffff))
+
+enum {
+    DPI_OP_BBOX = 1,
+    DPI_OP_SAMPLE_TEST,
+    DPI_OP_HIT_COUNT,
+    DPI_OP_HASH,
+    DPI_OP_SAMPLE_LANES,
+    DPI_OP_ZBUFF_INIT,
+    DPI_OP_ZBUFF_OPEN,
+    DPI_OP_ZBUFF_CLOSE,
+    DPI_OP_FRAGMENT,
+    DPI_OP_FRAGMENTS,
+    DPI_OP_WRITE_PPM,
+    DPI_OP_ZBUFF_SAVE,
+    DPI_OP_ZBUFF_RESTORE,
+    DPI_OP_COUNT
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} DpiTraceHeader;
+
+#endif
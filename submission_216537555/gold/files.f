@@ -1,5 +1,14 @@
+batch.cpp
+gold_ahead.cpp
 helper.cpp
+lane_iter.c
+mesh.cpp
+pipeline.cpp
 rasterizer.c
 rasterizer_sv_interface.c
 rastTest.cpp
+rast_fixed.cpp
+rast_stats.cpp
+rtl_trace.cpp
+tri_feeder.cpp
 zbuff.c
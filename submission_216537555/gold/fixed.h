@@ -0,0 +1,114 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+#include <type_traits>
+
+/*
+ *  Bit-accurate fixed point for gold model datapaths.
+ *
+ *  Fixed<Bits, Radix> is a Bits wide two's complement number with
+ *  Radix fraction bits, i.e. an RTL `logic signed [Bits-1:0]` read
+ *  as fixed point. It is held in the smallest native integer that
+ *  fits, always sign extended from bit Bits-1, so it costs what an
+ *  int or int64_t costs.
+ *
+ *  Arithmetic widens so that it can't overflow, and the width is
+ *  part of the type:
+ *    a + b, a - b   Fixed<max(Ba, Bb) + 1, R>   (Radix must match)
+ *    -a             Fixed<Ba + 1, R>
+ *    a * b          Fixed<Ba + Bb, Ra + Rb>
+ *  Narrowing is explicit, like the assignment to a narrower signal:
+ *    wrap<B>()      keeps the low B bits, as SystemVerilog does
+ *    saturate<B>()  clamps to the B bit range
+ *  A result wider than 64 bits doesn't compile; wrap or saturate
+ *  before it gets there.
+ */
+
+template <int Bits>
+struct FixedStorage {
+    static_assert(Bits >= 1 && Bits <= 64, "Fixed supports 1 to 64 bits");
+    typedef typename std::conditional<(Bits <= 32), int32_t, int64_t>::type type;
+};
+
+template <int Bits, int Radix = 0>
+class Fixed {
+public:
+    typedef typename FixedStorage<Bits>::type raw_t;
+    static constexpr int bits = Bits;
+    static constexpr int radix = Radix;
+
+    constexpr Fixed() : v(0) {}
+
+    // The low Bits bits of raw, e.g. a vector field driven onto a port
+    static constexpr Fixed from_raw(int64_t raw) { return Fixed(sext(raw)); }
+
+    static constexpr raw_t max_raw() { return (raw_t)(((uint64_t)1 << (Bits - 1)) - 1); }
+    static constexpr raw_t min_raw() { return (raw_t)(-max_raw() - 1); }
+
+    constexpr raw_t raw() const { return v; }
+    constexpr int sign() const { return (v > 0) - (v < 0); }
+
+    template <int B>
+    constexpr Fixed<B, Radix> wrap() const { return Fixed<B, Radix>::from_raw(v); }
+
+    template <int B>
+    constexpr Fixed<B, Radix> saturate() const
+    {
+        return Fixed<B, Radix>::from_raw(
+            v > (int64_t)Fixed<B, Radix>::max_raw() ? (int64_t)Fixed<B, Radix>::max_raw() :
+            v < (int64_t)Fixed<B, Radix>::min_raw() ? (int64_t)Fixed<B, Radix>::min_raw() : (int64_t)v);
+    }
+
+private:
+    explicit constexpr Fixed(raw_t raw) : v(raw) {}
+
+    // Shift in the storage width, so 32 bit values stay 32 bit ops
+    static constexpr raw_t sext(int64_t raw)
+    {
+        return Bits <= 32
+            ? (raw_t)((int32_t)((uint32_t)raw << (32 - Bits % 33)) >> (32 - Bits % 33))
+            : (raw_t)((int64_t)((uint64_t)raw << (64 - Bits)) >> (64 - Bits));
+    }
+
+    raw_t v;
+};
+
+template <int Ba, int Bb, int R>
+constexpr Fixed<(Ba > Bb ? Ba : Bb) + 1, R> operator+(Fixed<Ba, R> a, Fixed<Bb, R> b)
+{
+    return Fixed<(Ba > Bb ? Ba : Bb) + 1, R>::from_raw((int64_t)a.raw() + b.raw());
+}
+
+template <int Ba, int Bb, int R>
+constexpr Fixed<(Ba > Bb ? Ba : Bb) + 1, R> operator-(Fixed<Ba, R> a, Fixed<Bb, R> b)
+{
+    return Fixed<(Ba > Bb ? Ba : Bb) + 1, R>::from_raw((int64_t)a.raw() - b.raw());
+}
+
+template <int B, int R>
+constexpr Fixed<B + 1, R> operator-(Fixed<B, R> a)
+{
+    return Fixed<B + 1, R>::from_raw(-(int64_t)a.raw());
+}
+
+template <int Ba, int Ra, int Bb, int Rb>
+constexpr Fixed<Ba + Bb, Ra + Rb> operator*(Fixed<Ba, Ra> a, Fixed<Bb, Rb> b)
+{
+    return Fixed<Ba + Bb, Ra + Rb>::from_raw((int64_t)a.raw() * b.raw());
+}
+
+template <int Ba, int Bb, int R>
+constexpr bool operator==(Fixed<Ba, R> a, Fixed<Bb, R> b) { return (int64_t)a.raw() == b.raw(); }
+template <int Ba, int Bb, int R>
+constexpr bool operator!=(Fixed<Ba, R> a, Fixed<Bb, R> b) { return (int64_t)a.raw() != b.raw(); }
+template <int Ba, int Bb, int R>
+constexpr bool operator<(Fixed<Ba, R> a, Fixed<Bb, R> b) { return (int64_t)a.raw() < b.raw(); }
+template <int Ba, int Bb, int R>
+constexpr bool operator<=(Fixed<Ba, R> a, Fixed<Bb, R> b) { return (int64_t)a.raw() <= b.raw(); }
+template <int Ba, int Bb, int R>
+constexpr bool operator>(Fixed<Ba, R> a, Fixed<Bb, R> b) { return (int64_t)a.raw() > b.raw(); }
+template <int Ba, int Bb, int R>
+constexpr bool operator>=(Fixed<Ba, R> a, Fixed<Bb, R> b) { return (int64_t)a.raw() >= b.raw(); }
+
+#endif
@@ -0,0 +1,500 @@
+#include "helper.h"
+#include "pipeline.h"
+extern "C"{
+#include "gold_ahead.h"
+#include "rasterizer.h"
+#include "rast_types.h"
+}
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+typedef struct { // expected hits of one triangle that reaches the sample test
+  long          index;   // triangle number in the vector
+  int           v[6];    // v0.x v0.y v1.x v1.y v2.x v2.y
+  BoundingBox   bbox;
+  int           nx;      // grid samples per bbox row
+  int           ny;      // grid sample rows
+  int           hits;    // samples that hit
+  bool          cached;  // bits holds the coverage
+  vector<uchar> bits;
+} AheadTriangle;
+
+/* Golden Stream File Format:
+   /
+   /   GoldenHeader, then one GoldenRecord per triangle that reaches
+   /   the sample test, in input order. Each record is followed by
+   /   `bytes` bytes of coverage bitmap (row-major over the bbox grid,
+   /   bit id of byte id/8), padded to 4 bytes. bytes is 0 when the
+   /   bbox was too big to precompute.
+*/
+#define GOLDEN_MAGIC 0x5347424a // "JBGS"
+#define GOLDEN_VERSION 1
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  int32_t  width;      // screen, fixed point
+  int32_t  height;
+  int32_t  ss;         // MSAA
+  int32_t  ss_w_lg2;
+  int32_t  r_shift;
+  uint32_t reserved;
+  uint64_t triangles;  // records that follow
+} GoldenHeader;
+
+typedef struct {
+  int64_t  index;
+  int32_t  v[6];
+  int32_t  ll_x, ll_y, ur_x, ur_y;
+  int32_t  nx, ny;
+  int32_t  hits;
+  uint32_t bytes;
+} GoldenRecord;
+
+struct AheadStream {
+  AheadStream( size_t depth ) : queue( depth ), map( NULL ), map_size( 0 ), map_pos( 0 ),
+                                map_left( 0 ), cur_valid( false ), drained( false ),
+                                missed_run( 0 ), answered( 0 ), fallbacks( 0 ), skipped( 0 ),
+                                unmatched( 0 ) {}
+
+  Screen                       screen;
+  Config                       config;
+  // gold thread source
+  ifstream                     file;
+  BoundedQueue<AheadTriangle>  queue;
+  thread                       producer;
+  // golden file source
+  const uchar*                 map;
+  size_t                       map_size;
+  size_t                       map_pos;
+  uint64_t                     map_left;  // records not yet read
+  // consumer side
+  deque<AheadTriangle>         window;  // read, not yet matched
+  AheadTriangle                cur;
+  bool                         cur_valid;
+  bool                         drained;
+  int                          missed_run; // RTL triangles in a row not in the window
+  // statistics
+  long                         answered;
+  long                         fallbacks;
+  long                         skipped;
+  long                         unmatched;  // RTL triangles not found in the stream
+};
+
+static AheadStream* streams[GOLD_AHEAD_MAX_STREAMS];
+static mutex streams_m;
+
+/*
+ *  Same walk as rasterize_triangle, recording which jittered
+ *  samples of the bounding box hit. sample_test_setup gives
+ *  sample_test's answer on every sample, so the bits are the
+ *  reference coverage.
+ */
+static void ahead_coverage( AheadTriangle& t, Triangle& triangle, Screen& screen, Config& config )
+{
+  int ss_i = (int)config.ss_i;
+  t.nx = (t.bbox.upper_right.x - t.bbox.lower_left.x) / ss_i + 1;
+  t.ny = (t.bbox.upper_right.y - t.bbox.lower_left.y) / ss_i + 1;
+  t.cached = (size_t)t.nx * t.ny <= GOLD_AHEAD_MAX_SAMPLES;
+  if( !t.cached ){
+    t.hits = rasterize_triangle( triangle, NULL, screen, config );
+    return;
+  }
+
+  t.bits.assign( ((size_t)t.nx * t.ny + 7) / 8, 0 );
+  t.hits = 0;
+
+  TriangleSetup setup = triangle_setup( triangle );
+  Sample sample;
+  size_t id = 0;
+  for( int j = 0 ; j < t.ny ; j++ ){
+    sample.y = t.bbox.lower_left.y + j * ss_i;
+    for( int i = 0 ; i < t.nx ; i++, id++ ){
+      sample.x = t.bbox.lower_left.x + i * ss_i;
+
+      Sample jitter = jitter_sample( sample, config.ss_w_lg2 );
+      Sample jittered_sample;
+      jittered_sample.x = sample.x + (jitter.x << 2);
+      jittered_sample.y = sample.y + (jitter.y << 2);
+
+      if( sample_test_setup( &setup, jittered_sample ) ){
+        t.bits[id >> 3] |= 1 << (id & 7);
+        t.hits++;
+      }
+    }
+  }
+}
+
+/*
+ *  Next triangle of the vector that rast_driver feeds and the
+ *  bounding box accepts, with its coverage. False at end of file.
+ */
+static bool ahead_next( ifstream& file, Screen& screen, Config& config, long& index,
+                        AheadTriangle& t )
+{
+  Triangle triangle;
+  bool valid;
+
+  while( load_triangle( file, triangle, valid ) ){
+    index++;
+    if( !valid )
+      continue;
+
+    t.bbox = get_bounding_box( triangle, screen, config );
+    if( !t.bbox.valid )
+      continue;
+
+    t.index = index;
+    for( int k = 0 ; k < 3 ; k++ ){
+      t.v[2*k]     = triangle.v[k].x;
+      t.v[2*k + 1] = triangle.v[k].y;
+    }
+    ahead_coverage( t, triangle, screen, config );
+    return true;
+  }
+  return false;
+}
+
+// Producer of a gold thread stream
+static void ahead_stage( AheadStream* s )
+{
+  AheadTriangle t;
+  long index = 0;
+
+  while( ahead_next( s->file, s->screen, s->config, index, t ) ){
+    if( !s->queue.push( std::move( t ) ) )
+      break; // closed by gold_ahead_close
+  }
+
+  s->queue.close();
+}
+
+static int ahead_register( AheadStream* s )
+{
+  lock_guard<mutex> lock( streams_m );
+  for( int i = 0 ; i < GOLD_AHEAD_MAX_STREAMS ; i++ ){
+    if( streams[i] == NULL ){
+      streams[i] = s;
+      return i;
+    }
+  }
+  printf( "[ERROR] gold-ahead: all %d streams are in use\n", GOLD_AHEAD_MAX_STREAMS );
+  return -1;
+}
+
+int gold_ahead_open( const char* file_name )
+{
+  AheadStream* s = new AheadStream( GOLD_AHEAD_DEPTH );
+  s->file.open( file_name );
+  if( !s->file.is_open() ){
+    printf( "[ERROR] gold-ahead: cannot open %s\n", file_name );
+    delete s;
+    return -1;
+  }
+
+  // load_header aborts on any other format (JB21I meshes included),
+  // the driver gets -1 and checks synchronously instead
+  string format;
+  getline( s->file, format );
+  if( format != "JB21" ){
+    printf( "[ERROR] gold-ahead: %s is not a JB21 vector (\"%s\")\n", file_name, format.c_str() );
+    delete s;
+    return -1;
+  }
+  s->file.seekg( 0 );
+
+  s->config.r_shift = 10;
+  load_header( s->file, s->screen, s->config );
+
+  int handle = ahead_register( s );
+  if( handle < 0 ){
+    delete s;
+    return -1;
+  }
+
+  s->producer = thread( ahead_stage, s );
+  return handle;
+}
+
+int golden_stream_open( const char* file_name )
+{
+  int fd = open( file_name, O_RDONLY );
+  struct stat st;
+  if( fd < 0 || fstat( fd, &st ) ){
+    printf( "[ERROR] golden stream: cannot open %s\n", file_name );
+    if( fd >= 0 )
+      close( fd );
+    return -1;
+  }
+
+  size_t size = st.st_size;
+  void* map = size >= sizeof( GoldenHeader ) ?
+    mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 ) : MAP_FAILED;
+  close( fd );
+
+  const GoldenHeader* h = (const GoldenHeader*)map;
+  if( map == MAP_FAILED || h->magic != GOLDEN_MAGIC || h->version != GOLDEN_VERSION ){
+    printf( "[ERROR] golden stream: %s is not a version %d golden stream\n",
+            file_name, GOLDEN_VERSION );
+    if( map != MAP_FAILED )
+      munmap( map, size );
+    return -1;
+  }
+  madvise( map, size, MADV_SEQUENTIAL );
+
+  AheadStream* s = new AheadStream( 1 );
+  s->map = (const uchar*)map;
+  s->map_size = size;
+  s->map_pos = sizeof( GoldenHeader );
+  s->map_left = h->triangles;
+  s->screen.width = h->width;
+  s->screen.height = h->height;
+  s->config.ss = h->ss;
+  s->config.ss_w_lg2 = h->ss_w_lg2;
+  s->config.ss_w = 1 << h->ss_w_lg2;
+  s->config.ss_i = 1024 / s->config.ss_w;
+  s->config.r_shift = h->r_shift;
+
+  int handle = ahead_register( s );
+  if( handle < 0 ){
+    munmap( map, size );
+    delete s;
+  }
+  return handle;
+}
+
+// Next record of the file; false at the end or on a truncated file
+static bool golden_next( AheadStream* s, AheadTriangle& t )
+{
+  if( s->map_left == 0 || s->map_pos + sizeof( GoldenRecord ) > s->map_size )
+    return false;
+
+  GoldenRecord r;
+  memcpy( &r, s->map + s->map_pos, sizeof( r ) );
+  size_t padded = (r.bytes + 3) & ~(size_t)3;
+  if( s->map_pos + sizeof( r ) + padded > s->map_size ){
+    printf( "[ERROR] golden stream: truncated after %llu records left\n",
+            (unsigned long long)s->map_left );
+    s->map_left = 0;
+    return false;
+  }
+
+  t.index = r.index;
+  memcpy( t.v, r.v, sizeof( t.v ) );
+  t.bbox.lower_left.x = r.ll_x;
+  t.bbox.lower_left.y = r.ll_y;
+  t.bbox.upper_right.x = r.ur_x;
+  t.bbox.upper_right.y = r.ur_y;
+  t.bbox.valid = true;
+  t.nx = r.nx;
+  t.ny = r.ny;
+  t.hits = r.hits;
+  t.cached = r.bytes != 0;
+  const uchar* bits = s->map + s->map_pos + sizeof( r );
+  t.bits.assign( bits, bits + r.bytes );
+
+  s->map_pos += sizeof( r ) + padded;
+  s->map_left--;
+  return true;
+}
+
+static AheadStream* ahead_stream( int stream )
+{
+  if( stream < 0 || stream >= GOLD_AHEAD_MAX_STREAMS )
+    return NULL;
+  return streams[stream];
+}
+
+// Read records until the window holds n or the stream ends
+static void ahead_fill( AheadStream* s, size_t n )
+{
+  while( !s->drained && s->window.size() < n ){
+    AheadTriangle t;
+    if( s->map ? !golden_next( s, t ) : !s->queue.pop( t ) ){
+      s->drained = true;
+      break;
+    }
+    s->window.push_back( std::move( t ) );
+  }
+}
+
+static size_t ahead_find( const AheadStream* s, const int* tri, size_t from )
+{
+  for( size_t k = from ; k < s->window.size() ; k++ ){
+    if( !memcmp( s->window[k].v, tri, sizeof( s->window[k].v ) ) )
+      return k;
+  }
+  return s->window.size();
+}
+
+/*
+ *  Drop the n oldest records of the window, triangles the RTL never
+ *  sent to the sample test. Identical consecutive triangles look like
+ *  one to the RTL side, so a copy of the current one goes silently.
+ */
+static void ahead_skip( AheadStream* s, size_t n )
+{
+  for( size_t i = 0 ; i < n ; i++ ){
+    AheadTriangle& gone = s->window.front();
+    if( !s->cur_valid || memcmp( gone.v, s->cur.v, sizeof( gone.v ) ) ){
+      printf( "[ERROR] gold-ahead: triangle %ld reached no sample test\n", gone.index );
+      s->skipped++;
+    }
+    s->window.pop_front();
+  }
+}
+
+/*
+ *  Move to the record of a new RTL triangle. It is searched for in
+ *  the next GOLD_AHEAD_LOOKAHEAD records, then up to GOLD_AHEAD_DEPTH
+ *  ahead, so the stream resyncs after the RTL skips a run of
+ *  triangles. One not found at all is left to the synchronous check.
+ *  A second one in a row means the window is behind the RTL: its
+ *  records are skipped, so the next triangle searches fresh ones
+ *  instead of the stream degrading to the synchronous check for good.
+ */
+static void ahead_advance( AheadStream* s, const int* tri )
+{
+  ahead_fill( s, GOLD_AHEAD_LOOKAHEAD );
+  size_t k = ahead_find( s, tri, 0 );
+  if( k == s->window.size() ){
+    ahead_fill( s, GOLD_AHEAD_DEPTH );
+    k = ahead_find( s, tri, k );
+  }
+
+  if( k < s->window.size() ){
+    ahead_skip( s, k );
+    s->cur = std::move( s->window.front() );
+    s->window.pop_front();
+    s->cur_valid = true;
+    s->missed_run = 0;
+    return;
+  }
+
+  // not in the stream: leave it to the synchronous check
+  s->unmatched++;
+  s->cur_valid = false;
+  if( s->missed_run++ > 0 )
+    ahead_skip( s, s->window.size() );
+}
+
+int gold_ahead_lookup( int stream, const int* tri, int s_x, int s_y )
+{
+  AheadStream* s = ahead_stream( stream );
+  if( s == NULL )
+    return -1;
+
+  if( !s->cur_valid || memcmp( s->cur.v, tri, sizeof( s->cur.v ) ) )
+    ahead_advance( s, tri );
+
+  int hit = -1;
+  if( s->cur_valid && s->cur.cached ){
+    // the jitter is smaller than the grid, round down to the sample
+    int shift = s->config.r_shift - s->config.ss_w_lg2;
+    int gx = ((s_x >> shift) << shift) - s->cur.bbox.lower_left.x;
+    int gy = ((s_y >> shift) << shift) - s->cur.bbox.lower_left.y;
+    int i = gx >> shift;
+    int j = gy >> shift;
+    if( gx >= 0 && gy >= 0 && i < s->cur.nx && j < s->cur.ny ){
+      size_t id = (size_t)j * s->cur.nx + i;
+      hit = (s->cur.bits[id >> 3] >> (id & 7)) & 1;
+    }
+  }
+
+  if( hit < 0 )
+    s->fallbacks++;
+  else
+    s->answered++;
+  return hit;
+}
+
+int gold_ahead_close( int stream )
+{
+  AheadStream* s = ahead_stream( stream );
+  if( s == NULL )
+    return 0;
+
+  if( s->map ){
+    munmap( (void*)s->map, s->map_size );
+  } else {
+    s->queue.close();
+    s->producer.join();
+  }
+
+  printf( "Gold-ahead: %ld samples from the stream, %ld checked directly, %ld triangles skipped, "
+          "%ld not in the stream\n", s->answered, s->fallbacks, s->skipped, s->unmatched );
+
+  {
+    lock_guard<mutex> lock( streams_m );
+    streams[stream] = NULL;
+  }
+  delete s;
+  return 1;
+}
+
+long golden_stream_write( const char* file_in, const char* file_out )
+{
+  ifstream myfile( file_in );
+  if( !myfile.is_open() )
+    abort_("Failed to Open Vector File for Read");
+
+  Screen screen;
+  Config config;
+  config.r_shift = 10;
+  load_header( myfile, screen, config );
+
+  FILE* stream = fopen( file_out, "wb" );
+  if( stream == NULL )
+    abort_("Failed to Open Golden Stream File for Write");
+
+  GoldenHeader h;
+  memset( &h, 0, sizeof( h ) );
+  h.magic = GOLDEN_MAGIC;
+  h.version = GOLDEN_VERSION;
+  h.width = screen.width;
+  h.height = screen.height;
+  h.ss = config.ss;
+  h.ss_w_lg2 = config.ss_w_lg2;
+  h.r_shift = config.r_shift;
+  fwrite( &h, sizeof( h ), 1, stream ); // count is patched in below
+
+  AheadTriangle t;
+  long index = 0;
+  static const uchar pad[4] = { 0, 0, 0, 0 };
+  while( ahead_next( myfile, screen, config, index, t ) ){
+    GoldenRecord r;
+    r.index = t.index;
+    memcpy( r.v, t.v, sizeof( r.v ) );
+    r.ll_x = t.bbox.lower_left.x;
+    r.ll_y = t.bbox.lower_left.y;
+    r.ur_x = t.bbox.upper_right.x;
+    r.ur_y = t.bbox.upper_right.y;
+    r.nx = t.nx;
+    r.ny = t.ny;
+    r.hits = t.hits;
+    r.bytes = t.cached ? t.bits.size() : 0;
+
+    fwrite( &r, sizeof( r ), 1, stream );
+    if( r.bytes ){
+      fwrite( &t.bits[0], 1, r.bytes, stream );
+      fwrite( pad, 1, ((r.bytes + 3) & ~3u) - r.bytes, stream );
+    }
+    h.triangles++;
+  }
+
+  fseek( stream, 0, SEEK_SET );
+  fwrite( &h, sizeof( h ), 1, stream );
+  fclose( stream );
+
+  return (long)h.triangles;
+}
@@ -0,0 +1,53 @@
+#ifndef GOLD_AHEAD_H
+#define GOLD_AHEAD_H
+
+/*
+ *  Gold-ahead expected sample stream for co-simulation.
+ *
+ *  gold_ahead_open starts a thread that reads the same JB21 vector
+ *  as rast_driver and, for every triangle that reaches the sample
+ *  test, precomputes which samples of its bounding box hit. The
+ *  records wait in a bounded buffer in input order, so the thread
+ *  runs ahead of the RTL on a spare core and the per-cycle check
+ *  becomes a bitmap lookup.
+ *
+ *  Handles are small ints for the DPI; -1 means no stream, also
+ *  for a vector that is not JB21, so the driver can check
+ *  synchronously instead.
+ */
+
+#define GOLD_AHEAD_MAX_STREAMS 16
+#define GOLD_AHEAD_DEPTH 256       // triangles buffered ahead of the RTL, and searched to resync
+#define GOLD_AHEAD_LOOKAHEAD 4     // records searched first when the RTL skips one
+#define GOLD_AHEAD_MAX_SAMPLES (1 << 20) // larger bounding boxes are not precomputed
+
+int gold_ahead_open(const char* file_name);
+
+/*
+ *  Expected hit of a jittered sample of triangle tri (v0.x v0.y v1.x
+ *  v1.y v2.x v2.y). A new triangle advances the stream to its record.
+ *  Returns 1 or 0, or -1 when the stream can't answer (triangle not
+ *  in the stream, or not precomputed). The record is built with the
+ *  edge setup, which answers as sample_test on every sample
+ *  (rasterizer_gold --selftest checks this lookup against it).
+ */
+int gold_ahead_lookup(int stream, const int* tri, int s_x, int s_y);
+
+// Stop the thread (or unmap the file), print statistics (skipped
+// triangles, RTL triangles not in the stream), release the handle
+int gold_ahead_close(int stream);
+
+/*
+ *  Offline golden streams: the same records, computed once by
+ *  `rasterizer_gold --golden <file_out> <vector>` and replayed from
+ *  an mmap of the file, so the gold model does not run at all during
+ *  simulation. Records depend on the vector (screen and MSAA are in
+ *  its header) but not on the RTL lane count. golden_stream_open
+ *  returns a handle for gold_ahead_lookup/gold_ahead_close.
+ */
+int golden_stream_open(const char* file_name);
+
+// Write the golden stream of a JB21 vector; returns the records written
+long golden_stream_write(const char* file_in, const char* file_out);
+
+#endif
@@ -27,98 +27,136 @@ void abort_(const char * s, ...)
    /       r,g,b,a floats [0,1]
 */
 
-void load_file(char* file_name, vector<Triangle>& triangles, Screen& screen, Config &config)
+/*
+ *  Check the JB21 tag and read the screen line. Leaves the
+ *  stream at the first triangle.
+ */
+void load_header(ifstream& myfile, Screen& screen, Config &config)
 {
     char buf[256];
-    
-    int valid, integer;
-
-    ifstream myfile (file_name);  /* Open File for Read */
-
-    if( ! myfile.is_open() )
-        abort_("Failed to Open Vector File for Read");
 
     /* Check First Line */
     myfile.getline( buf, 256 , '\n'); // First Line
-    if( !strcmp( buf , "JB21" ) ){
+    if( strcmp( buf , "JB21" ) ){
+        printf( "%s\n" ,buf );
+        abort_("File is Incorrect Format");
+    }
+
+    printf( "File type JB21 found, begin parsing\n");
+
+    /* Grab Config From Second Line */
+    myfile>>hex>>screen.width;
+    // screen.width = integer / 1024;
+
+    myfile>>hex>>screen.height;
+    // screen.height = integer / 1024;
 
-        printf( "File type JB21 found, begin parsing\n");
+    myfile>>dec>>config.ss;
+    switch( config.ss )
+    {
+    case 1:  config.ss_w = 1 ;  config.ss_w_lg2 = 0 ; break ;
+    case 4:  config.ss_w = 2 ;  config.ss_w_lg2 = 1 ; break ;
+    case 16: config.ss_w = 4 ;  config.ss_w_lg2 = 2 ; break ;
+    case 64: config.ss_w = 8 ;  config.ss_w_lg2 = 3 ; break ;
+    }
+    config.ss_i = 1024 / config.ss_w;
+
+    // cout<<"Debug: \tw="<<*w<<" \th="<<*h<<" \tss="<<*ss<<endl;
+}
 
-        /* Grab Config From Second Line */
-        myfile>>hex>>screen.width;
-        // screen.width = integer / 1024;
+/*
+ *  Read the next triangle line. Returns false at the end of the file.
+ */
+bool load_triangle_line(ifstream& myfile, TriangleLine& line)
+{
+    line.valid = 0;
+    line.vertices = 0;
 
-        myfile>>hex>>screen.height;
-        // screen.height = integer / 1024;
+    if( myfile.eof() )
+        return false;
 
-        myfile>>dec>>config.ss;
-        switch( config.ss )
-        {
-        case 1:  config.ss_w = 1 ;  config.ss_w_lg2 = 0 ; break ;
-        case 4:  config.ss_w = 2 ;  config.ss_w_lg2 = 1 ; break ;
-        case 16: config.ss_w = 4 ;  config.ss_w_lg2 = 2 ; break ;
-        case 64: config.ss_w = 8 ;  config.ss_w_lg2 = 3 ; break ;
+    myfile>>dec>>line.valid;
+
+    //Get the Vertice Count
+    myfile>>dec>>line.vertices;
+
+    if(line.vertices <3 || line.vertices > 4){
+        //not safe, must guarentee input
+        printf("End of File, %i\n" , line.vertices );
+        return false;
+    }
+
+    // test vectors always have a 4th vertex
+    for( int vertex = 0 ; vertex < 4 ; vertex++ ){
+        //Vertice Screen Space Positions
+        for(int axis = 0; axis < 3; axis++){
+            myfile >> hex >> line.v[vertex][axis];
         }
-        config.ss_i = 1024 / config.ss_w;
-
-        // cout<<"Debug: \tw="<<*w<<" \th="<<*h<<" \tss="<<*ss<<endl;
-
-        while( ! myfile.eof() ){
-            myfile>>dec>>valid;
-
-            //Get the Vertice Count
-            int vertices;
-            myfile>>dec>>vertices;
-
-            if(vertices <3 || vertices > 4){
-                //not safe, must guarentee input
-                printf("End of File, %i\n" , vertices );
-                return;
-            }
-
-            Triangle triangle;
-            for( int vertex = 0 ; vertex < 3 ; vertex++ ){
-                //Vertice Screen Space Positions
-                myfile >> hex >> triangle.v[vertex].x;
-                myfile >> hex >> triangle.v[vertex].y;
-                myfile >> hex >> triangle.v[vertex].z;
-                // for(int axis = 0; axis < 3; axis++){
-                //     myfile >> hex >> triangle.v[vertex].axis[axis];
-                // }
-                
-            }
-            
-            // test vectors have a 4th vertex, so ignore
-            for(int vertex = 3; vertex < 4; vertex++){
-                int dummy;
-                for(int axis = 0; axis < 3; axis++){
-                    myfile >> hex >> dummy;
-                }
-            }
-
-            // Colors for vertice
-            myfile >> hex >> triangle.v[0].R;
-            myfile >> hex >> triangle.v[0].G;
-            myfile >> hex >> triangle.v[0].B;
-
-            // copy the color of the first vertex to the others
-            // FIXME: this should be 3!!
-            for( int vertex = 1; vertex < 3 ; vertex++ ){
-                triangle.v[vertex].R = triangle.v[0].R;
-                triangle.v[vertex].G = triangle.v[0].G;
-                triangle.v[vertex].B = triangle.v[0].B;
-                // for( int color = 0 ; color < 4 ; color++ ){
-                //     triangle.v[vertex].c[color] = triangle.v[0].c[color];
-                // }
-            }
-
-            if(valid){
-                triangles.push_back(triangle);
-            }
+    }
+
+    // Colors for vertice
+    for( int color = 0 ; color < 3 ; color++ ){
+        myfile >> hex >> line.color[color];
+    }
+
+    return true;
+}
+
+void triangle_from_line(const TriangleLine& line, Triangle& triangle)
+{
+    for( int vertex = 0 ; vertex < 3 ; vertex++ ){
+        triangle.v[vertex].x = line.v[vertex][0];
+        triangle.v[vertex].y = line.v[vertex][1];
+        triangle.v[vertex].z = line.v[vertex][2];
+    }
+
+    // copy the color of the first vertex to the others
+    // FIXME: this should be 3!!
+    for( int vertex = 0; vertex < 3 ; vertex++ ){
+        triangle.v[vertex].R = line.color[0];
+        triangle.v[vertex].G = line.color[1];
+        triangle.v[vertex].B = line.color[2];
+    }
+}
+
+bool load_triangle(ifstream& myfile, Triangle& triangle, bool& valid)
+{
+    TriangleLine line;
+
+    if( !load_triangle_line(myfile, line) )
+        return false;
+
+    triangle_from_line(line, triangle);
+    valid = line.valid != 0;
+    return true;
+}
+
+unsigned long long triangle_tag(unsigned long long h, const Triangle& triangle)
+{
+    for( int v = 0 ; v < 3 ; v++ ){
+        const ColorVertex3D& c = triangle.v[v];
+        int fields[6] = { c.x, c.y, c.z, c.R, c.G, c.B };
+        for( int k = 0 ; k < 6 ; k++ )
+            h = ( h ^ (unsigned)fields[k] ) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+void load_file(char* file_name, vector<Triangle>& triangles, Screen& screen, Config &config)
+{
+    ifstream myfile (file_name);  /* Open File for Read */
+
+    if( ! myfile.is_open() )
+        abort_("Failed to Open Vector File for Read");
+
+    load_header(myfile, screen, config);
+
+    Triangle triangle;
+    bool valid;
+    while( load_triangle(myfile, triangle, valid) ){
+        if(valid){
+            triangles.push_back(triangle);
         }
-    } else {
-        printf( "%s\n" ,buf );
-        abort_("File is Incorrect Format");
     }
     
     myfile.close();
@@ -40,6 +40,30 @@ using namespace std;
 
 void abort_(const char * s, ...);
 
+void load_header(ifstream& myfile, Screen& screen, Config &config);
+
+typedef struct { // one triangle line, field by field
+    int valid;
+    int vertices;
+    int v[4][3];   // x y z, the 4th vertex is unused by the gold model
+    int color[3];  // R G B
+} TriangleLine;
+
+bool load_triangle_line(ifstream& myfile, TriangleLine& line);
+
+void triangle_from_line(const TriangleLine& line, Triangle& triangle);
+
+bool load_triangle(ifstream& myfile, Triangle& triangle, bool& valid);
+
+/*
+ *  FNV-1a of a triangle's x y z R G B per vertex, chained from h. Folded
+ *  over the valid triangles of a vector from TRIANGLE_TAG_INIT it is the
+ *  tag z-buffer snapshots keep of the prefix they hold.
+ */
+#define TRIANGLE_TAG_INIT 0xcbf29ce484222325ull
+
+unsigned long long triangle_tag(unsigned long long h, const Triangle& triangle);
+
 void load_file(char* file_name, vector<Triangle>& triangles, Screen& screen, Config &config);
 
 void write_ppm_file( 
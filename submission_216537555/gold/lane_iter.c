@@ -0,0 +1,93 @@
+#include "lane_iter.h"
+#include "rasterizer.h"
+
+bool lane_iter_begin(LaneIter *it, Triangle triangle, Screen screen, Config config,
+                     int lanes, int order)
+{
+  it->lanes = lanes < 1 ? 1 : (lanes > LANE_ITER_MAX_LANES ? LANE_ITER_MAX_LANES : lanes);
+  it->order = order;
+  it->ss_w_lg2 = config.ss_w_lg2;
+  it->ss_i = 1 << (config.r_shift - config.ss_w_lg2);
+  it->box = get_bounding_box(triangle, screen, config);
+  it->setup = triangle_setup(triangle);
+  it->next = it->box.lower_left;
+  it->cycle = 0;
+  it->done = !it->box.valid;
+  return it->box.valid;
+}
+
+int lane_iter_next(LaneIter *it, LaneSample *group)
+{
+  if (it->done)
+    return 0;
+
+  bool rows = it->order == LANE_ORDER_ROWS;
+  Vertex2D ur = it->box.upper_right;
+  bool far_edge = false; // some lane on the last line
+
+  for (int l = 0; l < it->lanes; l++)
+  {
+    LaneSample *s = &group[l];
+    s->cycle = it->cycle;
+    s->lane = l;
+    s->sample = it->next;
+    if (rows)
+      s->sample.y += l * it->ss_i;
+    else
+      s->sample.x += l * it->ss_i;
+
+    Sample jitter = jitter_sample(s->sample, it->ss_w_lg2);
+    s->jitter.x = jitter.x << 2;
+    s->jitter.y = jitter.y << 2;
+
+    Sample jittered_sample;
+    jittered_sample.x = s->sample.x + s->jitter.x;
+    jittered_sample.y = s->sample.y + s->jitter.y;
+    s->hit = sample_test_setup(&it->setup, jittered_sample);
+    s->in_box = s->sample.x <= ur.x && s->sample.y <= ur.y;
+
+    if (rows ? s->sample.y >= ur.y : s->sample.x >= ur.x)
+      far_edge = true;
+  }
+
+  // Step lane A like test_iterator: along the line, else to the next group of lines
+  bool line_end = rows ? it->next.x >= ur.x : it->next.y >= ur.y;
+  if (line_end && far_edge)
+  {
+    it->done = true;
+  }
+  else if (line_end && rows)
+  {
+    it->next.x = it->box.lower_left.x;
+    it->next.y += it->lanes * it->ss_i;
+  }
+  else if (line_end)
+  {
+    it->next.y = it->box.lower_left.y;
+    it->next.x += it->lanes * it->ss_i;
+  }
+  else if (rows)
+  {
+    it->next.x += it->ss_i;
+  }
+  else
+  {
+    it->next.y += it->ss_i;
+  }
+
+  it->cycle++;
+  return it->lanes;
+}
+
+long lane_iter_cycles(BoundingBox box, Config config, int lanes, int order)
+{
+  if (!box.valid)
+    return 0;
+
+  int ss_i = 1 << (config.r_shift - config.ss_w_lg2);
+  long cols = (box.upper_right.x - box.lower_left.x) / ss_i + 1;
+  long rows = (box.upper_right.y - box.lower_left.y) / ss_i + 1;
+  if (order == LANE_ORDER_ROWS)
+    return cols * ((rows + lanes - 1) / lanes);
+  return rows * ((cols + lanes - 1) / lanes);
+}
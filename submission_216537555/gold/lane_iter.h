@@ -0,0 +1,64 @@
+#ifndef LANE_ITER_H
+#define LANE_ITER_H
+
+#include <stdbool.h>
+#include "rast_types.h"
+
+/*
+ *  Lane-accurate sample order of test_iterator.
+ *
+ *  The RTL tests <lanes> samples per TEST cycle (lanes A, B, C ...,
+ *  hit_valid_R18H, _B, _C at the sample test). lane_iter_next hands
+ *  out the same groups, cycle by cycle, for any lane count:
+ *
+ *    LANE_ORDER_ROWS     test_iterator: lanes on consecutive rows,
+ *                        step right along the row, then up <lanes> rows
+ *    LANE_ORDER_COLUMNS  transposed: lanes on consecutive columns,
+ *                        step up the column, then right <lanes> columns
+ *
+ *  The box is done after the cycle where lane A is at the end of its
+ *  line and some lane is at the far edge, as in test_iterator. Lanes
+ *  of the last group may be past the box; they are tested all the same
+ *  (the RTL has no per-lane valid), and come with in_box false.
+ *
+ *  hit is sample_test_setup of the jittered sample, as in
+ *  rasterize_triangle.
+ */
+
+#define LANE_ORDER_ROWS 0
+#define LANE_ORDER_COLUMNS 1
+
+#define LANE_ITER_MAX_LANES 8
+
+typedef struct {
+  long cycle;       // TEST cycle of the triangle, 0 for the first
+  int lane;         // 0 is lane A
+  Sample sample;    // on the subsample grid
+  Sample jitter;    // offset added for the sample test
+  bool hit;
+  bool in_box;      // sample inside the bounding box
+} LaneSample;
+
+typedef struct {
+  int lanes;
+  int order;
+  int ss_w_lg2;
+  int ss_i;         // grid step
+  BoundingBox box;
+  TriangleSetup setup;
+  Sample next;      // lane A's sample in the next cycle
+  long cycle;
+  bool done;
+} LaneIter;
+
+// Start a triangle; false if it has no valid bounding box (no TEST cycles)
+bool lane_iter_begin(LaneIter *it, Triangle triangle, Screen screen, Config config,
+                     int lanes, int order);
+
+// Next cycle's group into group[0 .. lanes-1]; returns lanes, or 0 once the box is done
+int lane_iter_next(LaneIter *it, LaneSample *group);
+
+// TEST cycles of a valid box, without iterating it
+long lane_iter_cycles(BoundingBox box, Config config, int lanes, int order);
+
+#endif
@@ -0,0 +1,161 @@
+#include "mesh.h"
+extern "C"{
+#include "rasterizer.h"
+}
+
+using namespace std;
+
+/* File Format:
+   /
+   /   First Line: JB21I
+   /   Second Line: w,h,ss            (same as JB21)
+   /   Third Line: vertex count, triangle count (decimal)
+   /
+   /   One vertex per line:
+   /       x,y,z   hex, screen space fixed point
+   /       r,g,b   hex, [0,0xffff]
+   /
+   /   One triangle per line:
+   /       valid, i0, i1, i2   decimal vertex indices
+   /       the triangle takes the color of vertex i0
+*/
+
+bool is_mesh_file(char* file_name)
+{
+    char buf[256];
+
+    ifstream myfile (file_name);
+
+    if( ! myfile.is_open() )
+        abort_("Failed to Open Vector File for Read");
+
+    myfile.getline( buf, 256 , '\n');
+    return !strcmp( buf , "JB21I" );
+}
+
+void load_mesh_header(ifstream& myfile, Screen& screen, Config &config)
+{
+    char buf[256];
+
+    /* Check First Line */
+    myfile.getline( buf, 256 , '\n');
+    if( strcmp( buf , "JB21I" ) ){
+        printf( "%s\n" ,buf );
+        abort_("File is Incorrect Format");
+    }
+
+    printf( "File type JB21I found, begin parsing\n");
+
+    /* Grab Config From Second Line */
+    myfile>>hex>>screen.width;
+    myfile>>hex>>screen.height;
+    myfile>>dec>>config.ss;
+    switch( config.ss )
+    {
+    case 1:  config.ss_w = 1 ;  config.ss_w_lg2 = 0 ; break ;
+    case 4:  config.ss_w = 2 ;  config.ss_w_lg2 = 1 ; break ;
+    case 16: config.ss_w = 4 ;  config.ss_w_lg2 = 2 ; break ;
+    case 64: config.ss_w = 8 ;  config.ss_w_lg2 = 3 ; break ;
+    }
+    config.ss_i = 1024 / config.ss_w;
+}
+
+bool read_mesh_body(ifstream& myfile, Mesh& mesh, string& error)
+{
+    int valid, vertex_count, triangle_count;
+    char buf[256];
+
+    myfile>>dec>>vertex_count>>triangle_count;
+    if( ! myfile || vertex_count < 0 || triangle_count < 0 ){
+        error = "Bad mesh counts";
+        return false;
+    }
+
+    mesh.vertices.resize(vertex_count);
+    for( int i = 0 ; i < vertex_count ; i++ ){
+        ColorVertex3D& v = mesh.vertices[i];
+        myfile >> hex >> v.x >> v.y >> v.z;
+        myfile >> hex >> v.R >> v.G >> v.B;
+    }
+
+    mesh.triangles.reserve(triangle_count);
+    for( int i = 0 ; i < triangle_count ; i++ ){
+        MeshTriangle t;
+        myfile >> dec >> valid >> t.idx[0] >> t.idx[1] >> t.idx[2];
+        if( ! myfile ){
+            snprintf(buf, sizeof(buf), "Truncated mesh at triangle %d", i);
+            error = buf;
+            return false;
+        }
+
+        for( int k = 0 ; k < 3 ; k++ ){
+            if( t.idx[k] < 0 || t.idx[k] >= vertex_count ){
+                snprintf(buf, sizeof(buf), "Triangle %d references missing vertex %d", i, t.idx[k]);
+                error = buf;
+                return false;
+            }
+        }
+
+        if(valid){
+            mesh.triangles.push_back(t);
+        }
+    }
+    return true;
+}
+
+void load_mesh_body(ifstream& myfile, Mesh& mesh)
+{
+    string error;
+    if( ! read_mesh_body(myfile, mesh, error) )
+        abort_("%s", error.c_str());
+}
+
+void load_mesh_file(char* file_name, Mesh& mesh, Screen& screen, Config &config)
+{
+    ifstream myfile (file_name);  /* Open File for Read */
+
+    if( ! myfile.is_open() )
+        abort_("Failed to Open Vector File for Read");
+
+    load_mesh_header(myfile, screen, config);
+    load_mesh_body(myfile, mesh);
+
+    myfile.close();
+}
+
+/*
+ *  Expand the mesh into the same triangle list load_file would have built
+ *  from the equivalent JB21 file (color copied from the first vertex).
+ */
+void expand_mesh(const Mesh& mesh, vector<Triangle>& triangles)
+{
+    triangles.resize(mesh.triangles.size());
+    for( size_t i = 0 ; i < mesh.triangles.size() ; i++ ){
+        const MeshTriangle& t = mesh.triangles[i];
+        Triangle& triangle = triangles[i];
+        for( int vertex = 0 ; vertex < 3 ; vertex++ ){
+            triangle.v[vertex] = mesh.vertices[ t.idx[vertex] ];
+            triangle.v[vertex].R = mesh.vertices[ t.idx[0] ].R;
+            triangle.v[vertex].G = mesh.vertices[ t.idx[0] ].G;
+            triangle.v[vertex].B = mesh.vertices[ t.idx[0] ].B;
+        }
+    }
+}
+
+/*
+ *  Triangle setup for the whole mesh, straight from the vertex array.
+ *  Edges shared by neighbors are set up again rather than looked up:
+ *  edge_setup is two subtractions and two multiplies, cheaper than
+ *  finding the neighbor's copy.
+ */
+void setup_mesh(const Mesh& mesh, vector<TriangleSetup>& setups)
+{
+    setups.resize(mesh.triangles.size());
+    for( size_t i = 0 ; i < mesh.triangles.size() ; i++ ){
+        const MeshTriangle& t = mesh.triangles[i];
+        Triangle triangle;
+        for( int k = 0 ; k < 3 ; k++ )
+            triangle.v[k] = mesh.vertices[ t.idx[k] ];
+        setups[i] = triangle_setup(triangle);
+    }
+}
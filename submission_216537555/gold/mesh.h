@@ -0,0 +1,35 @@
+#if !defined( J_MESH )
+#define J_MESH
+
+#include <vector>
+
+#include "helper.h"
+#include "rast_types.h"
+
+using namespace std;
+
+typedef struct { // indexed triangle
+    int  idx[3];  // vertex indices, triangle color comes from idx[0]
+} MeshTriangle;
+
+typedef struct { // indexed vertex/triangle mesh
+    vector<ColorVertex3D> vertices;
+    vector<MeshTriangle>  triangles;
+} Mesh;
+
+bool is_mesh_file(char* file_name);
+
+void load_mesh_header(ifstream& myfile, Screen& screen, Config &config);
+
+// false with the reason in error on a malformed body
+bool read_mesh_body(ifstream& myfile, Mesh& mesh, string& error);
+
+void load_mesh_body(ifstream& myfile, Mesh& mesh);
+
+void load_mesh_file(char* file_name, Mesh& mesh, Screen& screen, Config &config);
+
+void expand_mesh(const Mesh& mesh, vector<Triangle>& triangles);
+
+void setup_mesh(const Mesh& mesh, vector<TriangleSetup>& setups);
+
+#endif
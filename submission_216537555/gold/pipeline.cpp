@@ -0,0 +1,248 @@
+#include "pipeline.h"
+#include "mesh.h"
+extern "C"{
+#include "rasterizer.h"
+#include "rast_types.h"
+#include "zbuff.h"
+}
+
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+typedef struct { // parse -> raster message
+  vector<Triangle>      triangles;
+  vector<TriangleSetup> setups;
+} Chunk;
+
+typedef struct { // raster -> resolve/write message, pixel rows [y0,y1)
+  int y0;
+  int y1;
+} Band;
+
+PipelineConfig pipeline_defaults()
+{
+  PipelineConfig pc;
+  pc.chunk = 1024;
+  pc.depth = 8;
+  pc.band_rows = 16;
+  return pc;
+}
+
+/*
+ *  Report a failed render: abort_ when the caller gave no error
+ *  string, otherwise hand the reason back and let it carry on.
+ */
+static size_t pipeline_fail( string* error, const string& reason )
+{
+  if( error == NULL )
+    abort_("%s", reason.c_str());
+  *error = reason;
+  return 0;
+}
+
+/*
+ *  Parse stage: stream triangles out of the file in chunks,
+ *  with their edge setup already done.
+ */
+static void parse_stage( ifstream* myfile, bool mesh_file, size_t chunk_size,
+                         BoundedQueue<Chunk>* out, string* error )
+{
+  Chunk chunk;
+
+  if( mesh_file ){
+    Mesh mesh;
+    vector<Triangle> triangles;
+    vector<TriangleSetup> setups;
+    string reason;
+    if( ! read_mesh_body( *myfile, mesh, reason ) ){
+      pipeline_fail( error, reason );
+      out->close();
+      return;
+    }
+    expand_mesh( mesh, triangles );
+    setup_mesh( mesh, setups );
+
+    for( size_t i = 0 ; i < triangles.size() ; i += chunk_size ){
+      size_t end = min( i + chunk_size, triangles.size() );
+      chunk.triangles.assign( triangles.begin() + i, triangles.begin() + end );
+      chunk.setups.assign( setups.begin() + i, setups.begin() + end );
+      out->push( chunk );
+    }
+  } else {
+    Triangle triangle;
+    bool valid;
+    while( load_triangle( *myfile, triangle, valid ) ){
+      if( !valid )
+        continue;
+      chunk.triangles.push_back( triangle );
+      chunk.setups.push_back( triangle_setup( triangle ) );
+      if( chunk.triangles.size() == chunk_size ){
+        out->push( chunk );
+        chunk.triangles.clear();
+        chunk.setups.clear();
+      }
+    }
+    if( !chunk.triangles.empty() )
+      out->push( chunk );
+  }
+
+  out->close();
+}
+
+/*
+ *  Resolve/write stage: average the subsamples of each band and
+ *  write its rows in place, so the PPM comes out in any band order.
+ *  Produces the same bytes as write_ppm.
+ */
+static void resolve_stage( ZBuff* zbuff, FILE* stream, BoundedQueue<Band>* in,
+                           atomic<int>* resolved )
+{
+  int w = zbuff->w;
+
+  fprintf( stream, "P6\n%d %d\n255\n", w, zbuff->h );
+  long header = ftell( stream );
+
+  vector<uchar> rows;
+  Band band;
+  while( in->pop( band ) ){
+    rows.resize( (size_t)( band.y1 - band.y0 ) * w * 3 );
+    for( int y = band.y0 ; y < band.y1 ; y++ ){
+      for( int x = 0 ; x < w ; x++ ){
+        uchar* rgb = &rows[ ( (size_t)( y - band.y0 ) * w + x ) * 3 ];
+        eval_ss( zbuff, rgb, &( zbuff->frame_buffer[ idx_f( zbuff, x, y, 0, 0, 0 ) ] ) );
+      }
+    }
+    fseek( stream, header + (long)band.y0 * w * 3, SEEK_SET );
+    fwrite( rows.data(), 1, rows.size(), stream );
+    resolved->fetch_add( band.y1 - band.y0 );
+  }
+
+  fclose( stream );
+}
+
+size_t render_pipelined( char* file_in, char* file_out, PipelineConfig pc, ZBuff** cache,
+                         string* error )
+{
+  Screen screen;
+  Config config;
+  config.r_shift = 10;
+  config.ss_w = 1; // the loaders divide by it, even for a bad MSAA
+  if( error != NULL )
+    error->clear();
+
+  /* Read the screen line up front, the z-buffer depends on it */
+  ifstream myfile( file_in );
+  if( ! myfile.is_open() )
+    return pipeline_fail( error, "Failed to Open Vector File for Read" );
+  string format;
+  getline( myfile, format );
+  myfile.seekg( 0 );
+  bool mesh_file = format == "JB21I";
+  if( ! mesh_file && format != "JB21" )
+    return pipeline_fail( error, "File is Incorrect Format" );
+  if( mesh_file )
+    load_mesh_header( myfile, screen, config );
+  else
+    load_header( myfile, screen, config );
+  bool ss_ok = config.ss == 1 || config.ss == 4 || config.ss == 16 || config.ss == 64;
+  if( ! myfile || screen.width / 1024 <= 0 || screen.height / 1024 <= 0 || ! ss_ok )
+    return pipeline_fail( error, "Bad screen line" );
+
+  FILE *stream = fopen( file_out, "wb" );
+  if( stream == NULL )
+    return pipeline_fail( error, "Failed to Open Image File for Write" );
+
+  ZBuff *zbuff = NULL;
+  if( cache != NULL && *cache != NULL ){
+    ZBuff *c = *cache;
+    if( c->w == screen.width / 1024 && c->h == screen.height / 1024 && c->config.ss == config.ss ){
+      zbuff = c;
+      zbuff->config = config;
+      zbuff_clear( zbuff );
+    } else {
+      zbuff_free( c );
+      *cache = NULL;
+    }
+  }
+  if( zbuff == NULL )
+    zbuff = zbuff_init( screen, config );
+  int h = zbuff->h;
+
+  BoundedQueue<Chunk> chunks( pc.depth );
+  BoundedQueue<Band> bands( ( h + pc.band_rows - 1 ) / pc.band_rows + 1 );
+  atomic<int> resolved( 0 );
+
+  thread parser( parse_stage, &myfile, mesh_file, pc.chunk, &chunks, error );
+  thread resolver( resolve_stage, zbuff, stream, &bands, &resolved );
+
+  /* Raster stage. Rows below the lowest row the current triangle can
+     touch are final as long as the input stays sorted, so hand them
+     to the resolver. If a triangle reaches back into a handed band,
+     wait for the resolver to go idle and redo those rows at the end. */
+  size_t count = 0;
+  int handed = 0;
+  bool banding = true;
+  int dirty_low = h;
+
+  Chunk chunk;
+  while( chunks.pop( chunk ) ){
+    for( size_t i = 0 ; i < chunk.triangles.size() ; i++ ){
+      BoundingBox bbox = get_bounding_box( chunk.triangles[i], screen, config );
+
+      /* rasterize_triangle walks the box even when it is not valid.
+         A culled triangle can only hit there if sample_test's
+         products can wrap, which is when its setup window is empty;
+         any other is skipped, and does not hold up the bands. */
+      const TriangleSetup& setup = chunk.setups[i];
+      bool wraps = setup.lo.x > setup.hi.x;
+      if( !bbox.valid && !wraps )
+        continue;
+      bool touches = bbox.lower_left.x <= bbox.upper_right.x
+                  && bbox.lower_left.y <= bbox.upper_right.y;
+
+      if( touches ){
+        int row = bbox.lower_left.y >> config.r_shift;
+        if( !banding ){
+          dirty_low = min( dirty_low, row );
+        } else if( row < handed ){
+          while( resolved.load() < handed )
+            this_thread::yield();
+          banding = false;
+          dirty_low = row;
+        } else {
+          while( handed + pc.band_rows <= min( row, h ) ){
+            Band band = { handed, handed + pc.band_rows };
+            bands.push( band );
+            handed += pc.band_rows;
+          }
+        }
+      }
+
+      rasterize_triangle_setup( chunk.triangles[i], &chunk.setups[i], zbuff, screen, config );
+    }
+    count += chunk.triangles.size();
+  }
+
+  for( int y = banding ? handed : min( dirty_low, handed ) ; y < h ; y += pc.band_rows ){
+    Band band = { y, min( y + pc.band_rows, h ) };
+    bands.push( band );
+  }
+  bands.close();
+
+  parser.join();
+  resolver.join();
+
+  if( cache != NULL )
+    *cache = zbuff;
+  else
+    zbuff_free( zbuff );
+
+  /* Don't leave a partial image behind for a vector that failed */
+  if( error != NULL && ! error->empty() ){
+    remove( file_out );
+    return 0;
+  }
+  return count;
+}
@@ -0,0 +1,93 @@
+#if !defined( J_PIPELINE )
+#define J_PIPELINE
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "helper.h"
+#include "rast_types.h"
+
+using namespace std;
+
+/*
+ *  Blocking FIFO between two pipeline stages. push() waits while
+ *  the queue is full, pop() waits while it is empty and returns
+ *  false once the producer has closed it and it has drained.
+ *  A consumer that quits early closes it too, which makes a
+ *  blocked push() return false.
+ */
+template <class T>
+class BoundedQueue
+{
+ public:
+  BoundedQueue( size_t capacity ) : capacity( capacity ), closed( false ) {}
+
+  bool push( T item )
+  {
+    unique_lock<mutex> lock( m );
+    not_full.wait( lock, [this]{ return items.size() < capacity || closed; } );
+    if( closed )
+      return false;
+    items.push_back( std::move( item ) );
+    not_empty.notify_one();
+    return true;
+  }
+
+  bool pop( T& item )
+  {
+    unique_lock<mutex> lock( m );
+    not_empty.wait( lock, [this]{ return !items.empty() || closed; } );
+    if( items.empty() )
+      return false;
+    item = std::move( items.front() );
+    items.pop_front();
+    not_full.notify_one();
+    return true;
+  }
+
+  void close()
+  {
+    unique_lock<mutex> lock( m );
+    closed = true;
+    not_empty.notify_all();
+    not_full.notify_all();
+  }
+
+ private:
+  size_t capacity;
+  bool closed;
+  deque<T> items;
+  mutex m;
+  condition_variable not_full;
+  condition_variable not_empty;
+};
+
+typedef struct { // knobs for render_pipelined
+  size_t chunk;      // triangles per parse -> raster message
+  size_t depth;      // messages buffered between stages
+  int    band_rows;  // pixel rows resolved and written at a time
+} PipelineConfig;
+
+PipelineConfig pipeline_defaults();
+
+/*
+ *  Render one vector with parse, raster and resolve/write running
+ *  as separate stages. While the input stays sorted by bounding
+ *  box bottom row, finished bands are resolved and written while
+ *  later triangles are still being parsed and rasterized. The
+ *  image is byte-identical to load_file + rasterize + write_ppm.
+ *  Returns the number of triangles rasterized.
+ *
+ *  If cache is not NULL, *cache is reused when it matches the
+ *  vector's screen and MSAA (and replaced otherwise), and is left
+ *  allocated for the next call. The caller frees it.
+ *
+ *  A bad vector or an unwritable image aborts, unless error is not
+ *  NULL: then the reason is stored there, no image is left behind
+ *  and 0 is returned.
+ */
+size_t render_pipelined( char* file_in, char* file_out, PipelineConfig pc, ZBuff** cache = NULL,
+                         string* error = NULL );
+
+#endif
@@ -0,0 +1,289 @@
+#include "helper.h"
+#include "mesh.h"
+extern "C"{
+#include "rasterizer.h"
+#include "rast_types.h"
+#include "zbuff.h"
+}
+
+#include <stdint.h>
+#include <chrono>
+
+/*
+
+   Rast Analyze
+     Reports the rasterization cost profile of a vector
+     without rendering it:
+       - bounding box size histogram in samples
+       - triangles culled by the back-face test in get_bounding_box
+       - triangles clamped to or rejected by the screen edges
+       - sample tests vs hits, and tests at every MSAA level
+       - per-sample overdraw histogram
+       - a predicted rasterizer_gold runtime
+
+     Build:
+       gcc -O2 -c rasterizer.c zbuff.c
+       g++ -O2 -o rast_analyze rastAnalyze.cpp helper.cpp mesh.cpp rasterizer.o zbuff.o
+
+     Usage:
+       rast_analyze <vector>
+*/
+
+#define HIST_BINS 24 // log2 buckets, last one collects the rest
+#define OVERDRAW_BINS 16
+
+typedef struct {
+    size_t triangles;
+    size_t back_culled;
+    size_t off_screen;  // bbox empty after clamping
+    size_t clamped;     // bbox cut by the screen edge but still valid
+    size_t valid;       // back_culled + off_screen + valid == triangles
+    size_t slivers;     // big bbox, almost no hits
+    uint64_t tests;
+    uint64_t hits;
+    uint64_t tests_ss[4]; // sample tests at ss_w_lg2 = 0..3
+    uint64_t largest_bbox;
+    uint64_t bbox_hist[HIST_BINS];
+    uint64_t overdraw_hist[OVERDRAW_BINS];
+} Profile;
+
+static int log2_bin(uint64_t v)
+{
+    int bin = 0;
+    while( v > 1 && bin < HIST_BINS - 1 ){
+        v >>= 1;
+        bin++;
+    }
+    return bin;
+}
+
+// Samples get_bounding_box would have rasterize_triangle visit
+static uint64_t bbox_samples(BoundingBox bbox, Config config)
+{
+    int ss_i = 1024 / config.ss_w;
+    uint64_t nx = (bbox.upper_right.x - bbox.lower_left.x) / ss_i + 1;
+    uint64_t ny = (bbox.upper_right.y - bbox.lower_left.y) / ss_i + 1;
+    return nx * ny;
+}
+
+static Config msaa_config(int ss_w_lg2)
+{
+    Config config;
+    config.r_shift = 10;
+    config.ss_w_lg2 = ss_w_lg2;
+    config.ss_w = 1 << ss_w_lg2;
+    config.ss = config.ss_w * config.ss_w;
+    config.ss_i = 1024 / config.ss_w;
+    return config;
+}
+
+/*
+ *  Same walk as rasterize_triangle, but counts fragments per
+ *  sample instead of depth testing them.
+ */
+static uint64_t count_hits(Triangle triangle, BoundingBox bbox, Config config,
+                           int w, vector<ushort>& depth)
+{
+    uint64_t hits = 0;
+    TriangleSetup setup = triangle_setup(triangle);
+
+    Sample sample;
+    for (sample.x = bbox.lower_left.x; sample.x <= bbox.upper_right.x; sample.x += config.ss_i)
+    {
+        for (sample.y = bbox.lower_left.y; sample.y <= bbox.upper_right.y; sample.y += config.ss_i)
+        {
+            Sample jitter = jitter_sample(sample, config.ss_w_lg2);
+
+            Sample jittered_sample;
+            jittered_sample.x = sample.x + (jitter.x << 2);
+            jittered_sample.y = sample.y + (jitter.y << 2);
+
+            if( sample_test_setup(&setup, jittered_sample) ){
+                hits++;
+
+                size_t sx = sample.x / (int)config.ss_i;
+                size_t sy = sample.y / (int)config.ss_i;
+                size_t id = sy * (size_t)w * config.ss_w + sx;
+                if( id < depth.size() && depth[id] < 0xffff )
+                    depth[id]++;
+            }
+        }
+    }
+
+    return hits;
+}
+
+/*
+ *  Cost per sample test and per depth-buffer write on this machine,
+ *  measured on a fixed triangle with and without a z-buffer.
+ */
+static void calibrate(double& ns_test, double& ns_hit)
+{
+    Config config = msaa_config(2);
+    Screen screen;
+    screen.width = 256 << 10;
+    screen.height = 256 << 10;
+
+    Triangle triangle;
+    triangle.v[0].x = 8 << 10;   triangle.v[0].y = 8 << 10;
+    triangle.v[1].x = 8 << 10;   triangle.v[1].y = 248 << 10;
+    triangle.v[2].x = 248 << 10; triangle.v[2].y = 8 << 10;
+    for( int k = 0 ; k < 3 ; k++ ){
+        triangle.v[k].z = 0x800;
+        triangle.v[k].R = triangle.v[k].G = triangle.v[k].B = 0xffff;
+    }
+
+    BoundingBox bbox = get_bounding_box(triangle, screen, config);
+    if( !bbox.valid ){ // orientation differs per implementation
+        ColorVertex3D t = triangle.v[1];
+        triangle.v[1] = triangle.v[2];
+        triangle.v[2] = t;
+        bbox = get_bounding_box(triangle, screen, config);
+    }
+    double tests = (double)bbox_samples(bbox, config);
+
+    ZBuff *zbuff = zbuff_init(screen, config);
+
+    auto t0 = std::chrono::steady_clock::now();
+    int hits = rasterize_triangle(triangle, NULL, screen, config);
+    auto t1 = std::chrono::steady_clock::now();
+    rasterize_triangle(triangle, zbuff, screen, config);
+    auto t2 = std::chrono::steady_clock::now();
+
+    double no_z = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    double with_z = std::chrono::duration<double, std::nano>(t2 - t1).count();
+
+    ns_test = no_z / tests;
+    ns_hit = hits > 0 && with_z > no_z ? (with_z - no_z) / hits : 0.0;
+
+    free(zbuff->frame_buffer);
+    free(zbuff->depth_buffer);
+    free(zbuff);
+}
+
+static void print_hist(const char *title, const uint64_t *hist, int bins, bool log2)
+{
+    uint64_t total = 0, peak = 0;
+    for( int i = 0 ; i < bins ; i++ ){
+        total += hist[i];
+        peak = hist[i] > peak ? hist[i] : peak;
+    }
+
+    printf("%s\n", title);
+    for( int i = 0 ; i < bins ; i++ ){
+        if( hist[i] == 0 )
+            continue;
+
+        char label[32];
+        if( log2 )
+            snprintf(label, sizeof(label), "%s%llu", i == bins - 1 ? ">=" : "",
+                     (unsigned long long)1 << i);
+        else
+            snprintf(label, sizeof(label), "%s%d", i == bins - 1 ? ">=" : "", i);
+
+        int bar = (int)(40 * hist[i] / peak);
+        printf("  %10s %12llu %6.2f%% %.*s\n", label, (unsigned long long)hist[i],
+               100.0 * hist[i] / total, bar, "########################################");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        abort_("Usage: rast_analyze <vector>");
+    }
+
+    vector<Triangle> triangles;
+    Screen screen;
+    Config config;
+
+    config.r_shift = 10;
+
+    if( is_mesh_file(argv[1]) ){
+        Mesh mesh;
+        load_mesh_file(argv[1], mesh, screen, config);
+        expand_mesh(mesh, triangles);
+    } else {
+        load_file(argv[1], triangles, screen, config);
+    }
+
+    int w = screen.width / 1024;
+    int h = screen.height / 1024;
+    vector<ushort> depth((size_t)w * h * config.ss);
+
+    Profile p;
+    memset(&p, 0, sizeof(p));
+    p.triangles = triangles.size();
+
+    for( size_t i = 0 ; i < triangles.size() ; i++ ){
+        Triangle& t = triangles[i];
+
+        // exclusive categories, straight from get_bounding_box
+        BoundingBox bbox;
+        switch( bounding_box_cull(t, screen, config, &bbox) ){
+        case BBOX_BACK_FACE:  p.back_culled++; break;
+        case BBOX_OFF_SCREEN: p.off_screen++;  break;
+        case BBOX_CLAMPED:    p.clamped++;     break;
+        case BBOX_INSIDE:                      break;
+        }
+
+        if( !bbox.valid )
+            continue;
+
+        p.valid++;
+
+        uint64_t tests = bbox_samples(bbox, config);
+        uint64_t hits = count_hits(t, bbox, config, w, depth);
+        p.tests += tests;
+        p.hits += hits;
+        p.bbox_hist[log2_bin(tests)]++;
+        p.largest_bbox = tests > p.largest_bbox ? tests : p.largest_bbox;
+        if( tests >= 64 && hits * 20 < tests )
+            p.slivers++;
+
+        for( int lg2 = 0 ; lg2 < 4 ; lg2++ ){
+            Config c = msaa_config(lg2);
+            BoundingBox b = get_bounding_box(t, screen, c);
+            if( b.valid )
+                p.tests_ss[lg2] += bbox_samples(b, c);
+        }
+    }
+
+    for( size_t i = 0 ; i < depth.size() ; i++ ){
+        int bin = depth[i] < OVERDRAW_BINS ? depth[i] : OVERDRAW_BINS - 1;
+        p.overdraw_hist[bin]++;
+    }
+
+    double ns_test, ns_hit;
+    calibrate(ns_test, ns_hit);
+    double predicted = (p.tests * ns_test + p.hits * ns_hit) * 1e-9;
+
+    printf("\nVector: %s\n", argv[1]);
+    printf("Screen: %dx%d  MSAA: %d\n", w, h, config.ss);
+    printf("Triangles:          %10zu\n", p.triangles);
+    printf("  back-face culled: %10zu  (%6.2f%%)\n", p.back_culled,
+           p.triangles ? 100.0 * p.back_culled / p.triangles : 0.0);
+    printf("  off screen:       %10zu  (%6.2f%%)\n", p.off_screen,
+           p.triangles ? 100.0 * p.off_screen / p.triangles : 0.0);
+    printf("  clamped to edge:  %10zu  (%6.2f%%)\n", p.clamped,
+           p.triangles ? 100.0 * p.clamped / p.triangles : 0.0);
+    printf("  rasterized:       %10zu\n", p.valid);
+    printf("  slivers:          %10zu  (bbox >= 64 samples, < 5%% hit)\n", p.slivers);
+    printf("Sample tests:       %10llu\n", (unsigned long long)p.tests);
+    printf("Sample hits:        %10llu  (%6.2f%% of tests)\n", (unsigned long long)p.hits,
+           p.tests ? 100.0 * p.hits / p.tests : 0.0);
+    printf("Largest bbox:       %10llu samples\n", (unsigned long long)p.largest_bbox);
+    printf("Sample tests per MSAA level:\n");
+    for( int lg2 = 0 ; lg2 < 4 ; lg2++ )
+        printf("  %2dx %14llu\n", 1 << (2 * lg2), (unsigned long long)p.tests_ss[lg2]);
+    printf("\n");
+    print_hist("Bounding box size (samples):", p.bbox_hist, HIST_BINS, true);
+    printf("\n");
+    print_hist("Overdraw (fragments per sample):", p.overdraw_hist, OVERDRAW_BINS, false);
+    printf("\n");
+    printf("Predicted gold raster time: %.3f s  (%.2f ns/test, %.2f ns/hit)\n",
+           predicted, ns_test, ns_hit);
+
+    return 0;
+}
@@ -0,0 +1,466 @@
+#include "helper.h"
+extern "C"{
+#include "rast_types.h"
+#include "rasterizer.h"
+}
+
+#include <stdint.h>
+#include <math.h>
+#include <random>
+
+/*
+
+   Rast Gen
+     Synthetic workload generator for the rasterizer.
+
+     Writes a JB21 (or JB21I) vector with a controlled
+     number of triangles, area distribution, overdraw,
+     back-face ratio and off-screen ratio. Triangles come
+     in strips sharing an edge with the one before, which
+     JB21I writes as shared vertices; both formats hold the
+     same triangles. The same seed and options always
+     produce the same file.
+
+     Triangles are oriented with get_bounding_box's own test
+     (bounding_box_cull), 32-bit wrapping products and all, so
+     the back-face and off-screen counts printed are the ones
+     the rasterizer culls, at any size. An area that can't fit
+     the screen is scaled down and counted as such.
+
+     Build:
+       gcc -O2 -c rasterizer.c zbuff.c
+       g++ -O2 -o rast_gen rastGen.cpp helper.cpp rasterizer.o zbuff.o
+
+     Usage:
+       rast_gen <file_out> [options]
+         -n <count>       triangles to generate            (1000)
+         -w <pixels>      screen width                     (640)
+         -h <pixels>      screen height                    (480)
+         -m <msaa>        1, 4, 16 or 64                   (4)
+         -a <min>:<max>   triangle area in pixels,
+                          log-uniform between min and max  (1:64)
+         -d <depth>       average overdraw over the covered
+                          region, 0 spreads over the screen (0)
+         -b <ratio>       fraction of back-facing triangles (0)
+         -o <ratio>       fraction of off-screen triangles  (0)
+         -t <length>      triangles per strip, 1 for
+                          independent triangles            (8)
+         -f <jb21|jb21i>  output format                    (jb21)
+         -s <seed>        random seed                      (1)
+*/
+
+// Shapes tried for an independent triangle before scaling it to the screen
+#define FIT_TRIES 16
+
+typedef struct {
+    int    count;
+    int    width;   // pixels
+    int    height;  // pixels
+    int    msaa;
+    double area_min; // pixels^2
+    double area_max; // pixels^2
+    double overdraw;
+    double backface;
+    double offscreen;
+    int    strip;
+    bool   indexed;
+    uint64_t seed;
+} GenConfig;
+
+typedef struct {
+    double x, y;  // pixels
+    int fixed[3]; // x, y, z as written
+    int color[3];
+} GenVertex;
+
+/*
+ *  Uniform double in [0,1) from the raw engine output. The engine
+ *  sequence is fixed by the standard, std::*_distribution is not,
+ *  so this keeps vectors identical across standard libraries.
+ */
+static double uniform(std::mt19937_64& rng)
+{
+    return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int uniform_int(std::mt19937_64& rng, int lo, int hi)
+{
+    return lo + (int)(uniform(rng) * (hi - lo + 1));
+}
+
+// Signed doubled area with the same orientation test as get_bounding_box
+static double cross(const double x[3], const double y[3])
+{
+    return (x[1] - x[0]) * (y[2] - y[1]) - (x[2] - x[1]) * (y[1] - y[0]);
+}
+
+static void usage()
+{
+    abort_("Usage: rast_gen <file_out> [-n count] [-w width] [-h height] [-m msaa] "
+           "[-a min:max] [-d overdraw] [-b backface] [-o offscreen] [-t strip] [-f jb21|jb21i] [-s seed]");
+}
+
+static void parse_args(int argc, char **argv, GenConfig &gen)
+{
+    gen.count = 1000;
+    gen.width = 640;
+    gen.height = 480;
+    gen.msaa = 4;
+    gen.area_min = 1.0;
+    gen.area_max = 64.0;
+    gen.overdraw = 0.0;
+    gen.backface = 0.0;
+    gen.offscreen = 0.0;
+    gen.strip = 8;
+    gen.indexed = false;
+    gen.seed = 1;
+
+    for( int i = 2 ; i < argc ; i++ ){
+        if( argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 >= argc )
+            usage();
+
+        char *val = argv[++i];
+        switch( argv[i-1][1] ){
+        case 'n': gen.count = atoi(val); break;
+        case 'w': gen.width = atoi(val); break;
+        case 'h': gen.height = atoi(val); break;
+        case 'm': gen.msaa = atoi(val); break;
+        case 'a':
+            if( sscanf(val, "%lf:%lf", &gen.area_min, &gen.area_max) != 2 )
+                usage();
+            break;
+        case 'd': gen.overdraw = atof(val); break;
+        case 'b': gen.backface = atof(val); break;
+        case 'o': gen.offscreen = atof(val); break;
+        case 't': gen.strip = atoi(val); break;
+        case 'f':
+            if( !strcmp(val, "jb21") )       gen.indexed = false;
+            else if( !strcmp(val, "jb21i") ) gen.indexed = true;
+            else usage();
+            break;
+        case 's': gen.seed = strtoull(val, NULL, 0); break;
+        default: usage();
+        }
+    }
+
+    if( gen.msaa != 1 && gen.msaa != 4 && gen.msaa != 16 && gen.msaa != 64 )
+        abort_("MSAA must be 1, 4, 16 or 64");
+    // 24 bit signed coordinates with 10 fractional bits
+    if( gen.width < 1 || gen.height < 1 || gen.width > 4095 || gen.height > 4095 )
+        abort_("Screen must be between 1 and 4095 pixels on each side");
+    if( gen.count < 0 || gen.area_min <= 0.0 || gen.area_max < gen.area_min )
+        abort_("Bad triangle count or area range");
+    if( gen.strip < 1 )
+        abort_("Strip length must be at least 1");
+}
+
+/*
+ *  Generate one triangle of the requested area around the origin.
+ *  Vertices sit on a circle at random angles, so shapes range
+ *  from near-equilateral to slivers.
+ */
+static void make_triangle(std::mt19937_64& rng, double area, bool back,
+                          double x[3], double y[3])
+{
+    double a[3];
+    double shape;
+    do {
+        for( int k = 0 ; k < 3 ; k++ )
+            a[k] = uniform(rng) * 2.0 * M_PI;
+        for( int k = 0 ; k < 3 ; k++ ){
+            x[k] = cos(a[k]);
+            y[k] = sin(a[k]);
+        }
+        shape = fabs(cross(x, y)) * 0.5;
+    } while( shape < 1e-3 );
+
+    double r = sqrt(area / shape);
+    for( int k = 0 ; k < 3 ; k++ ){
+        x[k] *= r;
+        y[k] *= r;
+    }
+
+    // front facing triangles have a non-positive cross product
+    if( (cross(x, y) > 0.0) != back ){
+        double t;
+        t = x[1]; x[1] = x[2]; x[2] = t;
+        t = y[1]; y[1] = y[2]; y[2] = t;
+    }
+}
+
+/*
+ *  Scale that makes the triangle fit span on one axis, 1 if it does.
+ *  place then moves it so its bounding box lands inside [lo,hi] on
+ *  that axis, as close to the wanted center as it fits.
+ */
+static double fit_scale(const double v[3], double span)
+{
+    double lo = fmin(v[0], fmin(v[1], v[2]));
+    double hi = fmax(v[0], fmax(v[1], v[2]));
+    return (hi - lo) > span ? span / (hi - lo) : 1.0;
+}
+
+static void place(double v[3], double center, double lo, double hi)
+{
+    double vmin = fmin(v[0], fmin(v[1], v[2]));
+    double vmax = fmax(v[0], fmax(v[1], v[2]));
+    double c = fmin(fmax(center, lo - vmin), hi - vmax);
+    for( int k = 0 ; k < 3 ; k++ )
+        v[k] += c;
+}
+
+/*
+ *  Append a vertex at (x,y) pixels with a random depth and color.
+ *  The position kept is the fixed point one written to the file, 24
+ *  bits two's complement: load_triangle_line reads a negative one as
+ *  a coordinate past the far edge, the RTL as one before the near
+ *  edge, and both cull the triangle.
+ */
+static int add_vertex(std::mt19937_64& rng, vector<GenVertex>& vertices, double x, double y)
+{
+    GenVertex v;
+    v.fixed[0] = (int)(x * 1024.0) & 0xffffff;
+    v.fixed[1] = (int)(y * 1024.0) & 0xffffff;
+    v.fixed[2] = uniform_int(rng, 0, 0x7fffff); // keep the 24 bit depth positive
+    v.x = (int)(x * 1024.0) / 1024.0;
+    v.y = (int)(y * 1024.0) / 1024.0;
+    for( int c = 0 ; c < 3 ; c++ )
+        v.color[c] = uniform_int(rng, 0, 0xffff);
+    vertices.push_back(v);
+    return (int)vertices.size() - 1;
+}
+
+/*
+ *  What get_bounding_box does with the fixed point triangle t
+ */
+static BBoxCull cull(const vector<GenVertex>& vertices, const int t[3],
+                     Screen screen, Config config)
+{
+    Triangle triangle;
+    for( int k = 0 ; k < 3 ; k++ ){
+        triangle.v[k].x = vertices[t[k]].fixed[0];
+        triangle.v[k].y = vertices[t[k]].fixed[1];
+        triangle.v[k].z = vertices[t[k]].fixed[2];
+    }
+    BoundingBox bbox;
+    return bounding_box_cull(triangle, screen, config, &bbox);
+}
+
+/*
+ *  Order the vertices of t so get_bounding_box culls it as back
+ *  facing exactly when back is set. Past about 44 pixels its edge
+ *  products wrap and one order may not be enough, so all six are
+ *  tried; if none works t is left as it was.
+ */
+static void orient(const vector<GenVertex>& vertices, int t[3], bool back,
+                   Screen screen, Config config)
+{
+    static const int order[6][3] = { {0, 1, 2}, {0, 2, 1}, {1, 2, 0},
+                                     {1, 0, 2}, {2, 0, 1}, {2, 1, 0} };
+    for( int p = 0 ; p < 6 ; p++ ){
+        int u[3] = { t[order[p][0]], t[order[p][1]], t[order[p][2]] };
+        if( (cull(vertices, u, screen, config) == BBOX_BACK_FACE) == back ){
+            t[0] = u[0];
+            t[1] = u[1];
+            t[2] = u[2];
+            return;
+        }
+    }
+}
+
+/*
+ *  Next triangle of a strip: across the edge a-b of the last one,
+ *  away from its third vertex c, at the height that gives the wanted
+ *  area. The height is halved until the new vertex is on the screen;
+ *  false if it never is and the strip has to restart.
+ */
+static bool extend_strip(std::mt19937_64& rng, double area,
+                         const GenVertex& a, const GenVertex& b, const GenVertex& c,
+                         double max_x, double max_y, double& dx, double& dy)
+{
+    double ex = b.x - a.x;
+    double ey = b.y - a.y;
+    double len = sqrt(ex * ex + ey * ey);
+    if( len < 1.0 / 256.0 )
+        return false;
+
+    double nx = -ey / len;
+    double ny = ex / len;
+    if( (c.x - a.x) * nx + (c.y - a.y) * ny > 0.0 ){
+        nx = -nx;
+        ny = -ny;
+    }
+
+    double along = uniform(rng);
+    double h = 2.0 * area / len;
+    for( int k = 0 ; k < 8 ; k++, h *= 0.5 ){
+        dx = a.x + along * ex + h * nx;
+        dy = a.y + along * ey + h * ny;
+        if( dx >= 0.0 && dy >= 0.0 && dx <= max_x && dy <= max_y )
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    if( argc < 2 )
+        usage();
+
+    GenConfig gen;
+    parse_args(argc, argv, gen);
+
+    std::mt19937_64 rng(gen.seed);
+
+    /* Size the region triangle centers land in so the expected
+       coverage over it matches the requested overdraw */
+    double log_span = log(gen.area_max / gen.area_min);
+    double mean_area = log_span > 0.0 ?
+        (gen.area_max - gen.area_min) / log_span : gen.area_min;
+    double region_w = gen.width;
+    double region_h = gen.height;
+    if( gen.overdraw > 0.0 ){
+        double scale = sqrt(gen.count * mean_area / gen.overdraw / (region_w * region_h));
+        if( scale < 1.0 ){
+            region_w *= scale;
+            region_h *= scale;
+        }
+    }
+    double region_x = (gen.width - region_w) * 0.5;
+    double region_y = (gen.height - region_h) * 0.5;
+
+    // On-screen triangles stay inside [0, width-1] x [0, height-1],
+    // off-screen triangles go past one of the four edges
+    double max_x = gen.width - 1;
+    double max_y = gen.height - 1;
+    double lim = (1 << 13) - 1; // largest 24 bit coordinate magnitude in pixels
+
+    Screen screen;
+    screen.width = gen.width << 10;
+    screen.height = gen.height << 10;
+    Config config;
+    config.r_shift = 10;
+    config.ss = gen.msaa;
+    config.ss_w = (int)sqrt((double)gen.msaa);
+    config.ss_w_lg2 = 0;
+    while( (1 << config.ss_w_lg2) < config.ss_w )
+        config.ss_w_lg2++;
+    config.ss_i = 1024 / config.ss_w;
+
+    FILE *stream = fopen(argv[1], "w");
+    if( stream == NULL )
+        abort_("Failed to Open Vector File for Write");
+
+    fprintf(stream, gen.indexed ? "JB21I\n" : "JB21\n");
+    fprintf(stream, "%06x %06x %d\n", gen.width << 10, gen.height << 10, gen.msaa);
+
+    vector<GenVertex> vertices;
+    vector<int> index; // 3 per triangle
+    int backfaced = 0, offscreened = 0, scaled = 0;
+    int strip = 0;     // triangles in the current strip
+
+    for( int i = 0 ; i < gen.count ; i++ ){
+        double area = gen.area_min * exp(uniform(rng) * log_span);
+        bool back = uniform(rng) < gen.backface;
+        bool off = uniform(rng) < gen.offscreen;
+
+        size_t n = index.size();
+        double dx, dy;
+        if( !off && strip > 0 && strip < gen.strip &&
+            extend_strip(rng, area, vertices[index[n-2]], vertices[index[n-1]],
+                         vertices[index[n-3]], max_x, max_y, dx, dy) ){
+            int a = index[n-2];
+            int b = index[n-1];
+            index.push_back(a);
+            index.push_back(b);
+            index.push_back(add_vertex(rng, vertices, dx, dy));
+            strip++;
+        } else {
+            // a few shapes for one that fits the screen at this area
+            double x[3], y[3];
+            double scale = 0.0;
+            for( int k = 0 ; k < FIT_TRIES && scale < 1.0 ; k++ ){
+                make_triangle(rng, area, back, x, y);
+                scale = fmin(fit_scale(x, max_x), fit_scale(y, max_y));
+            }
+            if( scale < 1.0 ){
+                for( int k = 0 ; k < 3 ; k++ ){
+                    x[k] *= scale;
+                    y[k] *= scale;
+                }
+                scaled++;
+            }
+
+            if( off ){
+                // entirely past one edge, rejected by the bbox
+                int edge = uniform_int(rng, 0, 3);
+                if( edge < 2 ){
+                    if( edge == 0 )
+                        place(x, gen.width + uniform(rng) * (lim - gen.width), gen.width + 1, lim);
+                    else
+                        place(x, -1.0 - uniform(rng) * (lim - 1.0), -lim, -1.0);
+                    place(y, uniform(rng) * max_y, 0.0, max_y);
+                } else {
+                    place(x, uniform(rng) * max_x, 0.0, max_x);
+                    if( edge == 2 )
+                        place(y, gen.height + uniform(rng) * (lim - gen.height), gen.height + 1, lim);
+                    else
+                        place(y, -1.0 - uniform(rng) * (lim - 1.0), -lim, -1.0);
+                }
+            } else {
+                place(x, region_x + uniform(rng) * region_w, 0.0, max_x);
+                place(y, region_y + uniform(rng) * region_h, 0.0, max_y);
+            }
+
+            for( int k = 0 ; k < 3 ; k++ )
+                index.push_back(add_vertex(rng, vertices, x[k], y[k]));
+            strip = off ? 0 : 1;
+        }
+
+        // orient the fixed point triangle, reordering it if rounding,
+        // a strip step or wrapping products left it facing the wrong way
+        int *t = &index[n];
+        orient(vertices, t, back, screen, config);
+
+        // counted as get_bounding_box sees them, as rast_analyze does
+        switch( cull(vertices, t, screen, config) ){
+        case BBOX_BACK_FACE:  backfaced++;   break;
+        case BBOX_OFF_SCREEN: offscreened++; break;
+        default: break;
+        }
+    }
+
+    if( gen.indexed ){
+        fprintf(stream, "%d %d\n", (int)vertices.size(), gen.count);
+        for( size_t v = 0 ; v < vertices.size() ; v++ ){
+            const GenVertex& gv = vertices[v];
+            fprintf(stream, "%06x %06x %06x %06x %06x %06x\n", gv.fixed[0], gv.fixed[1], gv.fixed[2],
+                    gv.color[0], gv.color[1], gv.color[2]);
+        }
+        for( int i = 0 ; i < gen.count ; i++ )
+            fprintf(stream, "1 %d %d %d\n", index[i*3], index[i*3 + 1], index[i*3 + 2]);
+    } else {
+        for( int i = 0 ; i < gen.count ; i++ ){
+            fprintf(stream, "1 3");
+            for( int k = 0 ; k < 3 ; k++ ){
+                const GenVertex& gv = vertices[index[i*3 + k]];
+                fprintf(stream, " %06x %06x %06x", gv.fixed[0], gv.fixed[1], gv.fixed[2]);
+            }
+            fprintf(stream, " 000000 000000 000000"); // unused 4th vertex
+            // JB21I colors a triangle with its first vertex
+            for( int c = 0 ; c < 3 ; c++ )
+                fprintf(stream, " %06x", vertices[index[i*3]].color[c]);
+            fprintf(stream, "\n");
+        }
+    }
+
+    fclose(stream);
+
+    printf("Wrote %d triangles to %s (seed %llu): %d back-facing, %d off-screen\n",
+           gen.count, argv[1], (unsigned long long)gen.seed, backfaced, offscreened);
+    if( scaled )
+        printf("Warning: %d triangles scaled down to fit the screen, "
+               "below the requested area\n", scaled);
+
+    return 0;
+}
@@ -0,0 +1,413 @@
+#include "helper.h"
+extern "C"{
+#include "rasterizer.h"
+#include "rast_types.h"
+}
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+
+/*
+
+   Rast Perf
+     Cycle-approximate model of the rast pipeline as driven by
+     verif/testbench.sv. Predicts the counts the testbench prints
+     from perf_monitor at the end of a simulation
+
+       Cycles: triangle: sampleTests: sampleHits:
+
+     without running the RTL, and sweeps pipeline parameters over
+     a set of vectors to report triangles per cycle.
+
+     What is modelled:
+       - bbox: PIPES_BOX stages from R10 to R13, all enabled by
+         halt_RnnnnL, so the whole front end and rast_driver stall
+         together (one line enters per unhalted cycle)
+       - test_iterator: one WAIT cycle per triangle at R13, then,
+         for a valid bounding box, one TEST cycle per column of
+         every group of <lanes> rows (lanes A, B, C step up by
+         three rows), with halt_RnnnnL low meanwhile. -w 0 models
+         the modified FSM (MOD_FSM) without the WAIT cycle
+       - hash and sample test: PIPES_HASH + PIPES_SAMP free running
+         stages; they only delay what perf_monitor sees
+       - the driver's reset, start and drain sequence and the
+         window in which perf_monitor counts
+
+     test_iterator registers once whatever PIPE_DEPTH it is given,
+     so PIPES_ITER is accepted but does not change the timing. Like
+     perf_monitor, sampleTests counts two samples per valid cycle
+     and sampleHits the hits of lanes A and B only. With a deep
+     bbox pipe the driver's drain handshake can end the test
+     before the last boxes are iterated; their samples are not
+     counted, as in simulation. The bounding boxes and hits are
+     the gold model's; the counts are expected within a few
+     cycles of the simulation (the testbench's own end-of-test
+     handshakes race by a cycle).
+
+     Build:
+       gcc -O2 -c rasterizer.c zbuff.c
+       g++ -O2 -o rast_perf rastPerf.cpp helper.cpp rasterizer.o zbuff.o
+
+     Usage:
+       rast_perf [-b box] [-i iter] [-h hash] [-s samp] [-l lanes] [-w wait] [-q] <vector>...
+
+       Every option takes a comma separated list, and every
+       combination is modelled, e.g. -b 3,14 -l 1,2,3 runs six
+       configurations. Defaults are rast_params.sv: -b 14 -i 2 -h 3
+       -s 4, with -l 3 -w 1. -q skips the sample tests, so
+       sampleHits is not reported.
+*/
+
+#define PERF_MAX_LANES 8
+#define PERF_START_EDGE 2   // rast_driver starts checking halt 2 cycles after reset
+#define PERF_COUNT_EDGE 4   // perf_monitor counts from the 4th cycle after reset
+#define PERF_DRAIN_CHECKS 4 // rast_driver waits for halt_RnnnnL high 4 times
+#define PERF_DRIVER_TAIL 10 // then lets the pipe clean
+#define PERF_BENCH_TAIL 15  // and the testbench waits before printing
+
+// Front end tokens other than a line index
+#define TOKEN_RESET -2      // registers out of reset
+#define TOKEN_JUNK  -1      // InitLines' random triangle
+#define TOKEN_HOLD  -3      // last line held with valid low
+
+typedef struct {
+    int box;
+    int iter;
+    int hash;
+    int samp;
+    int lanes;
+    int wait;   // WAIT cycle per triangle (baseline FSM)
+} PerfParams;
+
+typedef struct {
+    uint32_t cols;      // bounding box samples per row
+    uint32_t rows;
+    bool     valid;     // valid line with a valid bounding box
+    bool     changed;   // vertices differ from the previous line
+} PerfLine;
+
+typedef struct {
+    string name;
+    vector<PerfLine> lines;
+    vector<int> lanes;      // lane counts the hits are binned for
+    vector<uint32_t> hits;  // lane A and B hits, [line][lane count]
+} PerfVector;
+
+typedef struct {
+    uint64_t cycles;
+    uint64_t triangles;
+    uint64_t tests;
+    uint64_t hits;
+} PerfCounts;
+
+static void parse_list(const char* arg, vector<int>& values)
+{
+    values.clear();
+    const char* p = arg;
+    while( *p ){
+        char* end;
+        long v = strtol(p, &end, 10);
+        if( end == p )
+            abort_("Bad parameter list %s", arg);
+        values.push_back((int)v);
+        p = *end == ',' ? end + 1 : end;
+    }
+}
+
+/*
+ *  Bounding boxes, and the gold model's hits for every lane count
+ *  asked for, of every line in a JB21 vector.
+ */
+static void load_vector(const char* file_name, const vector<int>& lanes, bool count_hits,
+                        PerfVector& vec)
+{
+    ifstream myfile(file_name);
+    if( !myfile.is_open() )
+        abort_("Failed to Open Vector File for Read");
+
+    Screen screen;
+    Config config;
+    load_header(myfile, screen, config);
+    config.r_shift = 10;
+    int ss_i = 1024 / config.ss_w;
+
+    vec.name = file_name;
+    vec.lanes = lanes;
+
+    TriangleLine line, prev;
+    memset(&prev, 0, sizeof(prev));
+    while( load_triangle_line(myfile, line) ){
+        if( line.vertices != 3 )
+            abort_("Input contains triangle pairs, should only contain singles");
+
+        Triangle triangle;
+        for( int v = 0 ; v < 3 ; v++ ){
+            triangle.v[v].x = line.v[v][0];
+            triangle.v[v].y = line.v[v][1];
+            triangle.v[v].z = line.v[v][2];
+        }
+
+        PerfLine p;
+        p.changed = vec.lines.empty() || memcmp(line.v, prev.v, sizeof(int) * 9);
+        p.valid = false;
+        p.cols = p.rows = 0;
+        prev = line;
+
+        BoundingBox bbox = get_bounding_box(triangle, screen, config);
+        if( line.valid && bbox.valid ){
+            p.valid = true;
+            p.cols = (bbox.upper_right.x - bbox.lower_left.x) / ss_i + 1;
+            p.rows = (bbox.upper_right.y - bbox.lower_left.y) / ss_i + 1;
+        }
+        vec.lines.push_back(p);
+        vec.hits.resize(vec.hits.size() + lanes.size(), 0);
+
+        if( !p.valid || !count_hits )
+            continue;
+
+        // Same walk as rasterize_triangle, hits binned by the lane of their row
+        TriangleSetup setup = triangle_setup(triangle);
+        Sample sample;
+        for( sample.y = bbox.lower_left.y ; sample.y <= bbox.upper_right.y ; sample.y += ss_i ){
+            uint32_t row = (sample.y - bbox.lower_left.y) / ss_i;
+            uint64_t row_hits = 0;
+            for( sample.x = bbox.lower_left.x ; sample.x <= bbox.upper_right.x ; sample.x += ss_i ){
+                Sample jitter = jitter_sample(sample, config.ss_w_lg2);
+                Sample jittered;
+                jittered.x = sample.x + (jitter.x << 2);
+                jittered.y = sample.y + (jitter.y << 2);
+                row_hits += sample_test_setup(&setup, jittered);
+            }
+            uint32_t* hits = &vec.hits[vec.hits.size() - lanes.size()];
+            for( size_t k = 0 ; k < lanes.size() ; k++ ){
+                if( row % lanes[k] < 2 )
+                    hits[k] += row_hits;
+            }
+        }
+    }
+
+    myfile.close();
+}
+
+static uint64_t iterator_cycles(const PerfLine& p, int lanes)
+{
+    return (uint64_t)p.cols * ((p.rows + lanes - 1) / lanes);
+}
+
+/*
+ *  Run one vector through the model, one clock edge at a time
+ *  except inside a bounding box, which is skipped over in one step.
+ *  Edge 0 is the one at which the testbench releases reset.
+ */
+static PerfCounts simulate(const PerfVector& vec, const PerfParams& prm)
+{
+    PerfCounts counts;
+    memset(&counts, 0, sizeof(counts));
+
+    deque<long> front(prm.box - 1, TOKEN_RESET); // registers before R13
+    long r13 = TOKEN_RESET;
+    long r14 = TOKEN_RESET;
+    vector<int64_t> changes;                 // edges at which tri_R14S changed
+    vector<pair<int64_t, long> > accepted;   // edge a box started at, its line
+
+    bool halt = false;      // halt_RnnnnL, out of reset
+    bool testing = false;
+    uint64_t remaining = 0;
+
+    size_t next_line = 0;
+    int64_t check = PERF_START_EDGE; // next edge after which the driver looks at halt
+    int drains = -1;                 // halt checks left once the lines are out
+    int64_t end = -1;
+
+    for( int64_t c = 1 ; end < 0 ; c++ ){
+        bool enable = halt;  // registers load with the halt of the previous cycle
+        bool next_halt = halt;
+        bool wait = !testing;
+
+        if( testing && --remaining == 0 ){
+            testing = false;
+            next_halt = true;
+            wait = !prm.wait;  // the modified FSM takes the next box right away
+            enable = enable || !prm.wait;
+        }
+
+        if( wait ){
+            bool changed = r13 != r14 && r13 != TOKEN_HOLD &&
+                           !(r13 >= 0 && r14 >= 0 && !vec.lines[r13].changed);
+            if( changed )
+                changes.push_back(c);
+            if( r13 != TOKEN_HOLD )
+                r14 = r13;
+
+            if( r13 >= 0 && vec.lines[r13].valid ){
+                remaining = iterator_cycles(vec.lines[r13], prm.lanes);
+                accepted.push_back(make_pair(c, r13));
+                testing = true;
+                next_halt = false;
+            } else {
+                next_halt = true;
+            }
+        }
+
+        if( enable ){
+            long token = TOKEN_JUNK;
+            if( c > PERF_START_EDGE ){
+                if( next_line < vec.lines.size() ){
+                    token = (long)next_line++;
+                    if( next_line == vec.lines.size() )
+                        check = c;
+                } else {
+                    token = TOKEN_HOLD;
+                }
+            }
+            front.push_back(token);
+            r13 = front.front();
+            front.pop_front();
+        }
+
+        halt = next_halt;
+
+        // rast_driver's drain: wait for halt high, two cycles, four times
+        if( next_line == vec.lines.size() && c == check ){
+            if( drains < 0 )
+                drains = PERF_DRAIN_CHECKS;
+            if( halt ){
+                check = c + 2;
+                if( --drains == 0 )
+                    end = c + 2 + PERF_DRIVER_TAIL + PERF_BENCH_TAIL;
+            } else {
+                check = c + 1;
+            }
+        }
+
+        // Nothing moves until the box is done but the driver waiting
+        if( testing && remaining > 1 && (drains < 0 || check > c + (int64_t)remaining) ){
+            c += remaining - 1;
+            remaining = 1;
+        }
+    }
+
+    counts.cycles = end - PERF_COUNT_EDGE + 1;
+
+    // perf_monitor sees tri_R14S after the hash stages and its own pipe
+    int64_t delay = prm.hash + prm.samp;
+    for( size_t k = 0 ; k < changes.size() ; k++ ){
+        int64_t seen = changes[k] + delay;
+        if( seen >= PERF_COUNT_EDGE && seen <= end )
+            counts.triangles++;
+    }
+
+    /*
+     *  Its samples, as far as the simulation runs: the sample tests
+     *  are clipped to the window, the hits counted for every box that
+     *  reaches it.
+     */
+    size_t lane = find(vec.lanes.begin(), vec.lanes.end(), prm.lanes) - vec.lanes.begin();
+    for( size_t k = 0 ; k < accepted.size() ; k++ ){
+        long line = accepted[k].second;
+        int64_t first = accepted[k].first + delay + 1;
+        int64_t last = accepted[k].first + delay + iterator_cycles(vec.lines[line], prm.lanes);
+        first = first > PERF_COUNT_EDGE ? first : PERF_COUNT_EDGE;
+        last = last < end ? last : end;
+        if( first > last )
+            continue;
+        counts.tests += 2 * (last - first + 1);
+        counts.hits += vec.hits[line * vec.lanes.size() + lane];
+    }
+    return counts;
+}
+
+int main(int argc, char **argv)
+{
+    vector<int> box(1, 14), iter(1, 2), hash(1, 3), samp(1, 4), lanes(1, 3), wait(1, 1);
+    vector<const char*> files;
+    bool count_hits = true;
+
+    for( int i = 1 ; i < argc ; i++ ){
+        if( !strcmp(argv[i], "-q") )
+            count_hits = false;
+        else if( argv[i][0] == '-' && argv[i][1] && !argv[i][2] && i + 1 < argc ){
+            switch( argv[i][1] ){
+            case 'b': parse_list(argv[++i], box); break;
+            case 'i': parse_list(argv[++i], iter); break;
+            case 'h': parse_list(argv[++i], hash); break;
+            case 's': parse_list(argv[++i], samp); break;
+            case 'l': parse_list(argv[++i], lanes); break;
+            case 'w': parse_list(argv[++i], wait); break;
+            default: abort_("Unknown option %s", argv[i]);
+            }
+        }
+        else
+            files.push_back(argv[i]);
+    }
+    if( files.empty() )
+    {
+        abort_("Usage: rast_perf [-b box] [-i iter] [-h hash] [-s samp] [-l lanes] [-w wait] [-q] <vector>...");
+    }
+    for( size_t k = 0 ; k < box.size() ; k++ )
+        if( box[k] < 1 )
+            abort_("PIPES_BOX must be at least 1");
+    for( size_t k = 0 ; k < lanes.size() ; k++ )
+        if( lanes[k] < 1 || lanes[k] > PERF_MAX_LANES )
+            abort_("Lanes must be 1 to %d", PERF_MAX_LANES);
+
+    auto start = std::chrono::steady_clock::now();
+
+    vector<PerfVector> vecs(files.size());
+    for( size_t f = 0 ; f < files.size() ; f++ )
+        load_vector(files[f], lanes, count_hits, vecs[f]);
+
+    auto loaded = std::chrono::steady_clock::now();
+
+    printf("\n%4s %4s %4s %4s %5s %4s  %-24s %12s %10s %14s %12s %10s\n",
+           "box", "iter", "hash", "samp", "lanes", "wait", "vector",
+           "cycles", "triangles", "sampleTests", "sampleHits", "tri/cycle");
+
+    size_t configs = 0;
+    for( size_t b = 0 ; b < box.size() ; b++ )
+    for( size_t it = 0 ; it < iter.size() ; it++ )
+    for( size_t h = 0 ; h < hash.size() ; h++ )
+    for( size_t s = 0 ; s < samp.size() ; s++ )
+    for( size_t l = 0 ; l < lanes.size() ; l++ )
+    for( size_t w = 0 ; w < wait.size() ; w++ ){
+        PerfParams prm = { box[b], iter[it], hash[h], samp[s], lanes[l], wait[w] != 0 };
+        PerfCounts total;
+        memset(&total, 0, sizeof(total));
+
+        for( size_t f = 0 ; f < vecs.size() ; f++ ){
+            PerfCounts c = simulate(vecs[f], prm);
+            total.cycles += c.cycles;
+            total.triangles += c.triangles;
+            total.tests += c.tests;
+            total.hits += c.hits;
+
+            string name = vecs[f].name;
+            size_t slash = name.rfind('/');
+            if( slash != string::npos )
+                name = name.substr(slash + 1);
+            printf("%4d %4d %4d %4d %5d %4d  %-24s %12llu %10llu %14llu %12s %10.6f\n",
+                   prm.box, prm.iter, prm.hash, prm.samp, prm.lanes, prm.wait, name.c_str(),
+                   (unsigned long long)c.cycles, (unsigned long long)c.triangles,
+                   (unsigned long long)c.tests,
+                   count_hits ? to_string(c.hits).c_str() : "-",
+                   (double)c.triangles / c.cycles);
+        }
+        if( vecs.size() > 1 ){
+            printf("%4d %4d %4d %4d %5d %4d  %-24s %12llu %10llu %14llu %12s %10.6f\n",
+                   prm.box, prm.iter, prm.hash, prm.samp, prm.lanes, prm.wait, "(all)",
+                   (unsigned long long)total.cycles, (unsigned long long)total.triangles,
+                   (unsigned long long)total.tests,
+                   count_hits ? to_string(total.hits).c_str() : "-",
+                   (double)total.triangles / total.cycles);
+        }
+        configs++;
+    }
+
+    double load_s = std::chrono::duration<double>(loaded - start).count();
+    double model_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - loaded).count();
+    printf("\n%zu configurations over %zu vectors: %.2f s loading, %.2f s modelling\n",
+           configs, vecs.size(), load_s, model_s);
+    return 0;
+}
@@ -1,12 +1,19 @@
 
 
 #include "helper.h"
+#include "mesh.h"
+#include "pipeline.h"
+#include "batch.h"
+#include "fixed.h"
 // #include "rasterizer_wrapper.h"
 // #include "rasterizer_core.h"
 extern "C"{
 #include "rasterizer.h"
 #include "rast_types.h"
 #include "zbuff.h"
+#include "gold_ahead.h"
+#include "rast_fixed.h"
+#include "lane_iter.h"
 }
 
 #include <stdlib.h>
@@ -107,6 +114,171 @@ bool testRast()
 
   printf( "\t\tPass Test 3\n");
 
+
+  printf( "Test 4: Edge Setup Test\n" );
+
+  // The setup path and the shared (negated) edge of a
+  // neighboring triangle must agree with sample_test
+  TriangleSetup setup = triangle_setup(triangle);
+
+  Triangle neighbor; // shares edge v0-v1, walked the other way
+  neighbor.v[0] = triangle.v[1];
+  neighbor.v[1] = triangle.v[0];
+  neighbor.v[2].x = 552 << ( config.r_shift - 2 );
+  neighbor.v[2].y = 668 << ( config.r_shift - 2 );
+
+  TriangleSetup shared = triangle_setup(neighbor);
+  shared.e[0] = edge_negate(setup.e[0]);
+
+  for( sample.x = 550 << ( config.r_shift - 2 ) ; sample.x <= 564 << ( config.r_shift - 2 ) ; sample.x += 64 ){
+    for( sample.y = 658 << ( config.r_shift - 2 ) ; sample.y <= 681 << ( config.r_shift - 2 ) ; sample.y += 64 ){
+      if( sample_test_setup( &setup, sample ) != sample_test( triangle, sample ) ){
+        abort_("Failed Test 4");
+      }
+      if( sample_test_setup( &shared, sample ) != sample_test( neighbor, sample ) ){
+        abort_("Failed Test 4");
+      }
+    }
+  }
+
+  // Triangles whose products in sample_test wrap: around the largest
+  // one the edges still handle (44 pixels) and well past it
+  int spans[4] = { 40, 44, 46, 900 };
+  for( int k = 0 ; k < 4 ; k++ ){
+    int span = spans[k] << config.r_shift;
+    int o = 30 << config.r_shift;
+    Triangle big;
+    big.v[0].x = o;            big.v[0].y = o + span;
+    big.v[1].x = o + span;     big.v[1].y = o + span / 3;
+    big.v[2].x = o + span / 5; big.v[2].y = o;
+    Triangle big_neighbor;
+    big_neighbor.v[0] = big.v[1];
+    big_neighbor.v[1] = big.v[0];
+    big_neighbor.v[2].x = 20 << config.r_shift;
+    big_neighbor.v[2].y = 20 << config.r_shift;
+
+    TriangleSetup big_setup = triangle_setup( big );
+    TriangleSetup big_shared = triangle_setup( big_neighbor );
+    big_shared.e[0] = edge_negate( big_setup.e[0] );
+
+    BoundingBox box = get_bounding_box( big, screen, config );
+    int step = span / 97 + 1;
+    for( sample.x = box.lower_left.x - 1024 ; sample.x <= box.upper_right.x + 1024 ; sample.x += step ){
+      for( sample.y = box.lower_left.y - 1024 ; sample.y <= box.upper_right.y + 1024 ; sample.y += step ){
+        if( sample_test_setup( &big_setup, sample ) != sample_test( big, sample ) ||
+            sample_test_setup( &big_shared, sample ) != sample_test( big_neighbor, sample ) ){
+          abort_("Failed Test 4");
+        }
+      }
+    }
+  }
+
+  printf( "\t\tPass Test 4\n");
+
+
+  printf( "Test 5: RTL Width Sample Test\n" );
+
+  // Fields wrap and widen like the RTL signals
+  typedef Fixed<RAST_SIGFIG, RAST_RADIX> Coord;
+  if( Coord::from_raw( 0x800000 ).raw() != -0x800000 ){
+    abort_("Failed Test 5");
+  }
+  if( ( Coord::from_raw( 0x7fffff ) + Coord::from_raw( 1 ) ).raw() != 0x800000 ||
+      ( Coord::from_raw( 0x7fffff ) + Coord::from_raw( 1 ) ).wrap<RAST_SIGFIG>().raw() != -0x800000 ||
+      ( Coord::from_raw( 0x7fffff ) + Coord::from_raw( 1 ) ).saturate<RAST_SIGFIG>().raw() != 0x7fffff ){
+    abort_("Failed Test 5");
+  }
+
+  // Where the int math can't overflow it's the same test
+  for( sample.x = 550 << ( config.r_shift - 2 ) ; sample.x <= 564 << ( config.r_shift - 2 ) ; sample.x += 64 ){
+    for( sample.y = 658 << ( config.r_shift - 2 ) ; sample.y <= 681 << ( config.r_shift - 2 ) ; sample.y += 64 ){
+      if( sample_test_rtl( triangle, sample ) != sample_test( triangle, sample ) ){
+        abort_("Failed Test 5");
+      }
+    }
+  }
+
+  // A screen sized triangle needs the 2*SIGFIG-bit distances
+  Triangle large;
+  large.v[0].x = 10 << config.r_shift;   large.v[0].y = 1000 << config.r_shift;
+  large.v[1].x = 1000 << config.r_shift; large.v[1].y = 990 << config.r_shift;
+  large.v[2].x = 20 << config.r_shift;   large.v[2].y = 10 << config.r_shift;
+
+  for( sample.x = 0 ; sample.x < screen.width ; sample.x += 7 << config.r_shift ){
+    for( sample.y = 0 ; sample.y < screen.height ; sample.y += 7 << config.r_shift ){
+      bool inside = true;
+      for( int i = 0 ; i < 3 ; i++ ){
+        ColorVertex3D a = large.v[i];
+        ColorVertex3D b = large.v[( i + 1 ) % 3];
+        long long dist = (long long)( a.x - sample.x ) * ( b.y - sample.y )
+                       - (long long)( b.x - sample.x ) * ( a.y - sample.y );
+        inside = inside && ( i == 1 ? dist < 0 : dist <= 0 );
+      }
+      if( sample_test_rtl( large, sample ) != inside ){
+        abort_("Failed Test 5");
+      }
+    }
+  }
+  Triangle reversed = large;
+  reversed.v[1] = large.v[2];
+  reversed.v[2] = large.v[1];
+  if( back_cull_rtl( large ) || !back_cull_rtl( reversed ) ){
+    abort_("Failed Test 5");
+  }
+
+  printf( "\t\tPass Test 5\n");
+
+  printf( "Test 6: Lane Order Test\n" );
+
+  Config lane_config = config;
+  lane_config.ss_w = 1 << config.ss_w_lg2;
+  lane_config.ss_i = 1 << ( config.r_shift - config.ss_w_lg2 );
+  int hits = rasterize_triangle( triangle, NULL, screen, lane_config );
+
+  // One lane, up the columns, is rasterize_triangle's own order
+  LaneIter it;
+  LaneSample group[LANE_ITER_MAX_LANES];
+  lane_iter_begin( &it, triangle, screen, lane_config, 1, LANE_ORDER_COLUMNS );
+  BoundingBox box = it.box;
+  Sample expect = box.lower_left;
+  int lane_hits = 0;
+  while( lane_iter_next( &it, group ) ){
+    if( group[0].sample.x != expect.x || group[0].sample.y != expect.y ){
+      abort_("Failed Test 6");
+    }
+    lane_hits += group[0].hit;
+    expect.y += lane_config.ss_i;
+    if( expect.y > box.upper_right.y ){
+      expect.y = box.lower_left.y;
+      expect.x += lane_config.ss_i;
+    }
+  }
+  if( lane_hits != hits || expect.x <= box.upper_right.x ){
+    abort_("Failed Test 6");
+  }
+
+  // Three lanes like test_iterator: every sample of the box once, in the predicted cycles
+  long cols = ( box.upper_right.x - box.lower_left.x ) / lane_config.ss_i + 1;
+  long rows = ( box.upper_right.y - box.lower_left.y ) / lane_config.ss_i + 1;
+  long in_box = 0;
+  lane_hits = 0;
+  lane_iter_begin( &it, triangle, screen, lane_config, 3, LANE_ORDER_ROWS );
+  while( lane_iter_next( &it, group ) ){
+    for( int l = 0 ; l < 3 ; l++ ){
+      if( group[l].sample.y != group[0].sample.y + l * lane_config.ss_i ){
+        abort_("Failed Test 6");
+      }
+      in_box += group[l].in_box;
+      lane_hits += group[l].in_box && group[l].hit;
+    }
+  }
+  if( it.cycle != lane_iter_cycles( box, lane_config, 3, LANE_ORDER_ROWS ) ||
+      in_box != cols * rows || lane_hits != hits ){
+    abort_("Failed Test 6");
+  }
+
+  printf( "\t\tPass Test 6\n");
+
   /* 
      If you are having trouble determining if your sample test
      function is correct, you can add more test cases
@@ -117,30 +289,162 @@ bool testRast()
 }
 
 
+/*
+   Gold-Ahead Test
+     rasterizer_gold --selftest: the gold-ahead stream answers for
+     sample_test on every sample, including triangles large enough
+     for its products to wrap, and resyncs when triangles are
+     skipped. Not run with the other tests, as it needs a
+     temporary file and a producer thread.
+*/
 
+// Every jittered sample of t looked up in the stream; false on a mismatch
+static bool ahead_matches( int stream, const Triangle& t, Screen screen, Config config,
+                           long& looked_up )
+{
+  BoundingBox b = get_bounding_box( t, screen, config );
+  if( !b.valid ){
+    return true;
+  }
+  int tri[6];
+  for( int v = 0 ; v < 3 ; v++ ){
+    tri[2 * v] = t.v[v].x;
+    tri[2 * v + 1] = t.v[v].y;
+  }
+  Sample sample;
+  for( sample.x = b.lower_left.x ; sample.x <= b.upper_right.x ; sample.x += config.ss_i ){
+    for( sample.y = b.lower_left.y ; sample.y <= b.upper_right.y ; sample.y += config.ss_i ){
+      Sample jitter = jitter_sample( sample, config.ss_w_lg2 );
+      Sample jittered;
+      jittered.x = sample.x + ( jitter.x << 2 );
+      jittered.y = sample.y + ( jitter.y << 2 );
+      if( gold_ahead_lookup( stream, tri, jittered.x, jittered.y ) != sample_test( t, jittered ) ){
+        return false;
+      }
+      looked_up++;
+    }
+  }
+  return true;
+}
 
-int main(int argc, char **argv)
+bool testGoldAhead()
 {
+  Config config;
+  config.r_shift = 10 ;
+  config.ss_w_lg2 = 2 ;
+  config.ss_w = 1 << config.ss_w_lg2;
+  config.ss_i = 1 << ( config.r_shift - config.ss_w_lg2 );
 
-  if( ! testRast() )
-  {
-    abort_("Test Failed");
+  Screen screen;
+  screen.width =  1024 << config.r_shift ;
+  screen.height = 1024 << config.r_shift ;
+
+  printf( "Test 7: Gold-Ahead Lookup Test\n" );
+
+  vector<Triangle> ahead;
+  int ahead_spans[7] = { 6, 8, 20, 40, 44, 46, 120 };
+  for( int k = 0 ; k < 7 ; k++ ){
+    int span = ahead_spans[k] << config.r_shift;
+    int o = ( 30 + 5 * k ) << config.r_shift;
+    Triangle t;
+    t.v[0].x = o;            t.v[0].y = o + span;
+    t.v[1].x = o + span;     t.v[1].y = o + span / 3;
+    t.v[2].x = o + span / 5; t.v[2].y = o;
+    ahead.push_back( t );
   }
 
-  if (argc != 3)
-  {
-    abort_("Usage: program_name <file_out> <vector>");
+  char ahead_file[] = "/tmp/rast_ahead_XXXXXX";
+  int fd = mkstemp( ahead_file );
+  FILE* f = fd < 0 ? NULL : fdopen( fd, "w" );
+  if( f == NULL ){
+    abort_("Failed Test 7");
   }
-  
+  fprintf( f, "JB21\n%06x %06x 16\n", screen.width, screen.height );
+  for( size_t t = 0 ; t < ahead.size() ; t++ ){
+    fprintf( f, "1 3" );
+    for( int v = 0 ; v < 3 ; v++ ){
+      fprintf( f, " %06x %06x %06x", ahead[t].v[v].x, ahead[t].v[v].y, 0 );
+    }
+    fprintf( f, " 000000 000000 000000 00ffff 00ffff 00ffff\n" );
+  }
+  fclose( f );
+
+  // Every triangle in order
+  int stream = gold_ahead_open( ahead_file );
+  long looked_up = 0;
+  bool ok = stream >= 0;
+  for( size_t t = 0 ; t < ahead.size() && ok ; t++ ){
+    ok = ahead_matches( stream, ahead[t], screen, config, looked_up );
+  }
+  gold_ahead_close( stream );
+  if( !ok || looked_up == 0 ){
+    remove( ahead_file );
+    abort_("Failed Test 7");
+  }
+
+  printf( "\t\tPass Test 7\n");
+
+  printf( "Test 8: Gold-Ahead Resync Test\n" );
+
+  // The RTL skips more triangles than the lookahead holds (they are
+  // reported), then sends one the stream never had: the next one is
+  // still answered
+  Triangle stray = ahead[0];
+  stray.v[2].x += 1 << config.r_shift;
+  int last[6];
+  for( int v = 0 ; v < 3 ; v++ ){
+    last[2 * v] = ahead.back().v[v].x;
+    last[2 * v + 1] = ahead.back().v[v].y;
+  }
+  stream = gold_ahead_open( ahead_file );
+  looked_up = 0;
+  ok = stream >= 0 &&
+       ahead_matches( stream, ahead[ahead.size() - 2], screen, config, looked_up ) &&
+       ahead_matches( stream, stray, screen, config, looked_up ) == false;
+  long answered = looked_up;
+  ok = ok && gold_ahead_lookup( stream, last, last[0], last[1] ) >= 0;
+  gold_ahead_close( stream );
+  remove( ahead_file );
+  if( !ok || answered == 0 ){
+    abort_("Failed Test 8");
+  }
+
+  printf( "\t\tPass Test 8\n");
+
+  return true ;
+}
+
+
+
+
+/*
+   Render Serial
+     Load, rasterize, resolve and write one after the other.
+*/
+void render_serial(char* file_out, char* file_in)
+{
   //Set Screen and Subsample
   vector<Triangle> triangles;
+  vector<TriangleSetup> setups;
   Screen screen;
   Config config;
 
   config.r_shift = 10;
 
   //Read in triangles from file
-  load_file(argv[2], triangles, screen, config);
+  if( is_mesh_file(file_in) ){
+    //Indexed mesh: shared edges are set up once
+    Mesh mesh;
+    load_mesh_file(file_in, mesh, screen, config);
+    expand_mesh(mesh, triangles);
+    setup_mesh(mesh, setups);
+  } else {
+    load_file(file_in, triangles, screen, config);
+    setups.resize(triangles.size());
+    for(size_t i = 0; i < triangles.size(); i++) {
+      setups[i] = triangle_setup(triangles[i]);
+    }
+  }
 
   //Report Number of triangles
   printf( "Triangles to rasterize: %zu\n" , triangles.size() );
@@ -150,9 +454,144 @@ int main(int argc, char **argv)
 
   //Rasterize the Scene   
   for(size_t i = 0; i < triangles.size(); i++) {
-    rasterize_triangle(triangles[i], zbuff, screen, config);
+    rasterize_triangle_setup(triangles[i], &setups[i], zbuff, screen, config);
   }
 
   //Write the Zbuffer to a file
-  write_ppm(zbuff, argv[1] );
+  write_ppm(zbuff, file_out );
+}
+
+
+/*
+   Render Resume
+     Continue a serial render from a z-buffer snapshot of an earlier
+     prefix of the same vector, then save the snapshot again. The
+     snapshot remembers how many triangles it holds and a hash of
+     them, so only an append-only vector resumes; a missing snapshot
+     starts from a black z-buffer.
+*/
+static unsigned long long triangles_tag(vector<Triangle>& triangles, size_t count)
+{
+  unsigned long long h = TRIANGLE_TAG_INIT;
+  for(size_t i = 0; i < count; i++) {
+    h = triangle_tag( h, triangles[i] );
+  }
+  return h;
+}
+
+void render_resume(char* file_out, char* file_in, char* snapshot, int flags)
+{
+  vector<Triangle> triangles;
+  Screen screen;
+  Config config;
+
+  config.r_shift = 10;
+  load_file(file_in, triangles, screen, config);
+
+  ZBuff *zbuff;
+  ZBuffMark mark = { 0, 0 };
+  FILE* f = fopen(snapshot, "rb");
+  if( f == NULL ){
+    zbuff = zbuff_init(screen, config);
+  } else {
+    fclose(f);
+    zbuff = zbuff_load(snapshot, &mark);
+    if( zbuff == NULL ){
+      abort_("Failed to Restore %s", snapshot);
+    }
+    if( zbuff->w != screen.width / 1024 || zbuff->h != screen.height / 1024 ||
+        zbuff->config.ss != config.ss ){
+      abort_("Snapshot %s is for another screen or MSAA", snapshot);
+    }
+    if( mark.triangles < 0 || (size_t)mark.triangles > triangles.size() ||
+        mark.tag != triangles_tag(triangles, mark.triangles) ){
+      abort_("Snapshot %s does not hold a prefix of %s", snapshot, file_in);
+    }
+  }
+
+  printf( "Triangles to rasterize: %zu (%lld from %s)\n" , triangles.size() - (size_t)mark.triangles ,
+          mark.triangles , snapshot );
+
+  for(size_t i = mark.triangles; i < triangles.size(); i++) {
+    TriangleSetup setup = triangle_setup(triangles[i]);
+    rasterize_triangle_setup(triangles[i], &setup, zbuff, screen, config);
+  }
+
+  write_ppm(zbuff, file_out );
+
+  mark.triangles = triangles.size();
+  mark.tag = triangles_tag(triangles, triangles.size());
+  if( !zbuff_save(zbuff, snapshot, mark, flags) ){
+    abort_("Failed to Save %s", snapshot);
+  }
+  zbuff_free(zbuff);
+}
+
+
+int main(int argc, char **argv)
+{
+
+  if( ! testRast() )
+  {
+    abort_("Test Failed");
+  }
+
+  if (argc == 4 && !strcmp(argv[1], "--serial"))
+  {
+    render_serial(argv[2], argv[3]);
+    return 0;
+  }
+
+  if (argc >= 5 && !strcmp(argv[1], "--resume"))
+  {
+    //Snapshot in and out, -z run-length codes it
+    bool rle = argc == 6 && !strcmp(argv[2], "-z");
+    if (argc != (rle ? 6 : 5))
+    {
+      abort_("Usage: program_name --resume [-z] <snapshot> <file_out> <vector>");
+    }
+    render_resume(argv[argc - 2], argv[argc - 1], argv[argc - 3], rle ? ZBUFF_SNAPSHOT_RLE : 0);
+    return 0;
+  }
+
+  if (argc >= 3 && !strcmp(argv[1], "--batch"))
+  {
+    //Many (vector, file_out) pairs in one process
+    vector<BatchJob> jobs;
+    load_batch_file(argv[2], jobs);
+    return render_batch(jobs, argc >= 4 ? atoi(argv[3]) : 0) ? 1 : 0;
+  }
+
+  if (argc == 2 && !strcmp(argv[1], "--selftest"))
+  {
+    //Tests with a temporary file and threads, not run on every render
+    if( ! testGoldAhead() )
+    {
+      abort_("Test Failed");
+    }
+    return 0;
+  }
+
+  if (argc == 4 && !strcmp(argv[1], "--golden"))
+  {
+    //Expected sample stream for simulation replay
+    long count = golden_stream_write(argv[3], argv[2]);
+    printf( "Golden stream records: %ld\n" , count );
+    return 0;
+  }
+
+  if (argc != 3)
+  {
+    abort_("Usage: program_name [--serial] <file_out> <vector>\n"
+           "       program_name --resume [-z] <snapshot> <file_out> <vector>\n"
+           "       program_name --batch <list> [workers]\n"
+           "       program_name --golden <stream_out> <vector>\n"
+           "       program_name --selftest");
+  }
+
+  //Parse, rasterize and resolve/write as overlapped stages
+  size_t count = render_pipelined(argv[2], argv[1], pipeline_defaults());
+
+  //Report Number of triangles
+  printf( "Triangles rasterized: %zu\n" , count );
 }
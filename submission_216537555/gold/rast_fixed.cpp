@@ -0,0 +1,51 @@
+#include "fixed.h"
+extern "C"{
+#include "rast_fixed.h"
+}
+
+typedef Fixed<RAST_SIGFIG, RAST_RADIX> Coord;          // logic signed [SIGFIG-1:0]
+typedef Fixed<2 * RAST_SIGFIG, 2 * RAST_RADIX> Area;   // logic signed [2*SIGFIG-1:0]
+
+static_assert(sizeof(Coord) == sizeof(int32_t), "Coord lowers to an int");
+static_assert(sizeof(Area) == sizeof(int64_t), "Area lowers to an int64_t");
+
+// x_1 * y_2 - x_2 * y_1 into a 2*SIGFIG-bit signal
+static inline Area cross(Coord x1, Coord y1, Coord x2, Coord y2)
+{
+  return ( x1 * y2 - x2 * y1 ).wrap<2 * RAST_SIGFIG>();
+}
+
+// Vertex field shifted by the sample, into a SIGFIG-bit signal
+static inline Coord shift(int v, Coord s)
+{
+  return ( Coord::from_raw( v ) - s ).wrap<RAST_SIGFIG>();
+}
+
+bool sample_test_rtl(Triangle triangle, Sample sample)
+{
+  Coord s_x = Coord::from_raw( sample.x );
+  Coord s_y = Coord::from_raw( sample.y );
+
+  // Shift vertices such that sample is origin
+  Coord x0 = shift( triangle.v[0].x, s_x ), y0 = shift( triangle.v[0].y, s_y );
+  Coord x1 = shift( triangle.v[1].x, s_x ), y1 = shift( triangle.v[1].y, s_y );
+  Coord x2 = shift( triangle.v[2].x, s_x ), y2 = shift( triangle.v[2].y, s_y );
+
+  // Edge 1 is exclusive, edges 0 and 2 are inclusive
+  return cross( x0, y0, x1, y1 ) <= Area()  // 0 -1 edge
+      && cross( x1, y1, x2, y2 ) <  Area()  // 1 -2 edge
+      && cross( x2, y2, x0, y0 ) <= Area(); // 2 -0 edge
+}
+
+bool back_cull_rtl(Triangle triangle)
+{
+  Coord x0 = Coord::from_raw( triangle.v[0].x ), y0 = Coord::from_raw( triangle.v[0].y );
+  Coord x1 = Coord::from_raw( triangle.v[1].x ), y1 = Coord::from_raw( triangle.v[1].y );
+  Coord x2 = Coord::from_raw( triangle.v[2].x ), y2 = Coord::from_raw( triangle.v[2].y );
+
+  // Edges vert0 -> vert1 and vert1 -> vert2
+  Coord e0_x = ( x1 - x0 ).wrap<RAST_SIGFIG>(), e0_y = ( y1 - y0 ).wrap<RAST_SIGFIG>();
+  Coord e1_x = ( x2 - x1 ).wrap<RAST_SIGFIG>(), e1_y = ( y2 - y1 ).wrap<RAST_SIGFIG>();
+
+  return cross( e0_x, e0_y, e1_x, e1_y ) > Area();
+}
@@ -0,0 +1,23 @@
+#ifndef RAST_FIXED_H
+#define RAST_FIXED_H
+
+#include <stdbool.h>
+#include "rast_types.h"
+
+/*
+ *  Gold kernels at the RTL's widths (see fixed.h), for checks that
+ *  must agree with the hardware bit for bit where the int math of
+ *  rasterizer.c wraps. Vertex and sample fields are taken as the
+ *  SIGFIG-bit signed values the RTL ports see.
+ */
+
+#define RAST_SIGFIG 24 // rast_params SIGFIG
+#define RAST_RADIX 10  // rast_params RADIX
+
+// sampletest.sv: SIGFIG-bit shifted vertices, 2*SIGFIG-bit distances
+bool sample_test_rtl(Triangle triangle, Sample sample);
+
+// bbox.sv: back facing by the 2*SIGFIG-bit cross product of edges 0-1 and 1-2
+bool back_cull_rtl(Triangle triangle);
+
+#endif
@@ -0,0 +1,297 @@
+#include "helper.h"
+extern "C"{
+#include "rast_stats.h"
+}
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+using namespace std;
+
+#define STATS_NONE -1  // bbox stage without a triangle
+
+enum { STAGE_R10, STAGE_R13, STAGE_R14, STAGE_R16, STAGES };
+
+static const char* stage_names[STAGES] = { "R10", "R13", "R14", "R16" };
+static const char* lane_names[3] = { "A", "B", "C" };
+
+typedef struct {
+  long long accept;     // cycle bbox took it at R10
+  long long leave;      // cycle it left bbox at R13, -1 while in bbox
+  int       taken;      // 0 if culled
+  long long samples;    // validSamp_R14H cycles
+  long long last_r14;
+} StatsTriangle;
+
+struct RastStats {
+  string                prefix;
+  int                   pipes_box;
+  int                   pipes_hash;
+  int                   pipes_samp;
+
+  long long             cycles;     // out of reset
+  deque<long long>      bbox;       // triangle in each bbox stage, R10 side at the back
+  vector<StatsTriangle> tris;
+  long long             iter;       // triangle the iterator took last
+  long long             halted;     // halt_RnnnnL low
+  long long             stalled;    // validTri_R10H held while halted
+  long long             bubbles[STAGES];
+  long long             lane_valid[3];
+  long long             lane_hits[3];
+  long long             orphans;    // R13 valid with no accepted triangle, depth mismatch
+};
+
+static RastStats* stats_all[RAST_STATS_MAX];
+static mutex stats_m;
+
+int rast_stats_open( const char* prefix, int pipes_box, int pipes_hash, int pipes_samp )
+{
+  if( pipes_box < 1 ){
+    printf( "[ERROR] rast-stats: PIPES_BOX %d\n", pipes_box );
+    return -1;
+  }
+
+  RastStats* s = new RastStats();
+  s->prefix = prefix;
+  s->pipes_box = pipes_box;
+  s->pipes_hash = pipes_hash;
+  s->pipes_samp = pipes_samp;
+  s->cycles = 0;
+  s->bbox.assign( pipes_box, STATS_NONE );
+  s->iter = STATS_NONE;
+  s->halted = 0;
+  s->stalled = 0;
+  s->orphans = 0;
+  memset( s->bubbles, 0, sizeof( s->bubbles ) );
+  memset( s->lane_valid, 0, sizeof( s->lane_valid ) );
+  memset( s->lane_hits, 0, sizeof( s->lane_hits ) );
+
+  int handle = -1;
+  {
+    lock_guard<mutex> lock( stats_m );
+    for( int i = 0 ; i < RAST_STATS_MAX && handle < 0 ; i++ ){
+      if( stats_all[i] == NULL ){
+        stats_all[i] = s;
+        handle = i;
+      }
+    }
+  }
+  if( handle < 0 ){
+    printf( "[ERROR] rast-stats: all %d collectors are in use\n", RAST_STATS_MAX );
+    delete s;
+    return -1;
+  }
+  return handle;
+}
+
+static RastStats* rast_stats( int stats )
+{
+  if( stats < 0 || stats >= RAST_STATS_MAX )
+    return NULL;
+  return stats_all[stats];
+}
+
+void rast_stats_cycle( int stats, int signals )
+{
+  RastStats* s = rast_stats( stats );
+  if( s == NULL )
+    return;
+
+  if( signals & RAST_STATS_RST ){
+    fill( s->bbox.begin(), s->bbox.end(), STATS_NONE );
+    s->iter = STATS_NONE;
+    return;
+  }
+
+  long long cycle = s->cycles++;
+  int halt = signals & RAST_STATS_HALT;
+
+  if( !halt ){
+    s->halted++;
+    if( signals & RAST_STATS_VALID_R10 )
+      s->stalled++;
+  }
+  if( !( signals & RAST_STATS_VALID_R10 ) ) s->bubbles[STAGE_R10]++;
+  if( !( signals & RAST_STATS_VALID_R13 ) ) s->bubbles[STAGE_R13]++;
+  if( !( signals & RAST_STATS_VALID_R14 ) ) s->bubbles[STAGE_R14]++;
+  if( !( signals & RAST_STATS_VALID_R16 ) ) s->bubbles[STAGE_R16]++;
+  for( int l = 0 ; l < 3 ; l++ ){
+    if( signals & ( RAST_STATS_VALID_R16 << l ) ) s->lane_valid[l]++;
+    if( signals & ( RAST_STATS_HIT_R18 << l ) )   s->lane_hits[l]++;
+  }
+
+  // Samples this clock still belong to the box the iterator is walking
+  if( ( signals & RAST_STATS_VALID_R14 ) && s->iter != STATS_NONE ){
+    StatsTriangle& t = s->tris[s->iter];
+    t.samples++;
+    t.last_r14 = cycle;
+  }
+
+  // bbox only advances while halt_RnnnnL is high, and the iterator only
+  // takes the R13 triangle then
+  if( !halt )
+    return;
+
+  long long leaving = s->bbox.front();
+  s->bbox.pop_front();
+  if( leaving != STATS_NONE ){
+    StatsTriangle& t = s->tris[leaving];
+    t.leave = cycle;
+    t.taken = ( signals & RAST_STATS_VALID_R13 ) != 0;
+    if( t.taken )
+      s->iter = leaving;
+  } else if( signals & RAST_STATS_VALID_R13 ){
+    s->orphans++;
+  }
+
+  long long entering = STATS_NONE;
+  if( signals & RAST_STATS_VALID_R10 ){
+    StatsTriangle t = { cycle, -1, 0, 0, -1 };
+    entering = s->tris.size();
+    s->tris.push_back( t );
+  }
+  s->bbox.push_back( entering );
+}
+
+// Cycle its last sample leaves sampletest, -1 if it has none yet
+static long long stats_done( const RastStats* s, const StatsTriangle& t )
+{
+  if( t.leave < 0 )
+    return -1;
+  if( !t.taken || t.samples == 0 )
+    return t.leave;
+  return t.last_r14 + s->pipes_hash + s->pipes_samp;
+}
+
+// Bucket 0 is [0, 2), bucket k is [2^k, 2^(k+1))
+static int log2_bucket( long long v )
+{
+  return v < 2 ? 0 : 63 - __builtin_clzll( (unsigned long long)v );
+}
+
+static void write_histogram( FILE* f, const char* name, vector<long long>& v, int last )
+{
+  sort( v.begin(), v.end() );
+  fprintf( f, "  \"%s\": {\n    \"count\": %zu", name, v.size() );
+  if( !v.empty() ){
+    double sum = 0;
+    for( size_t i = 0 ; i < v.size() ; i++ )
+      sum += v[i];
+    fprintf( f, ",\n    \"min\": %lld,\n    \"mean\": %.3f,\n    \"p50\": %lld,\n"
+             "    \"p90\": %lld,\n    \"p99\": %lld,\n    \"max\": %lld",
+             v.front(), sum / v.size(), v[v.size() / 2], v[v.size() * 9 / 10],
+             v[v.size() * 99 / 100], v.back() );
+  }
+  fprintf( f, ",\n    \"histogram\": [" );
+  if( !v.empty() ){
+    vector<long long> buckets( log2_bucket( v.back() ) + 1, 0 );
+    for( size_t i = 0 ; i < v.size() ; i++ )
+      buckets[log2_bucket( v[i] )]++;
+    for( size_t k = 0 ; k < buckets.size() ; k++ )
+      fprintf( f, "%s\n      { \"from\": %lld, \"to\": %lld, \"count\": %lld }",
+               k ? "," : "", k ? 1ll << k : 0ll, 2ll << k, buckets[k] );
+    fprintf( f, "\n    " );
+  }
+  fprintf( f, "]\n  }%s\n", last ? "" : "," );
+}
+
+int rast_stats_close( int stats )
+{
+  RastStats* s = rast_stats( stats );
+  if( s == NULL )
+    return 0;
+
+  string csv_name = s->prefix + ".csv";
+  string json_name = s->prefix + ".json";
+  FILE* csv = fopen( csv_name.c_str(), "w" );
+  FILE* json = fopen( json_name.c_str(), "w" );
+  if( csv == NULL || json == NULL ){
+    printf( "[ERROR] rast-stats: cannot write %s / %s\n", csv_name.c_str(), json_name.c_str() );
+  }
+
+  vector<long long> latency, culled_latency, interval;
+  long long culled = 0, in_flight = 0, samples = 0;
+
+  if( csv != NULL )
+    fprintf( csv, "triangle,accept,leave_bbox,culled,samples,last_sample,latency\n" );
+  for( size_t i = 0 ; i < s->tris.size() ; i++ ){
+    const StatsTriangle& t = s->tris[i];
+    long long done = stats_done( s, t );
+    if( i > 0 )
+      interval.push_back( t.accept - s->tris[i - 1].accept );
+    if( done < 0 ){
+      in_flight++;
+    } else if( !t.taken ){
+      culled++;
+      culled_latency.push_back( done - t.accept );
+    } else {
+      latency.push_back( done - t.accept );
+    }
+    samples += t.samples;
+
+    if( csv != NULL ){
+      fprintf( csv, "%zu,%lld,%lld,%d,%lld,", i, t.accept, t.leave,
+               t.leave >= 0 && !t.taken, t.samples );
+      if( done < 0 )
+        fprintf( csv, ",\n" );
+      else
+        fprintf( csv, "%lld,%lld\n", done, done - t.accept );
+    }
+  }
+  if( csv != NULL )
+    fclose( csv );
+
+  long long tris = s->tris.size();
+  double cycles = s->cycles ? (double)s->cycles : 1.0;
+
+  if( json != NULL ){
+    fprintf( json, "{\n" );
+    fprintf( json, "  \"pipes\": { \"box\": %d, \"hash\": %d, \"samp\": %d },\n",
+             s->pipes_box, s->pipes_hash, s->pipes_samp );
+    fprintf( json, "  \"cycles\": %lld,\n  \"triangles\": %lld,\n  \"culled\": %lld,\n"
+             "  \"in_flight\": %lld,\n  \"sample_cycles\": %lld,\n",
+             s->cycles, tris, culled, in_flight, samples );
+    fprintf( json, "  \"cycles_per_triangle\": %.4f,\n", tris ? s->cycles / (double)tris : 0.0 );
+    fprintf( json, "  \"halt\": { \"cycles\": %lld, \"fraction\": %.4f, "
+             "\"r10_stalled\": %lld, \"r10_stalled_fraction\": %.4f },\n",
+             s->halted, s->halted / cycles, s->stalled, s->stalled / cycles );
+
+    fprintf( json, "  \"bubbles\": {" );
+    for( int g = 0 ; g < STAGES ; g++ )
+      fprintf( json, "%s\n    \"%s\": { \"cycles\": %lld, \"fraction\": %.4f }",
+               g ? "," : "", stage_names[g], s->bubbles[g], s->bubbles[g] / cycles );
+    fprintf( json, "\n  },\n" );
+
+    fprintf( json, "  \"lanes\": {" );
+    for( int l = 0 ; l < 3 ; l++ )
+      fprintf( json, "%s\n    \"%s\": { \"valid\": %lld, \"hits\": %lld, "
+               "\"utilization\": %.4f, \"of_lane_A\": %.4f }",
+               l ? "," : "", lane_names[l], s->lane_valid[l], s->lane_hits[l],
+               s->lane_valid[l] / cycles,
+               s->lane_valid[0] ? s->lane_valid[l] / (double)s->lane_valid[0] : 0.0 );
+    fprintf( json, "\n  },\n" );
+
+    write_histogram( json, "latency", latency, 0 );
+    write_histogram( json, "culled_latency", culled_latency, 0 );
+    write_histogram( json, "issue_interval", interval, 1 );
+    fprintf( json, "}\n" );
+    fclose( json );
+  }
+
+  if( s->orphans )
+    printf( "[WARNING] rast-stats: %lld R13 triangles not seen at R10, is PIPES_BOX %d right?\n",
+            s->orphans, s->pipes_box );
+  printf( "rast-stats: %lld cycles, %lld triangles (%lld culled), %.3f cycles/triangle, "
+          "halted %.1f%%, lanes A/B/C %.1f%%/%.1f%%/%.1f%%\n",
+          s->cycles, tris, culled, tris ? s->cycles / (double)tris : 0.0,
+          100.0 * s->halted / cycles, 100.0 * s->lane_valid[0] / cycles,
+          100.0 * s->lane_valid[1] / cycles, 100.0 * s->lane_valid[2] / cycles );
+
+  {
+    lock_guard<mutex> lock( stats_m );
+    stats_all[stats] = NULL;
+  }
+  delete s;
+  return 1;
+}
@@ -0,0 +1,42 @@
+#ifndef RAST_STATS_H
+#define RAST_STATS_H
+
+/*
+ *  Per-triangle statistics of an RTL run, fed by verif/stats_monitor.sv.
+ *
+ *  Every clock the monitor hands rast_stats_cycle the handshake signals
+ *  of rast as one bitmask. A triangle is stamped when bbox accepts it
+ *  (validTri_R10H with halt_RnnnnL high), followed through the PIPES_BOX
+ *  stages of bbox, and either culled or taken by the iterator at R13;
+ *  the validSamp_R14H cycles after a take are its samples, and its last
+ *  sample leaves sampletest PIPES_HASH + PIPES_SAMP clocks after its
+ *  last R14 cycle.
+ *
+ *  rast_stats_close writes
+ *
+ *    <prefix>.csv    one row per triangle: accept, leave, samples, latency
+ *    <prefix>.json   latency and issue interval histograms, halt stalls,
+ *                    bubbles per stage and A/B/C lane utilization
+ *
+ *  Handles are small ints for the DPI; -1 means the collector can't start.
+ */
+
+#define RAST_STATS_MAX 16
+
+// rast_stats_cycle signal bits
+#define RAST_STATS_RST       ( 1 << 0 )
+#define RAST_STATS_VALID_R10 ( 1 << 1 )  // validTri_R10H
+#define RAST_STATS_HALT      ( 1 << 2 )  // halt_RnnnnL, high when bbox may advance
+#define RAST_STATS_VALID_R13 ( 1 << 3 )  // validTri_R13H
+#define RAST_STATS_VALID_R14 ( 1 << 4 )  // validSamp_R14H
+#define RAST_STATS_VALID_R16 ( 1 << 5 )  // validSamp_R16H, _B << 1, _C << 2
+#define RAST_STATS_HIT_R18   ( 1 << 8 )  // hit_valid_R18H, _B << 1, _C << 2
+
+int rast_stats_open(const char* prefix, int pipes_box, int pipes_hash, int pipes_samp);
+
+void rast_stats_cycle(int stats, int signals);
+
+// Write the CSV and JSON, print a summary and release the handle
+int rast_stats_close(int stats);
+
+#endif
@@ -34,6 +34,13 @@ typedef struct { // bounding box
 	bool valid;
 } BoundingBox;
 
+typedef enum { // what get_bounding_box did with a triangle
+	BBOX_INSIDE,     // valid, inside the screen
+	BBOX_CLAMPED,    // valid, cut by the screen edge
+	BBOX_BACK_FACE,  // culled by the orientation test
+	BBOX_OFF_SCREEN  // empty after clipping to the screen
+} BBoxCull;
+
 typedef struct { // screen
 	int width; // width of screen (on x axis)
 	int height; // height of screen (on y axis)
@@ -56,6 +63,19 @@ typedef struct { // config
 
 typedef Vertex2D Sample;
 
+typedef struct { // edge equation: e(s) = a*s.x + b*s.y + c, exact in 64 bits
+    int a;
+    int b;
+    long long c;
+} EdgeEq;
+
+typedef struct { // per-triangle setup: edges 0-1, 1-2, 2-0
+    EdgeEq e[3];
+    Vertex2D v[3];  // vertices, for samples outside [lo, hi]
+    Vertex2D lo;    // samples in [lo, hi] are tested with the edges,
+    Vertex2D hi;    // empty if sample_test's products can wrap there
+} TriangleSetup;
+
 typedef struct {
     uint z;
 
@@ -71,6 +91,8 @@ typedef struct {
     Config config;
     ushort* frame_buffer ;
     uint*   depth_buffer ;
+    void*   snapshot ;      // file mapping the buffers point into, NULL if allocated
+    unsigned long snapshot_size ;
 } ZBuff;
 
 
@@ -1,4 +1,5 @@
 #include "rasterizer.h"
+#include <limits.h>
 #include <stdlib.h>
 
 #ifdef __cplusplus
@@ -34,21 +35,25 @@ int floor_ss(int val, int r_shift, int ss_w_lg2)
   return (val >> (r_shift - ss_w_lg2)) << (r_shift - ss_w_lg2);
 }
 
+// 32-bit product, wrapped
+static int wrap_mul(int a, int b)
+{
+  return (int)((uint)a * (uint)b);
+}
+
 /*
- *  Function: rastBBox_bbox_fix
- *  Function Description: Determine a bounding box for the triangle.
- *  Note that this is a fixed point function.
+ *  Function: bounding_box_cull
+ *  Function Description: get_bounding_box, also returning why the
+ *  box is what it is: BBOX_BACK_FACE if the orientation test culls
+ *  the triangle, else BBOX_OFF_SCREEN if clipping to the screen
+ *  leaves the box empty, else BBOX_CLAMPED if clipping cut it,
+ *  else BBOX_INSIDE. bbox->valid is set for the last two only.
 */
-BoundingBox get_bounding_box(Triangle triangle, Screen screen, Config config)
+BBoxCull bounding_box_cull(Triangle triangle, Screen screen, Config config, BoundingBox *bbox)
 {
-  BoundingBox bbox;
-
-  // START CODE HERE
-  // initialize bounding box to first vertex
   int ll_x, ur_x, ll_y, ur_y;
-  bool in_bound, back_cull;
+  bool in_bound, back_cull, clamped;
   Vertex2D edge1, edge2;
-  int angle_lg;
 
   // iterate over remaining vertices
   ll_x = min(triangle.v[0].x, min(triangle.v[1].x, triangle.v[2].x));
@@ -60,6 +65,7 @@ BoundingBox get_bounding_box(Triangle triangle, Screen screen, Config config)
   ur_x = floor_ss(ur_x, config.r_shift, config.ss_w_lg2);
   ll_y = floor_ss(ll_y, config.r_shift, config.ss_w_lg2);
   ur_y = floor_ss(ur_y, config.r_shift, config.ss_w_lg2);
+  clamped = ll_x < 0 || ll_y < 0 || ur_x > screen.width || ur_y > screen.height;
   // clip lower bound with 0
   ll_x = ll_x < 0 ? 0 : ll_x;
   ll_y = ll_y < 0 ? 0 : ll_y;
@@ -71,19 +77,69 @@ BoundingBox get_bounding_box(Triangle triangle, Screen screen, Config config)
   edge1.y = triangle.v[1].y - triangle.v[0].y;
   edge2.x = triangle.v[2].x - triangle.v[1].x;
   edge2.y = triangle.v[2].y - triangle.v[1].y;
-  angle_lg = edge1.x * edge2.y - edge2.x * edge1.y;
-  back_cull = angle_lg > 0;
+  // The products are compared rather than subtracted, each wrapping
+  // to 32 bits, as the int expression angle = p - q > 0 has always
+  // compiled at -O2 (see vertex_test)
+  back_cull = wrap_mul(edge1.x, edge2.y) > wrap_mul(edge2.x, edge1.y);
   in_bound =  ((ll_x <= ur_x) && (ll_y <= ur_y));
-  bbox.valid =  in_bound && (!back_cull);
+  bbox->valid =  in_bound && (!back_cull);
   // round up back to original, initialize bounding box coordinate
-  bbox.lower_left.x = ll_x;
-  bbox.lower_left.y = ll_y;
-  bbox.upper_right.x = ur_x;
-  bbox.upper_right.y = ur_y;
+  bbox->lower_left.x = ll_x;
+  bbox->lower_left.y = ll_y;
+  bbox->upper_right.x = ur_x;
+  bbox->upper_right.y = ur_y;
+
+  if( back_cull )
+    return BBOX_BACK_FACE;
+  if( !in_bound )
+    return BBOX_OFF_SCREEN;
+  return clamped ? BBOX_CLAMPED : BBOX_INSIDE;
+}
+
+/*
+ *  Function: rastBBox_bbox_fix
+ *  Function Description: Determine a bounding box for the triangle.
+ *  Note that this is a fixed point function.
+*/
+BoundingBox get_bounding_box(Triangle triangle, Screen screen, Config config)
+{
+  BoundingBox bbox;
+
+  // START CODE HERE
+  bounding_box_cull(triangle, screen, config, &bbox);
   // END CODE HERE
   return bbox;
 }
 
+// sample_test on the x,y of the vertices
+static bool vertex_test(const Vertex2D tv[3], Sample sample)
+{
+  bool isHit;
+  Vertex2D v[3];
+  bool b[3];
+
+  // Shift vertices such that sample is origin
+  v[0].x = tv[0].x - sample.x;
+  v[0].y = tv[0].y - sample.y;
+  v[1].x = tv[1].x - sample.x;
+  v[1].y = tv[1].y - sample.y;
+  v[2].x = tv[2].x - sample.x;
+  v[2].y = tv[2].y - sample.y;
+  // Test if origin is on right side of shifted edge(notice: edge included).
+  // The two products of each edge's distance are compared rather than
+  // subtracted, each wrapping to 32 bits: that is what the int
+  // expression dist = p - q <= 0 has always compiled to at -O2, so it
+  // keeps the images of the original gold model, now without relying
+  // on signed overflow.
+  b[0] = wrap_mul(v[0].x, v[1].y) <= wrap_mul(v[1].x, v[0].y); // 0 -1 edge
+  b[1] = wrap_mul(v[1].x, v[2].y) <  wrap_mul(v[2].x, v[1].y); // 1 -2 edge
+  b[2] = wrap_mul(v[2].x, v[0].y) <= wrap_mul(v[0].x, v[2].y); // 2 -0 edge
+  // Triangle min terms with backface culling
+  isHit = b[0] && b[1] && b[2];
+
+  return isHit;
+}
+
 /*
  *  Function: sample_test
  *  Function Description: Checks if sample lies inside triangle
@@ -92,35 +148,131 @@ BoundingBox get_bounding_box(Triangle triangle, Screen screen, Config config)
  */
 bool sample_test(Triangle triangle, Sample sample)
 {
-  bool isHit;
   Vertex2D v[3];
-  int dist[3];
-  bool b[3];
 
   // START CODE HERE
-  // Shift vertices such that sample is origin
-  v[0].x = triangle.v[0].x - sample.x;
-  v[0].y = triangle.v[0].y - sample.y;
-  v[1].x = triangle.v[1].x - sample.x;
-  v[1].y = triangle.v[1].y - sample.y;
-  v[2].x = triangle.v[2].x - sample.x;
-  v[2].y = triangle.v[2].y - sample.y;
-  // Distance of origin shifted edge
-  dist[0] = v[0].x * v[1].y - v[1].x * v[0].y ; // 0 -1 edge
-  dist[1] = v[1].x * v[2].y - v[2].x * v[1].y ; // 1 -2 edge
-  dist[2] = v[2].x * v[0].y - v[0].x * v[2].y ; // 2 -0 edge
-  // Test if origin is on right side of shifted edge(notice: edge included)
-  b[0] = (dist[0] <= 0.0);
-  b[1] = (dist[1] < 0.0);
-  b[2] = (dist[2] <= 0.0);
-  // Triangle min terms with backface culling
-  isHit = b[0] && b[1] && b[2];
+  for (int i = 0; i < 3; i++)
+  {
+    v[i].x = triangle.v[i].x;
+    v[i].y = triangle.v[i].y;
+  }
   // END CODE HERE
 
-  return isHit;
+  return vertex_test(v, sample);
+}
+
+/*
+ *  Function: edge_setup
+ *  Function Description: Builds the edge equation of the directed edge v0->v1.
+ *  Expanding the cross product in sample_test gives
+ *    dist = (v0.y - v1.y)*s.x + (v1.x - v0.x)*s.y + (v0.x*v1.y - v1.x*v0.y)
+ *  which is exact in 64 bits for 24-bit coordinates.
+ */
+EdgeEq edge_setup(ColorVertex3D v0, ColorVertex3D v1)
+{
+  EdgeEq e;
+  e.a = v0.y - v1.y;
+  e.b = v1.x - v0.x;
+  e.c = (long long)v0.x * v1.y - (long long)v1.x * v0.y;
+  return e;
+}
+
+/*
+ *  Function: edge_negate
+ *  Function Description: Edge equation of the same edge walked the other way
+ *  (v1->v0). Used by neighboring triangles of a mesh that share an edge.
+ */
+EdgeEq edge_negate(EdgeEq e)
+{
+  EdgeEq n;
+  n.a = -e.a;
+  n.b = -e.b;
+  n.c = -e.c;
+  return n;
+}
+
+/*
+ *  Function: triangle_setup_bounds
+ *  Function Description: Fills in the vertices and the sample window of a
+ *  setup. Samples of the bounding box lie within a pixel of the vertices
+ *  (floored to the grid, jittered by less than a pixel), so there every
+ *  product in sample_test is at most (w + 1024) * (h + 1024). While that
+ *  fits in an int none of them wraps, and comparing them is the exact
+ *  sign of the edge equation. Larger triangles get an empty window and
+ *  every sample goes to sample_test itself.
+ */
+void triangle_setup_bounds(TriangleSetup *setup, Triangle triangle)
+{
+  int x0 = min(triangle.v[0].x, min(triangle.v[1].x, triangle.v[2].x));
+  int x1 = max(triangle.v[0].x, max(triangle.v[1].x, triangle.v[2].x));
+  int y0 = min(triangle.v[0].y, min(triangle.v[1].y, triangle.v[2].y));
+  int y1 = max(triangle.v[0].y, max(triangle.v[1].y, triangle.v[2].y));
+
+  for (int i = 0; i < 3; i++)
+  {
+    setup->v[i].x = triangle.v[i].x;
+    setup->v[i].y = triangle.v[i].y;
+  }
+
+  if (((long long)x1 - x0 + 1024) * ((long long)y1 - y0 + 1024) <= INT_MAX)
+  {
+    setup->lo.x = x0 - 1024;
+    setup->lo.y = y0 - 1024;
+    setup->hi.x = x1 + 1024;
+    setup->hi.y = y1 + 1024;
+  }
+  else
+  {
+    setup->lo.x = setup->lo.y = 1;
+    setup->hi.x = setup->hi.y = 0;
+  }
+}
+
+/*
+ *  Function: triangle_setup
+ *  Function Description: Computes the three edge equations of a triangle once
+ *  so they can be evaluated for every sample in its bounding box.
+ */
+TriangleSetup triangle_setup(Triangle triangle)
+{
+  TriangleSetup setup;
+  setup.e[0] = edge_setup(triangle.v[0], triangle.v[1]);
+  setup.e[1] = edge_setup(triangle.v[1], triangle.v[2]);
+  setup.e[2] = edge_setup(triangle.v[2], triangle.v[0]);
+  triangle_setup_bounds(&setup, triangle);
+  return setup;
+}
+
+static long long edge_eval(EdgeEq e, Sample s)
+{
+  return (long long)e.a * s.x + (long long)e.b * s.y + e.c;
+}
+
+/*
+ *  Function: sample_test_setup
+ *  Function Description: Same test as sample_test, evaluated from precomputed
+ *  edge equations inside the setup's window. Edge 1 is exclusive, edges 0
+ *  and 2 are inclusive.
+ */
+bool sample_test_setup(const TriangleSetup *setup, Sample sample)
+{
+  if (sample.x < setup->lo.x || sample.x > setup->hi.x ||
+      sample.y < setup->lo.y || sample.y > setup->hi.y)
+  {
+    return vertex_test(setup->v, sample);
+  }
+  return (edge_eval(setup->e[0], sample) <= 0)
+      && (edge_eval(setup->e[1], sample) <  0)
+      && (edge_eval(setup->e[2], sample) <= 0);
 }
 
 int rasterize_triangle(Triangle triangle, ZBuff *z, Screen screen, Config config)
+{
+  TriangleSetup setup = triangle_setup(triangle);
+  return rasterize_triangle_setup(triangle, &setup, z, screen, config);
+}
+
+int rasterize_triangle_setup(Triangle triangle, const TriangleSetup *setup, ZBuff *z, Screen screen, Config config)
 {
   int hit_count = 0;
   //Calculate BBox
@@ -141,7 +293,7 @@ int rasterize_triangle(Triangle triangle, ZBuff *z, Screen screen, Config config
       jittered_sample.x = sample.x + jitter.x;
       jittered_sample.y = sample.y + jitter.y;
 
-      bool hit = sample_test(triangle, jittered_sample);
+      bool hit = sample_test_setup(setup, jittered_sample);
 
       if (hit)
       {
@@ -8,9 +8,16 @@
 int min(int a, int b);
 int max(int a, int b);
 int floor_ss(int val, int r_shift, int ss_w_lg2);
+BBoxCull bounding_box_cull(Triangle triangle, Screen screen, Config config, BoundingBox *bbox);
 BoundingBox get_bounding_box(Triangle triangle, Screen screen, Config config);
 bool sample_test(Triangle triangle, Sample sample);
+EdgeEq edge_setup(ColorVertex3D v0, ColorVertex3D v1);
+EdgeEq edge_negate(EdgeEq e);
+void triangle_setup_bounds(TriangleSetup *setup, Triangle triangle);
+TriangleSetup triangle_setup(Triangle triangle);
+bool sample_test_setup(const TriangleSetup *setup, Sample sample);
 int rasterize_triangle( Triangle triangle, ZBuff *z, Screen screen, Config config);
+int rasterize_triangle_setup( Triangle triangle, const TriangleSetup *setup, ZBuff *z, Screen screen, Config config);
 void hash_40to8( uchar* arr40 , ushort* val , int shift );
 Sample jitter_sample(const Sample sample, const int ss_w_lg2);
 
@@ -1,12 +1,574 @@
+#include "dpi_trace.h"
+#include "gold_ahead.h"
 #include "rasterizer.h"
 #include "rasterizer_sv_interface.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
-#define PRINT_ERROR(signal, rtl, gold) \
+#define PRINT_ERROR(signal, rtl, gold) do { \
     printf("\n[ERROR] Signal %s mismatch!\n", signal); \
     printf("\tRTL: %d\n", rtl); \
-    printf("\tGold: %d\n", gold);
+    printf("\tGold: %d\n", gold); \
+} while( 0 )
+
+// Largest bounding box (in samples) the coverage cache will hold
+#define COVERAGE_MAX_SAMPLES (1 << 26)
+
+/*
+ *  Expected hits of the triangle currently in the sample test stage,
+ *  one bit per grid sample of its bounding box. All sample lanes test
+ *  the same triangle, so a single entry serves every lane.
+ */
+typedef struct {
+    int valid;
+    int v[6];           // v0.x v0.y v1.x v1.y v2.x v2.y
+    BoundingBox bbox;
+    int nx;             // grid samples per bbox row
+    int ny;             // grid sample rows
+    uchar *bits;
+    size_t capacity;    // bytes allocated in bits
+} CoverageCache;
+
+/*
+ *  Fragments on their way to the gold z-buffer. The DPI calls only
+ *  append to this single-producer/single-consumer ring; a consumer
+ *  thread applies them to zbuff in the same order, so the image is
+ *  identical to processing each fragment inside the DPI call.
+ *  RAST_ZBUFF_SYNC=1 keeps the old synchronous behaviour.
+ */
+#define FRAG_RING_SIZE (1 << 16) // power of two
+
+typedef struct {
+    Sample hit_location;
+    Sample subsample;
+    Fragment f;
+} FragmentRecord;
+
+typedef struct {
+    _Alignas(64) atomic_size_t head;  // next record to apply, written by the consumer
+    _Alignas(64) atomic_size_t tail;  // records published, written by the producer
+    _Alignas(64) size_t pending;      // producer's tail, published by frag_publish
+    atomic_int stop;
+    int running;
+    int sync;
+    pthread_t tid;
+    FragmentRecord ring[FRAG_RING_SIZE];
+} FragmentRing;
+
+/*
+ *  Sampled checking (check_sample_policy). The RTL hits of skipped
+ *  samples are kept, one bit per bbox grid sample, for the last
+ *  SAMPLED_KEEP_TRIANGLES triangles of each context, so a hit count
+ *  mismatch can still check all of them.
+ */
+#define SAMPLED_KEEP_TRIANGLES 16
+
+typedef struct {
+    int valid;
+    int v[6];
+    BoundingBox bbox;
+    int nx;              // grid samples per bbox row
+    int ny;              // grid sample rows
+    int kept;            // the bitmaps cover the bbox
+    uchar *seen;         // skipped samples
+    uchar *hits;         // their RTL hit
+    size_t capacity;     // bytes allocated in each bitmap
+    long long dropped;   // skipped samples not kept (bbox too big or missed)
+} SkippedTriangle;
+
+typedef struct {
+    long long triangles;   // distinct triangles seen, the first ones are full
+    int full;              // current triangle is checked in full
+    int cur;               // keep slot of the current triangle
+    unsigned long long key; // current triangle's part of the sample key
+    SkippedTriangle keep[SAMPLED_KEEP_TRIANGLES];
+    long long samples;     // sample checks requested
+    long long checked;     // sample checks done
+    long long triangles_full;
+} SampledState;
+
+/*
+ *  Gold state of one rasterizer instance: its z-buffer, the screen
+ *  and MSAA captured at init (the coverage cache lays out its sample
+ *  grid from them), the coverage cache and the fragment ring.
+ *  Contexts share nothing, so several instances or tests can check
+ *  in parallel. GOLD_DEFAULT_CONTEXT backs the handle-less calls.
+ */
+typedef struct {
+    ZBuff *zbuff;
+    Screen screen;
+    Config config;
+    int config_valid;
+    CoverageCache coverage;
+    SampledState sampled;
+    FragmentRing *frags;
+} GoldContext;
+
+static GoldContext *contexts[GOLD_MAX_CONTEXTS];
+static pthread_mutex_t contexts_m = PTHREAD_MUTEX_INITIALIZER;
+
+static GoldContext* gold_ctx_alloc()
+{
+    GoldContext *c = (GoldContext*) calloc(1, sizeof(GoldContext));
+    if( c != NULL )
+        c->frags = (FragmentRing*) aligned_alloc(64, sizeof(FragmentRing));
+    if( c == NULL || c->frags == NULL ){
+        printf("[ERROR] Failed to allocate gold context\n");
+        exit(1);
+    }
+    c->frags->running = 0;
+    return c;
+}
+
+// Context behind a handle; the default one is created on first use
+static GoldContext* gold_ctx(int ctx)
+{
+    if( ctx < 0 || ctx >= GOLD_MAX_CONTEXTS ){
+        printf("[ERROR] Bad gold context %d\n", ctx);
+        exit(1);
+    }
+
+    GoldContext *c = contexts[ctx];
+    if( c == NULL && ctx == GOLD_DEFAULT_CONTEXT ){
+        pthread_mutex_lock(&contexts_m);
+        if( contexts[ctx] == NULL )
+            contexts[ctx] = gold_ctx_alloc();
+        c = contexts[ctx];
+        pthread_mutex_unlock(&contexts_m);
+    }
+    if( c == NULL ){
+        printf("[ERROR] Gold context %d is not open\n", ctx);
+        exit(1);
+    }
+    return c;
+}
+
+/*
+ *  DPI call recording for dpi_replay, see dpi_trace.h. Set
+ *  RAST_DPI_RECORD=<file> and every public check below appends its
+ *  arguments and result; calls from parallel contexts are serialized.
+ */
+static FILE *dpi_trace;
+static pthread_once_t dpi_trace_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t dpi_trace_m = PTHREAD_MUTEX_INITIALIZER;
+
+static void dpi_trace_close()
+{
+    if( dpi_trace != NULL )
+        fclose(dpi_trace);
+    dpi_trace = NULL;
+}
+
+static void dpi_trace_open()
+{
+    const char* file = getenv("RAST_DPI_RECORD");
+    if( file == NULL || *file == 0 )
+        return;
+
+    dpi_trace = fopen(file, "wb");
+    if( dpi_trace == NULL ){
+        printf("[ERROR] Failed to open DPI trace %s\n", file);
+        return;
+    }
+    setvbuf(dpi_trace, NULL, _IOFBF, 1 << 20);
+    DpiTraceHeader h = { DPI_TRACE_MAGIC, DPI_TRACE_VERSION };
+    fwrite(&h, sizeof(h), 1, dpi_trace);
+    atexit(dpi_trace_close);
+}
+
+static int dpi_recording()
+{
+    pthread_once(&dpi_trace_once, dpi_trace_open);
+    return dpi_trace != NULL;
+}
+
+static void dpi_record(int op, int result, const int* args, int nargs)
+{
+    uint32_t word = DPI_TRACE_WORD(op, nargs);
+    pthread_mutex_lock(&dpi_trace_m);
+    fwrite(&word, sizeof(word), 1, dpi_trace);
+    fwrite(&result, sizeof(result), 1, dpi_trace);
+    fwrite(args, sizeof(int), nargs, dpi_trace);
+    pthread_mutex_unlock(&dpi_trace_m);
+}
+
+/*
+ *  Sampled check policy. Off by default: every sample is checked.
+ *  When on, each context checks every sample of its first
+ *  full_triangles triangles, then a seeded pseudo-random rate of the
+ *  samples of the others. Hit counts stay exact; a mismatch re-checks
+ *  the skipped samples of that triangle. Like the rest of a context,
+ *  the sampled state is only touched from the simulation thread.
+ */
+typedef struct {
+    int enabled;
+    long long full_triangles;
+    unsigned rate;          // per 65536 samples
+    unsigned long long seed;
+    // totals of closed contexts and of the hit count re-checks
+    long long samples;
+    long long checked;
+    long long triangles;
+    long long triangles_full;
+    long long recheck_triangles;
+    long long rechecked;
+    long long recheck_errors;
+    long long not_kept;     // samples a re-check could no longer see
+} SampledPolicy;
+
+static SampledPolicy sampled;
+
+// splitmix64 finalizer, every key bit reaches the top 16
+static unsigned sampled_hash(unsigned long long h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return (unsigned)(h >> 48);
+}
+
+// FNV-1a over the vertices, so triangles sharing a sample pick apart
+static unsigned long long sampled_triangle_key(const int* v)
+{
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    for( int k = 0 ; k < 6 ; k++ ){
+        h ^= (unsigned)v[k];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Start keeping the skipped samples of a new triangle
+static void sampled_keep_start(GoldContext* c, SkippedTriangle* t, const int* v)
+{
+    t->valid = 1;
+    memcpy(t->v, v, sizeof(t->v));
+    t->kept = 0;
+    t->dropped = 0;
+    if( !c->config_valid )
+        return;
+
+    Triangle triangle;
+    for( int k = 0 ; k < 3 ; k++ ){
+        triangle.v[k].x = v[2*k];
+        triangle.v[k].y = v[2*k + 1];
+    }
+    t->bbox = get_bounding_box(triangle, c->screen, c->config);
+    if( t->bbox.lower_left.x > t->bbox.upper_right.x || t->bbox.lower_left.y > t->bbox.upper_right.y )
+        return;
+
+    int ss_i = 1024 / c->config.ss_w;
+    t->nx = (t->bbox.upper_right.x - t->bbox.lower_left.x) / ss_i + 1;
+    t->ny = (t->bbox.upper_right.y - t->bbox.lower_left.y) / ss_i + 1;
+    if( (size_t)t->nx * t->ny > COVERAGE_MAX_SAMPLES )
+        return;
+
+    size_t bytes = ((size_t)t->nx * t->ny + 7) / 8;
+    if( bytes > t->capacity ){
+        free(t->seen);
+        free(t->hits);
+        t->seen = (uchar*) malloc(bytes);
+        t->hits = (uchar*) malloc(bytes);
+        t->capacity = bytes;
+        if( t->seen == NULL || t->hits == NULL ){
+            printf("[ERROR] Failed to allocate sampled check buffer\n");
+            exit(1);
+        }
+    }
+    memset(t->seen, 0, bytes);
+    memset(t->hits, 0, bytes);
+    t->kept = 1;
+}
+
+static void sampled_keep(GoldContext* c, SkippedTriangle* t, int s_x, int s_y, int hit)
+{
+    // round the jittered sample down to its grid sample, as coverage_lookup
+    int shift = c->config.r_shift - c->config.ss_w_lg2;
+    int gx = ((s_x >> shift) << shift) - t->bbox.lower_left.x;
+    int gy = ((s_y >> shift) << shift) - t->bbox.lower_left.y;
+    int i = gx >> shift;
+    int j = gy >> shift;
+    if( !t->kept || gx < 0 || gy < 0 || i >= t->nx || j >= t->ny ){
+        t->dropped++;
+        return;
+    }
+
+    size_t id = (size_t)j * t->nx + i;
+    t->seen[id >> 3] |= 1 << (id & 7);
+    if( hit )
+        t->hits[id >> 3] |= 1 << (id & 7);
+}
+
+/*
+ *  Whether this sample is checked. Sets *full when its triangle is
+ *  checked in full; skipped samples are kept for a later re-check.
+ */
+static int sampled_select(GoldContext* c, const int* v, int s_x, int s_y, int hit, int* full)
+{
+    SampledState* st = &c->sampled;
+    SkippedTriangle* t = &st->keep[st->cur];
+
+    if( st->triangles == 0 || memcmp(t->v, v, sizeof(t->v)) ){
+        st->cur = (int)(st->triangles % SAMPLED_KEEP_TRIANGLES);
+        t = &st->keep[st->cur];
+        st->full = st->triangles < sampled.full_triangles;
+        st->key = sampled_triangle_key(v) ^ sampled.seed;
+        st->triangles_full += st->full;
+        st->triangles++;
+        if( st->full ){
+            // nothing skipped, a re-check has nothing to do
+            t->valid = 1;
+            memcpy(t->v, v, sizeof(t->v));
+            t->kept = 0;
+            t->dropped = 0;
+        } else {
+            sampled_keep_start(c, t, v);
+        }
+    }
+
+    st->samples++;
+    *full = st->full;
+    if( !st->full ){
+        unsigned long long key = ((unsigned long long)(unsigned)s_x << 32) | (unsigned)s_y;
+        if( sampled_hash(key ^ st->key) >= sampled.rate ){
+            sampled_keep(c, t, s_x, s_y, hit);
+            return false;
+        }
+    }
+
+    st->checked++;
+    return true;
+}
+
+static Triangle sampled_triangle(const int* v)
+{
+    Triangle triangle;
+    for( int k = 0 ; k < 3 ; k++ ){
+        triangle.v[k].x = v[2*k];
+        triangle.v[k].y = v[2*k + 1];
+    }
+    return triangle;
+}
+
+/*
+ *  Check the kept skipped samples of t against the gold model, adding
+ *  the samples checked to *rechecked. Returns the number of wrong hits,
+ *  each one printed if report is set.
+ */
+static int sampled_recheck_kept(const SkippedTriangle* t, Config config, int report,
+                                long long* rechecked)
+{
+    if( !t->kept )
+        return 0;
+
+    Triangle triangle = sampled_triangle(t->v);
+    int ss_i = 1024 / config.ss_w;
+    int errors = 0;
+    Sample sample;
+    size_t id = 0;
+    for( int y = 0 ; y < t->ny ; y++ ){
+        sample.y = t->bbox.lower_left.y + y * ss_i;
+        for( int x = 0 ; x < t->nx ; x++, id++ ){
+            if( !((t->seen[id >> 3] >> (id & 7)) & 1) )
+                continue;
+            sample.x = t->bbox.lower_left.x + x * ss_i;
+
+            Sample jitter = jitter_sample(sample, config.ss_w_lg2);
+            Sample jittered_sample;
+            jittered_sample.x = sample.x + (jitter.x << 2);
+            jittered_sample.y = sample.y + (jitter.y << 2);
+
+            int hit = (t->hits[id >> 3] >> (id & 7)) & 1;
+            int gold_hit = sample_test(triangle, jittered_sample);
+            if( hit != gold_hit ){
+                if( report )
+                    PRINT_ERROR("sample_hit", hit, gold_hit);
+                errors++;
+            }
+            (*rechecked)++;
+        }
+    }
+    return errors;
+}
+
+/*
+ *  A hit count mismatch on triangle v: check the samples every
+ *  context skipped for it. Returns the number of wrong hits.
+ */
+static int sampled_recheck(const int* v)
+{
+    int errors = 0;
+    int found = 0;
+    sampled.recheck_triangles++;
+
+    pthread_mutex_lock(&contexts_m);
+    for( int i = 0 ; i < GOLD_MAX_CONTEXTS ; i++ ){
+        GoldContext* c = contexts[i];
+        if( c == NULL )
+            continue;
+        for( int k = 0 ; k < SAMPLED_KEEP_TRIANGLES ; k++ ){
+            SkippedTriangle* t = &c->sampled.keep[k];
+            if( !t->valid || memcmp(t->v, v, sizeof(t->v)) )
+                continue;
+
+            found = 1;
+            sampled.not_kept += t->dropped;
+            t->dropped = 0;
+            errors += sampled_recheck_kept(t, c->config, true, &sampled.rechecked);
+            if( t->kept )
+                memset(t->seen, 0, ((size_t)t->nx * t->ny + 7) / 8);
+        }
+    }
+    pthread_mutex_unlock(&contexts_m);
+
+    if( !found ){
+        printf("[ERROR] Sampled check: skipped samples of triangle (%d, %d) (%d, %d) (%d, %d) are no longer kept\n",
+               v[0], v[1], v[2], v[3], v[4], v[5]);
+        sampled.not_kept++;
+    }
+    sampled.recheck_errors += errors;
+    return errors;
+}
+
+/*
+ *  The kept skipped samples of triangle v as a deferred hit count
+ *  check queues them: copies with their own bitmaps, so a worker can
+ *  re-check them after the keep slots have moved on. *n is -1 if no
+ *  context keeps the triangle any more.
+ */
+typedef struct {
+    SkippedTriangle t;
+    Config config;
+} SkippedCopy;
+
+static SkippedCopy* sampled_snapshot(const int* v, int* n)
+{
+    SkippedCopy* copies = NULL;
+    *n = -1;
+
+    pthread_mutex_lock(&contexts_m);
+    for( int i = 0 ; i < GOLD_MAX_CONTEXTS ; i++ ){
+        GoldContext* c = contexts[i];
+        if( c == NULL )
+            continue;
+        for( int k = 0 ; k < SAMPLED_KEEP_TRIANGLES ; k++ ){
+            const SkippedTriangle* t = &c->sampled.keep[k];
+            if( !t->valid || memcmp(t->v, v, sizeof(t->v)) )
+                continue;
+
+            *n = *n < 0 ? 1 : *n + 1;
+            copies = (SkippedCopy*) realloc(copies, *n * sizeof(SkippedCopy));
+            SkippedCopy* copy = &copies[*n - 1];
+            copy->t = *t;
+            copy->config = c->config;
+            copy->t.seen = NULL;
+            copy->t.hits = NULL;
+            if( t->kept ){
+                size_t bytes = ((size_t)t->nx * t->ny + 7) / 8;
+                copy->t.seen = (uchar*) malloc(bytes);
+                copy->t.hits = (uchar*) malloc(bytes);
+                if( copy->t.seen == NULL || copy->t.hits == NULL ){
+                    printf("[ERROR] Failed to allocate sampled check buffer\n");
+                    exit(1);
+                }
+                memcpy(copy->t.seen, t->seen, bytes);
+                memcpy(copy->t.hits, t->hits, bytes);
+            }
+        }
+    }
+    pthread_mutex_unlock(&contexts_m);
+    return copies;
+}
+
+static void sampled_snapshot_free(SkippedCopy* copies, int n)
+{
+    for( int i = 0 ; i < n ; i++ ){
+        free(copies[i].t.seen);
+        free(copies[i].t.hits);
+    }
+    free(copies);
+}
+
+static void sampled_release(GoldContext* c)
+{
+    SampledState* st = &c->sampled;
+    sampled.samples += st->samples;
+    sampled.checked += st->checked;
+    sampled.triangles += st->triangles;
+    sampled.triangles_full += st->triangles_full;
+    for( int k = 0 ; k < SAMPLED_KEEP_TRIANGLES ; k++ ){
+        free(st->keep[k].seen);
+        free(st->keep[k].hits);
+    }
+}
+
+/*
+ *  Turn sampled checking on: every sample of the first full_triangles
+ *  triangles of each context, rate_per_mille of the others chosen by
+ *  seed. A rate of 1000 or more checks everything.
+ */
+int check_sample_policy(
+    int full_triangles,  //triangles checked in full
+    int rate_per_mille,  //share of the other samples that is checked
+    int seed             //sample choice
+){
+    sampled.enabled = rate_per_mille < 1000;
+    sampled.full_triangles = full_triangles;
+    sampled.rate = rate_per_mille <= 0 ? 0 : (unsigned)(rate_per_mille * 65536LL / 1000);
+    sampled.seed = (unsigned long long)(unsigned)seed * 0xbf58476d1ce4e5b9ULL;
+    return 1;
+}
+
+/*
+ *  Coverage of the run so far, and the chance that a triangle with
+ *  k wrong samples slips past the sampled sample test (its hit count
+ *  still has to match). Returns the wrong hits found by re-checks.
+ */
+int check_sample_policy_report()
+{
+    if( !sampled.enabled )
+        return 0;
+
+    SampledPolicy total = sampled;
+    pthread_mutex_lock(&contexts_m);
+    for( int i = 0 ; i < GOLD_MAX_CONTEXTS ; i++ ){
+        if( contexts[i] == NULL )
+            continue;
+        total.samples += contexts[i]->sampled.samples;
+        total.checked += contexts[i]->sampled.checked;
+        total.triangles += contexts[i]->sampled.triangles;
+        total.triangles_full += contexts[i]->sampled.triangles_full;
+    }
+    pthread_mutex_unlock(&contexts_m);
+
+    double rate = total.rate / 65536.0;
+    printf("Sampled check: %lld triangles checked in full, %lld at %.1f%% of their samples\n",
+           total.triangles_full, total.triangles - total.triangles_full, 100.0 * rate);
+    printf("  samples: %lld seen, %lld checked (%.1f%%)\n", total.samples, total.checked,
+           total.samples ? 100.0 * total.checked / total.samples : 100.0);
+    printf("  hit count mismatches: %lld triangles, %lld skipped samples re-checked, %lld wrong, %lld not kept\n",
+           total.recheck_triangles, total.rechecked, total.recheck_errors, total.not_kept);
+    printf("  a sampled triangle with k wrong samples passes the sample test check with p = %.3f^k:",
+           1.0 - rate);
+    int ks[] = { 1, 10, 50 };
+    for( int i = 0 ; i < 3 ; i++ ){
+        double p = 1.0;
+        for( int k = 0 ; k < ks[i] ; k++ )
+            p *= 1.0 - rate;
+        printf(" k=%d %.2g%%", ks[i], 100.0 * p);
+    }
+    printf("\n");
+
+    return (int)total.recheck_errors;
+}
 
 int check_bounding_box(
     int   v0_x,     //triangle
@@ -72,13 +634,102 @@ int check_bounding_box(
         }
     }
 
+    if( dpi_recording() ){
+        int args[] = { v0_x, v0_y, v1_x, v1_y, v2_x, v2_y, valid_triangle, ll_x, ll_y,
+                       ur_x, ur_y, ss_w_lg2, screen_w, screen_h, valid_bbox, r_shift, r_val };
+        dpi_record(DPI_OP_BBOX, 1, args, 17);
+    }
+
     // printf("done\n");
     // return isCorrect;
     // return true;
     return 1;
 }
 
-int check_sample_test(
+/*
+ *  Rebuild the coverage bitmap for a new triangle: walk its bounding
+ *  box exactly like rasterize_triangle and record which jittered
+ *  samples hit. The bits come from sample_test, the same function
+ *  the miss path falls back to, so a lookup that agrees with the
+ *  RTL is a check against the reference. Returns false if the
+ *  triangle is not cacheable.
+ */
+static int coverage_build(GoldContext* c, Triangle triangle, const int v[6])
+{
+    CoverageCache* cache = &c->coverage;
+    cache->valid = 0;
+    if( !c->config_valid )
+        return false;
+
+    BoundingBox bbox = get_bounding_box(triangle, c->screen, c->config);
+    if( bbox.lower_left.x > bbox.upper_right.x || bbox.lower_left.y > bbox.upper_right.y )
+        return false;
+
+    int ss_i = 1024 / c->config.ss_w;
+    int nx = (bbox.upper_right.x - bbox.lower_left.x) / ss_i + 1;
+    int ny = (bbox.upper_right.y - bbox.lower_left.y) / ss_i + 1;
+    if( (size_t)nx * ny > COVERAGE_MAX_SAMPLES )
+        return false;
+
+    size_t bytes = ((size_t)nx * ny + 7) / 8;
+    if( bytes > cache->capacity ){
+        free(cache->bits);
+        cache->bits = (uchar*) malloc(bytes);
+        cache->capacity = bytes;
+    }
+    memset(cache->bits, 0, bytes);
+
+    Sample sample;
+    size_t id = 0;
+    for( int j = 0 ; j < ny ; j++ ){
+        sample.y = bbox.lower_left.y + j * ss_i;
+        for( int i = 0 ; i < nx ; i++, id++ ){
+            sample.x = bbox.lower_left.x + i * ss_i;
+
+            Sample jitter = jitter_sample(sample, c->config.ss_w_lg2);
+            Sample jittered_sample;
+            jittered_sample.x = sample.x + (jitter.x << 2);
+            jittered_sample.y = sample.y + (jitter.y << 2);
+
+            if( sample_test(triangle, jittered_sample) )
+                cache->bits[id >> 3] |= 1 << (id & 7);
+        }
+    }
+
+    memcpy(cache->v, v, sizeof(cache->v));
+    cache->bbox = bbox;
+    cache->nx = nx;
+    cache->ny = ny;
+    cache->valid = 1;
+    return true;
+}
+
+/*
+ *  Look up the expected hit for a jittered sample. The jitter is
+ *  smaller than the grid spacing, so rounding down to the grid finds
+ *  the sample it came from. Returns -1 when the cache can't answer.
+ *  (Whether the jitter itself is right is check_hash's job.)
+ */
+static int coverage_lookup(GoldContext* c, Sample s)
+{
+    const CoverageCache* cache = &c->coverage;
+    int shift = c->config.r_shift - c->config.ss_w_lg2;
+    int gx = ((s.x >> shift) << shift) - cache->bbox.lower_left.x;
+    int gy = ((s.y >> shift) << shift) - cache->bbox.lower_left.y;
+    if( gx < 0 || gy < 0 )
+        return -1;
+
+    int i = gx >> shift;
+    int j = gy >> shift;
+    if( i >= cache->nx || j >= cache->ny )
+        return -1;
+
+    size_t id = (size_t)j * cache->nx + i;
+    return (cache->bits[id >> 3] >> (id & 7)) & 1;
+}
+
+static int sample_test_ctx(
+    GoldContext* c,
     int   v0_x,      //triangle
     int   v0_y,      //triangle
     int   v1_x,      //triangle
@@ -100,7 +751,24 @@ int check_sample_test(
     Sample sample;
     sample.x = s_x;
     sample.y = s_y;
-    
+
+    int v[6] = { v0_x, v0_y, v1_x, v1_y, v2_x, v2_y };
+
+    // Sampled mode: skipped samples pass, sampled triangles skip the cache
+    int full = true;
+    if( sampled.enabled && !sampled_select(c, v, s_x, s_y, hit, &full) )
+        return true;
+
+    if( full ){
+        // New triangle: compute its whole hit set once
+        if( !c->coverage.valid || memcmp(c->coverage.v, v, sizeof(v)) )
+            coverage_build(c, triangle, v);
+
+        // Fast path: agrees with the cached expectation
+        if( c->coverage.valid && coverage_lookup(c, sample) == hit )
+            return true;
+    }
+
     int gold_hit = sample_test(triangle, sample);
     
     if(hit != gold_hit){
@@ -111,6 +779,58 @@ int check_sample_test(
     return true;
 }
 
+int check_sample_test(
+    int   v0_x,      //triangle
+    int   v0_y,      //triangle
+    int   v1_x,      //triangle
+    int   v1_y,      //triangle
+    int   v2_x,      //triangle
+    int   v2_y,      //triangle
+    int   s_x,       //SAMPLE 
+    int   s_y,       //SAMPLE
+    int   hit        //HIT
+){
+    return check_sample_test_ctx(GOLD_DEFAULT_CONTEXT,
+                                 v0_x, v0_y, v1_x, v1_y, v2_x, v2_y, s_x, s_y, hit);
+}
+
+int check_sample_test_ctx(
+    int   ctx,       //gold context
+    int   v0_x,      //triangle
+    int   v0_y,      //triangle
+    int   v1_x,      //triangle
+    int   v1_y,      //triangle
+    int   v2_x,      //triangle
+    int   v2_y,      //triangle
+    int   s_x,       //SAMPLE 
+    int   s_y,       //SAMPLE
+    int   hit        //HIT
+){
+    int ok = sample_test_ctx(gold_ctx(ctx),
+                             v0_x, v0_y, v1_x, v1_y, v2_x, v2_y, s_x, s_y, hit);
+
+    if( dpi_recording() ){
+        int args[] = { ctx, v0_x, v0_y, v1_x, v1_y, v2_x, v2_y, s_x, s_y, hit };
+        dpi_record(DPI_OP_SAMPLE_TEST, ok, args, 10);
+    }
+    return ok;
+}
+
+/*
+ *  Config for a gold re-rasterization from the DPI arguments alone.
+ *  rasterize_triangle steps by ss_i, so it has to be filled in too.
+ */
+static Config hit_count_config(int r_shift, int ss_w_lg2)
+{
+    Config config;
+    config.r_shift = r_shift;
+    config.ss_w_lg2 = ss_w_lg2;
+    config.ss_w = 1 << ss_w_lg2;
+    config.ss = config.ss_w * config.ss_w;
+    config.ss_i = (1 << r_shift) >> ss_w_lg2;
+    return config;
+}
+
 int check_hit_count(
     int   v0_x,      //triangle
     int   v0_y,      //triangle
@@ -137,21 +857,281 @@ int check_hit_count(
     screen.width = screen_w;
     screen.height = screen_h;
 
-    Config config;
-    config.r_shift = r_shift;
-    config.ss_w_lg2 = ss_w_lg2;
+    Config config = hit_count_config(r_shift, ss_w_lg2);
 
     int gold_hits = rasterize_triangle(triangle, NULL, screen, config);
 
+    int ok = true;
     if(hits != gold_hits){
         PRINT_ERROR("hits", hits, gold_hits);
-        return false;
+        ok = false;
+
+        if( sampled.enabled ){
+            int v[6] = { v0_x, v0_y, v1_x, v1_y, v2_x, v2_y };
+            sampled_recheck(v);
+        }
     }
-    
+
+    if( dpi_recording() ){
+        int args[] = { v0_x, v0_y, v1_x, v1_y, v2_x, v2_y, hits, ss_w_lg2,
+                       screen_w, screen_h, r_shift, r_val };
+        dpi_record(DPI_OP_HIT_COUNT, ok, args, 12);
+    }
+    return ok;
+}
+
+/*
+ *  Deferred hit count checking. check_hit_count_deferred only queues
+ *  the triangle and the RTL count; worker threads re-rasterize it in
+ *  the gold model while the simulation keeps running. Mismatches are
+ *  collected and printed, in submission order, by check_hit_count_sync.
+ *  In sampled mode each job carries a copy of its triangle's skipped
+ *  samples, which the worker re-checks as soon as it finds a mismatch.
+ */
+#define HITCNT_QUEUE_DEPTH 1024
+#define HITCNT_MAX_WORKERS 16
+
+typedef struct {
+    long long seq;       // submission order
+    long long sim_time;  // simulation time of the check
+    Triangle triangle;
+    Screen screen;
+    Config config;
+    int hits;            // RTL
+    int gold_hits;
+    // sampled mode: the skipped samples kept at submission, re-checked
+    // by the worker on a mismatch (n_skipped -1: no longer kept)
+    SkippedCopy *skipped;
+    int n_skipped;
+    int recheck_errors;
+    long long rechecked;
+    long long not_kept;
+} HitCountJob;
+
+typedef struct {
+    pthread_mutex_t m;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_cond_t idle;
+    HitCountJob ring[HITCNT_QUEUE_DEPTH];
+    size_t head;         // next job to hand out
+    size_t count;        // jobs waiting in ring
+    int busy;            // jobs being checked
+    int stop;
+    int workers;
+    pthread_t tid[HITCNT_MAX_WORKERS];
+    HitCountJob *errors;
+    size_t n_errors;
+    size_t cap_errors;
+    long long submitted;
+    long long checked;
+} HitCountPool;
+
+static HitCountPool hitcnt = {
+    .m = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty = PTHREAD_COND_INITIALIZER,
+    .not_full = PTHREAD_COND_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+};
+
+static void* hit_count_worker(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&hitcnt.m);
+    for(;;){
+        while( hitcnt.count == 0 && !hitcnt.stop )
+            pthread_cond_wait(&hitcnt.not_empty, &hitcnt.m);
+        if( hitcnt.count == 0 )
+            break;
+
+        HitCountJob job = hitcnt.ring[hitcnt.head];
+        hitcnt.head = (hitcnt.head + 1) % HITCNT_QUEUE_DEPTH;
+        hitcnt.count--;
+        hitcnt.busy++;
+        pthread_cond_signal(&hitcnt.not_full);
+        pthread_mutex_unlock(&hitcnt.m);
+
+        job.gold_hits = rasterize_triangle(job.triangle, NULL, job.screen, job.config);
+        if( job.hits != job.gold_hits ){
+            for( int i = 0 ; i < job.n_skipped ; i++ ){
+                job.not_kept += job.skipped[i].t.dropped;
+                job.recheck_errors += sampled_recheck_kept(&job.skipped[i].t, job.skipped[i].config,
+                                                           false, &job.rechecked);
+            }
+        }
+        sampled_snapshot_free(job.skipped, job.n_skipped);
+        job.skipped = NULL;
+
+        pthread_mutex_lock(&hitcnt.m);
+        if( job.hits != job.gold_hits ){
+            if( hitcnt.n_errors == hitcnt.cap_errors ){
+                hitcnt.cap_errors = hitcnt.cap_errors ? 2 * hitcnt.cap_errors : 64;
+                hitcnt.errors = (HitCountJob*)realloc(hitcnt.errors,
+                                                      hitcnt.cap_errors * sizeof(HitCountJob));
+            }
+            hitcnt.errors[hitcnt.n_errors++] = job;
+        }
+        hitcnt.busy--;
+        hitcnt.checked++;
+        if( hitcnt.count == 0 && hitcnt.busy == 0 )
+            pthread_cond_broadcast(&hitcnt.idle);
+    }
+    pthread_mutex_unlock(&hitcnt.m);
+    return NULL;
+}
+
+// Workers: RAST_HITCNT_WORKERS if set, otherwise one per spare core
+static void hit_count_start()
+{
+    const char* env = getenv("RAST_HITCNT_WORKERS");
+    int n = env ? atoi(env) : (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    n = n < 1 ? 1 : n > HITCNT_MAX_WORKERS ? HITCNT_MAX_WORKERS : n;
+
+    hitcnt.stop = 0;
+    for( hitcnt.workers = 0 ; hitcnt.workers < n ; hitcnt.workers++ ){
+        if( pthread_create(&hitcnt.tid[hitcnt.workers], NULL, hit_count_worker, NULL) )
+            break;
+    }
+    if( hitcnt.workers == 0 ){
+        printf("[ERROR] Failed to start hit count workers\n");
+        exit(1);
+    }
+}
+
+static int hit_count_cmp(const void* a, const void* b)
+{
+    long long sa = ((const HitCountJob*)a)->seq;
+    long long sb = ((const HitCountJob*)b)->seq;
+    return sa < sb ? -1 : sa > sb;
+}
+
+/*
+ *  Queue a hit count check and return immediately. Blocks only when
+ *  HITCNT_QUEUE_DEPTH checks are already waiting for a worker.
+ */
+int check_hit_count_deferred(
+    int   v0_x,      //triangle
+    int   v0_y,      //triangle
+    int   v1_x,      //triangle
+    int   v1_y,      //triangle
+    int   v2_x,      //triangle
+    int   v2_y,      //triangle
+    int   hits,      //Number of Samples in triangle
+    int   ss_w_lg2,  //Subsample
+    int   screen_w,  //Screen
+    int   screen_h,  //Screen
+    int   r_shift,   //Config
+    int   r_val,     //Config
+    long long sim_time //$time of the check, for the report
+){
+    HitCountJob job;
+    memset(&job, 0, sizeof(job));
+    job.triangle.v[0].x = v0_x;
+    job.triangle.v[0].y = v0_y;
+    job.triangle.v[1].x = v1_x;
+    job.triangle.v[1].y = v1_y;
+    job.triangle.v[2].x = v2_x;
+    job.triangle.v[2].y = v2_y;
+    job.screen.width = screen_w;
+    job.screen.height = screen_h;
+    job.config = hit_count_config(r_shift, ss_w_lg2);
+    job.hits = hits;
+    job.sim_time = sim_time;
+    if( sampled.enabled ){
+        // the keep slots roll over before the verdict is back
+        int v[6] = { v0_x, v0_y, v1_x, v1_y, v2_x, v2_y };
+        job.skipped = sampled_snapshot(v, &job.n_skipped);
+    }
+
+    if( dpi_recording() ){
+        // replayed as a blocking check; the verdict isn't known yet
+        int args[] = { v0_x, v0_y, v1_x, v1_y, v2_x, v2_y, hits, ss_w_lg2,
+                       screen_w, screen_h, r_shift, r_val };
+        dpi_record(DPI_OP_HIT_COUNT, -1, args, 12);
+    }
+
+    pthread_mutex_lock(&hitcnt.m);
+    if( hitcnt.workers == 0 )
+        hit_count_start();
+    while( hitcnt.count == HITCNT_QUEUE_DEPTH )
+        pthread_cond_wait(&hitcnt.not_full, &hitcnt.m);
+
+    job.seq = hitcnt.submitted++;
+    hitcnt.ring[(hitcnt.head + hitcnt.count) % HITCNT_QUEUE_DEPTH] = job;
+    hitcnt.count++;
+    pthread_cond_signal(&hitcnt.not_empty);
+    pthread_mutex_unlock(&hitcnt.m);
+
     return true;
 }
 
-int check_hash(
+/*
+ *  Sync point: wait for every queued check, print the mismatches
+ *  found since the last sync and return how many there were.
+ */
+int check_hit_count_sync()
+{
+    pthread_mutex_lock(&hitcnt.m);
+    while( hitcnt.count != 0 || hitcnt.busy != 0 )
+        pthread_cond_wait(&hitcnt.idle, &hitcnt.m);
+
+    size_t n = hitcnt.n_errors;
+    qsort(hitcnt.errors, n, sizeof(HitCountJob), hit_count_cmp);
+    for( size_t i = 0 ; i < n ; i++ ){
+        HitCountJob* e = &hitcnt.errors[i];
+        PRINT_ERROR("hits", e->hits, e->gold_hits);
+        printf("\tTime: %lld  Triangle: (%d, %d) (%d, %d) (%d, %d)\n", e->sim_time,
+               e->triangle.v[0].x, e->triangle.v[0].y,
+               e->triangle.v[1].x, e->triangle.v[1].y,
+               e->triangle.v[2].x, e->triangle.v[2].y);
+
+        // the worker re-checked the skipped samples kept at submission
+        if( sampled.enabled ){
+            sampled.recheck_triangles++;
+            sampled.rechecked += e->rechecked;
+            sampled.recheck_errors += e->recheck_errors;
+            sampled.not_kept += e->not_kept;
+            if( e->n_skipped < 0 ){
+                printf("[ERROR] Sampled check: skipped samples of the triangle were no longer kept\n");
+                sampled.not_kept++;
+            } else if( e->recheck_errors != 0 ){
+                printf("[ERROR] Sampled check: %d of %lld skipped samples hit wrong\n",
+                       e->recheck_errors, e->rechecked);
+            }
+        }
+    }
+    hitcnt.n_errors = 0;
+    long long checked = hitcnt.checked;
+    pthread_mutex_unlock(&hitcnt.m);
+
+    printf("Hit count: %lld triangles checked, %zu mismatches\n", checked, n);
+    return (int)n;
+}
+
+/*
+ *  Final sync: report outstanding mismatches and stop the workers.
+ */
+int check_hit_count_finish()
+{
+    int errors = check_hit_count_sync();
+
+    pthread_mutex_lock(&hitcnt.m);
+    hitcnt.stop = 1;
+    pthread_cond_broadcast(&hitcnt.not_empty);
+    pthread_mutex_unlock(&hitcnt.m);
+
+    for( int i = 0 ; i < hitcnt.workers ; i++ )
+        pthread_join(hitcnt.tid[i], NULL);
+    hitcnt.workers = 0;
+
+    free(hitcnt.errors);
+    hitcnt.errors = NULL;
+    hitcnt.cap_errors = 0;
+
+    return errors;
+}
+
+static int hash_check(
     int s_x,
     int s_y,
     int ss_w_lg2,
@@ -195,25 +1175,394 @@ int check_hash(
     return isCorrect;
 }
 
+int check_hash(
+    int s_x,
+    int s_y,
+    int ss_w_lg2,
+    int jitter_x,
+    int jitter_y,
+    int s_j_x,
+    int s_j_y
+)
+{
+    int ok = hash_check(s_x, s_y, ss_w_lg2, jitter_x, jitter_y, s_j_x, s_j_y);
+
+    if( dpi_recording() ){
+        int args[] = { s_x, s_y, ss_w_lg2, jitter_x, jitter_y, s_j_x, s_j_y };
+        dpi_record(DPI_OP_HASH, ok, args, 7);
+    }
+    return ok;
+}
+
+/*
+ *  Fused per-cycle check of every sample lane: the hash stage
+ *  (sample, jitter, jittered sample) and the sample test stage
+ *  (jittered sample, hit) of up to FUSED_MAX_LANES lanes in one
+ *  DPI crossing. Returns a bitmap with FUSED_SAMPLE_ERR(lane) and
+ *  FUSED_HASH_ERR(lane) set for each failing check, 0 when clean.
+ */
+/*
+ *  Sample test of one lane. With a gold-ahead stream a hit that
+ *  agrees with the precomputed record passes at once; the gold
+ *  model only runs when they disagree or the stream can't answer.
+ *  The record answers as sample_test on every sample (the edge
+ *  setup agrees with it exactly, checked by rasterizer_gold
+ *  --selftest), so an agreeing hit is a check against the reference.
+ */
+static int sample_lane_ok(GoldContext* c, int stream, const int* tri, int s_x, int s_y, int hit)
+{
+    if( stream >= 0 && gold_ahead_lookup(stream, tri, s_x, s_y) == hit )
+        return true;
+
+    return sample_test_ctx(c, tri[0], tri[1], tri[2], tri[3], tri[4], tri[5], s_x, s_y, hit);
+}
+
+static int sample_lanes(
+    GoldContext* c,
+    int   stream,        //gold-ahead stream, -1 for none
+    const int* tri,      //triangle: v0.x v0.y v1.x v1.y v2.x v2.y
+    int   valid_samp,    //sample test stage holds a valid sample
+    const int* sample,   //[lane][x,y] jittered sample at the sample test
+    const int* hit,      //[lane] RTL hit
+    int   hash_valid,    //hash stage values are meaningful (not in reset)
+    const int* hash,     //[lane][s_x,s_y,jitter_x,jitter_y,s_j_x,s_j_y]
+    int   ss_w_lg2,      //Subsample
+    int   lanes          //number of lanes in use
+){
+    int errors = 0;
+
+    for( int lane = 0 ; lane < lanes && lane < FUSED_MAX_LANES ; lane++ ){
+        if( hash_valid ){
+            const int* h = &hash[lane * 6];
+            if( !hash_check(h[0], h[1], ss_w_lg2, h[2], h[3], h[4], h[5]) )
+                errors |= FUSED_HASH_ERR(lane);
+        }
+
+        if( valid_samp ){
+            if( !sample_lane_ok(c, stream, tri, sample[lane * 2], sample[lane * 2 + 1], hit[lane]) )
+                errors |= FUSED_SAMPLE_ERR(lane);
+        }
+    }
+
+    return errors;
+}
+
+static void sample_lanes_record(
+    int   ctx,
+    int   errors,
+    const int* tri,
+    int   valid_samp,
+    const int* sample,
+    const int* hit,
+    int   hash_valid,
+    const int* hash,
+    int   ss_w_lg2,
+    int   lanes
+){
+    int args[11 + 9 * FUSED_MAX_LANES];
+    int n = 0;
+    lanes = lanes < FUSED_MAX_LANES ? lanes : FUSED_MAX_LANES;
+
+    args[n++] = ctx;
+    args[n++] = lanes;
+    for( int i = 0 ; i < 6 ; i++ )
+        args[n++] = tri[i];
+    args[n++] = valid_samp;
+    for( int i = 0 ; i < 2 * lanes ; i++ )
+        args[n++] = sample[i];
+    for( int i = 0 ; i < lanes ; i++ )
+        args[n++] = hit[i];
+    args[n++] = hash_valid;
+    for( int i = 0 ; i < 6 * lanes ; i++ )
+        args[n++] = hash[i];
+    args[n++] = ss_w_lg2;
+
+    dpi_record(DPI_OP_SAMPLE_LANES, errors, args, n);
+}
+
+int check_sample_lanes_ctx(
+    int   ctx,           //gold context
+    const int* tri,      //triangle: v0.x v0.y v1.x v1.y v2.x v2.y
+    int   valid_samp,    //sample test stage holds a valid sample
+    const int* sample,   //[lane][x,y] jittered sample at the sample test
+    const int* hit,      //[lane] RTL hit
+    int   hash_valid,    //hash stage values are meaningful (not in reset)
+    const int* hash,     //[lane][s_x,s_y,jitter_x,jitter_y,s_j_x,s_j_y]
+    int   ss_w_lg2,      //Subsample
+    int   lanes          //number of lanes in use
+){
+    int errors = sample_lanes(gold_ctx(ctx), -1, tri, valid_samp, sample, hit,
+                              hash_valid, hash, ss_w_lg2, lanes);
+
+    if( dpi_recording() )
+        sample_lanes_record(ctx, errors, tri, valid_samp, sample, hit,
+                            hash_valid, hash, ss_w_lg2, lanes);
+    return errors;
+}
+
+/*
+ *  check_sample_lanes_ctx against a gold-ahead stream opened by
+ *  gold_ahead_open on the same vector the driver reads.
+ */
+int check_sample_lanes_ahead(
+    int   ctx,           //gold context
+    int   stream,        //gold-ahead stream
+    const int* tri,      //triangle: v0.x v0.y v1.x v1.y v2.x v2.y
+    int   valid_samp,    //sample test stage holds a valid sample
+    const int* sample,   //[lane][x,y] jittered sample at the sample test
+    const int* hit,      //[lane] RTL hit
+    int   hash_valid,    //hash stage values are meaningful (not in reset)
+    const int* hash,     //[lane][s_x,s_y,jitter_x,jitter_y,s_j_x,s_j_y]
+    int   ss_w_lg2,      //Subsample
+    int   lanes          //number of lanes in use
+){
+    int errors = sample_lanes(gold_ctx(ctx), stream, tri, valid_samp, sample, hit,
+                              hash_valid, hash, ss_w_lg2, lanes);
+
+    if( dpi_recording() )
+        sample_lanes_record(ctx, errors, tri, valid_samp, sample, hit,
+                            hash_valid, hash, ss_w_lg2, lanes);
+    return errors;
+}
+
+int check_sample_lanes(
+    const int* tri,      //triangle: v0.x v0.y v1.x v1.y v2.x v2.y
+    int   valid_samp,    //sample test stage holds a valid sample
+    const int* sample,   //[lane][x,y] jittered sample at the sample test
+    const int* hit,      //[lane] RTL hit
+    int   hash_valid,    //hash stage values are meaningful (not in reset)
+    const int* hash,     //[lane][s_x,s_y,jitter_x,jitter_y,s_j_x,s_j_y]
+    int   ss_w_lg2,      //Subsample
+    int   lanes          //number of lanes in use
+){
+    return check_sample_lanes_ctx(GOLD_DEFAULT_CONTEXT, tri, valid_samp, sample, hit,
+                                  hash_valid, hash, ss_w_lg2, lanes);
+}
+
+static void* frag_consumer(void* arg)
+{
+    GoldContext* c = (GoldContext*)arg;
+    FragmentRing* q = c->frags;
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    int idle = 0;
+    for(;;){
+        size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if( head == tail ){
+            if( atomic_load_explicit(&q->stop, memory_order_acquire) &&
+                head == atomic_load_explicit(&q->tail, memory_order_acquire) )
+                break;
+            // spin briefly, then back off so an idle ring costs no core
+            if( ++idle < 64 ){
+                sched_yield();
+            } else {
+                struct timespec ts = { 0, 20000 };
+                nanosleep(&ts, NULL);
+            }
+            continue;
+        }
+        idle = 0;
+
+        // apply everything published so far as one batch
+        for( ; head != tail ; head++ ){
+            FragmentRecord* r = &q->ring[head & (FRAG_RING_SIZE - 1)];
+            process_fragment(c->zbuff, r->hit_location, r->subsample, r->f);
+        }
+        atomic_store_explicit(&q->head, head, memory_order_release);
+    }
+    return NULL;
+}
+
+// Wait until the consumer has applied every published fragment
+static void frag_drain(GoldContext* c)
+{
+    FragmentRing* q = c->frags;
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    while( atomic_load_explicit(&q->head, memory_order_acquire) != tail )
+        sched_yield();
+}
+
+static void frag_stop(GoldContext* c)
+{
+    FragmentRing* q = c->frags;
+    if( !q->running )
+        return;
+    frag_drain(c);
+    atomic_store_explicit(&q->stop, 1, memory_order_release);
+    pthread_join(q->tid, NULL);
+    q->running = 0;
+}
+
+static void frag_start(GoldContext* c)
+{
+    FragmentRing* q = c->frags;
+    const char* env = getenv("RAST_ZBUFF_SYNC");
+    q->sync = env && atoi(env);
+    if( q->sync )
+        return;
+
+    atomic_store(&q->head, 0);
+    atomic_store(&q->tail, 0);
+    atomic_store(&q->stop, 0);
+    q->pending = 0;
+    if( pthread_create(&q->tid, NULL, frag_consumer, c) ){
+        q->sync = 1; // no thread, fall back to processing in place
+        return;
+    }
+    q->running = 1;
+}
+
+static void frag_push(GoldContext* c, Sample hit_location, Sample subsample, Fragment f)
+{
+    FragmentRing* q = c->frags;
+    if( !q->running ){
+        process_fragment(c->zbuff, hit_location, subsample, f);
+        return;
+    }
+
+    // full: wait for the consumer to free a slot
+    while( q->pending - atomic_load_explicit(&q->head, memory_order_acquire) == FRAG_RING_SIZE ){
+        atomic_store_explicit(&q->tail, q->pending, memory_order_release);
+        sched_yield();
+    }
+
+    FragmentRecord* r = &q->ring[q->pending & (FRAG_RING_SIZE - 1)];
+    r->hit_location = hit_location;
+    r->subsample = subsample;
+    r->f = f;
+    q->pending++;
+}
+
+// Make the fragments pushed since the last publish visible to the consumer
+static void frag_publish(GoldContext* c)
+{
+    FragmentRing* q = c->frags;
+    if( q->running )
+        atomic_store_explicit(&q->tail, q->pending, memory_order_release);
+}
+
+// Every Config field for a subsample width, with 10 fractional bits
+static Config zbuff_config(int ss_w)
+{
+    Config config;
+    config.r_shift = 10;
+    config.ss_w = ss_w;
+    config.ss = ss_w*ss_w;
+    config.ss_i = 1024 / ss_w;
+    config.ss_w_lg2 = 0;
+    while( (1 << config.ss_w_lg2) < ss_w )
+        config.ss_w_lg2++;
+    return config;
+}
+
+// Make zbuff the context's z-buffer, in place of the one it had
+static void zbuff_adopt(GoldContext* c, ZBuff* zbuff)
+{
+    frag_stop(c);
+    if( c->zbuff != NULL )
+        zbuff_free(c->zbuff);
+    c->zbuff = zbuff;
+    frag_start(c);
+
+    // remember the sample grid for the coverage cache
+    c->screen.width = zbuff->w*1024;
+    c->screen.height = zbuff->h*1024;
+    c->config = zbuff_config(zbuff->config.ss_w);
+    c->config_valid = 1;
+    c->coverage.valid = 0;
+}
+
+static void zbuff_setup(GoldContext* c, int w, int h, int ss_w)
+{
+    Screen screen;
+    screen.width = w*1024;
+    screen.height = h*1024;
+
+    // the snapshot header keeps the whole Config
+    zbuff_adopt(c, zbuff_init(screen, zbuff_config(ss_w)));
+}
+
+// File name packed 4 chars per arg, as the trace records it; returns the args used
+static int record_name(int* args, const char* file_name)
+{
+    int length = (int)strlen(file_name);
+    length = length < 4 * 64 ? length : 4 * 64;
+    args[0] = length;
+    memset(&args[1], 0, 64 * sizeof(int));
+    memcpy(&args[1], file_name, length);
+    return 1 + (length + 3) / 4;
+}
+
 int check_zbuff_init(
     int w,    //Screen Width
     int h,    //Screen Width
     int ss_w  //Subsample Width
 ){
-    Screen screen;
-    screen.width = w*1024;
-    screen.height = h*1024;
-    
-    Config config;
-    config.ss_w = ss_w;
-    config.ss = ss_w*ss_w;
+    zbuff_setup(gold_ctx(GOLD_DEFAULT_CONTEXT), w, h, ss_w);
+
+    if( dpi_recording() ){
+        int args[] = { w, h, ss_w };
+        dpi_record(DPI_OP_ZBUFF_INIT, 1, args, 3);
+    }
+    return 1;
+}
+
+/*
+ *  Open a new gold context with its own z-buffer and return its
+ *  handle for the *_ctx calls, or -1 if all contexts are in use.
+ */
+int check_zbuff_open(
+    int w,    //Screen Width
+    int h,    //Screen Width
+    int ss_w  //Subsample Width
+){
+    int ctx = -1;
+    pthread_mutex_lock(&contexts_m);
+    for( int i = 0 ; i < GOLD_MAX_CONTEXTS ; i++ ){
+        if( i != GOLD_DEFAULT_CONTEXT && contexts[i] == NULL ){
+            contexts[i] = gold_ctx_alloc();
+            ctx = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&contexts_m);
+
+    if( ctx < 0 ){
+        printf("[ERROR] All %d gold contexts are in use\n", GOLD_MAX_CONTEXTS);
+        return -1;
+    }
+
+    zbuff_setup(contexts[ctx], w, h, ss_w);
+
+    if( dpi_recording() ){
+        int args[] = { w, h, ss_w };
+        dpi_record(DPI_OP_ZBUFF_OPEN, ctx, args, 3);
+    }
+    return ctx;
+}
+
+// Release a context: stop its consumer and free its buffers
+int check_zbuff_close(int ctx)
+{
+    GoldContext* c = gold_ctx(ctx);
+    frag_stop(c);
+    if( c->zbuff != NULL )
+        zbuff_free(c->zbuff);
+    free(c->coverage.bits);
+    free(c->frags);
 
-    zbuff = zbuff_init(screen, config);
+    pthread_mutex_lock(&contexts_m);
+    sampled_release(c);
+    contexts[ctx] = NULL;
+    pthread_mutex_unlock(&contexts_m);
+    free(c);
 
+    if( dpi_recording() )
+        dpi_record(DPI_OP_ZBUFF_CLOSE, 1, &ctx, 1);
     return 1;
 }
 
-int check_zbuff_process_fragment(
+int check_zbuff_process_fragment_ctx(
+    int ctx , //gold context
     int x ,   //Hit Loc. X
     int y ,   //Hit Loc. Y
     int ss_x ,  //`$ss` Hit loc X
@@ -223,6 +1572,8 @@ int check_zbuff_process_fragment(
     int G , //actually a ushort
     int B   //actually a ushort
 ){
+    GoldContext* c = gold_ctx(ctx);
+
     Sample sample;
     sample.x = x;
     sample.y = y;
@@ -237,11 +1588,187 @@ int check_zbuff_process_fragment(
     f.G = G;
     f.B = B;
 
-    process_fragment(zbuff, sample, subsample, f);
+    frag_push(c, sample, subsample, f);
+    frag_publish(c);
+
+    if( dpi_recording() ){
+        int args[] = { ctx, x, y, ss_x, ss_y, d, R, G, B };
+        dpi_record(DPI_OP_FRAGMENT, 1, args, 9);
+    }
+    return 1;
+}
+
+int check_zbuff_process_fragment(
+    int x ,   //Hit Loc. X
+    int y ,   //Hit Loc. Y
+    int ss_x ,  //`$ss` Hit loc X
+    int ss_y ,  //`$ss` Hit Loc Y
+    int d , //actually a uint
+    int R , //actually a ushort
+    int G , //actually a ushort
+    int B   //actually a ushort
+){
+    return check_zbuff_process_fragment_ctx(GOLD_DEFAULT_CONTEXT, x, y, ss_x, ss_y, d, R, G, B);
+}
+
+int check_zbuff_write_ppm_ctx(
+    int ctx,               //gold context
+    const char* file_name  //Output image
+){
+    GoldContext* c = gold_ctx(ctx);
+    frag_stop(c);
+    write_ppm(c->zbuff, (char*)file_name );
+
+    if( dpi_recording() ){
+        int args[2 + 64];
+        args[0] = ctx;
+        dpi_record(DPI_OP_WRITE_PPM, 1, args, 1 + record_name(&args[1], file_name));
+    }
     return 1;
 }
 
 int check_zbuff_write_ppm(){
-    write_ppm(zbuff, "verif_out.ppm" );
+    return check_zbuff_write_ppm_ctx(GOLD_DEFAULT_CONTEXT, "verif_out.ppm" );
+}
+
+/*
+ *  Checkpoint a context's z-buffer to a snapshot (zbuff.h) once every
+ *  fragment handed over so far is applied. triangles is how many of
+ *  the test's valid triangles it holds, for a later run to skip, and
+ *  tag their tag (tri_feeder_mark), the same mark rasterizer_gold
+ *  --resume keeps. Returns 1, 0 if the snapshot could not be written.
+ */
+int check_zbuff_save_ctx(
+    int ctx,               //gold context
+    const char* file_name, //Snapshot
+    int triangles,         //Triangles in the z-buffer
+    long long tag,         //Their tag
+    int compress           //Run-length code it
+){
+    GoldContext* c = gold_ctx(ctx);
+    if( c->frags->running )
+        frag_drain(c);
+
+    ZBuffMark mark = { triangles, (unsigned long long)tag };
+    int result = zbuff_save(c->zbuff, file_name, mark, compress ? ZBUFF_SNAPSHOT_RLE : 0);
+
+    if( dpi_recording() ){
+        int args[6 + 64];
+        args[0] = ctx;
+        args[1] = triangles;
+        args[2] = (int)(unsigned)tag;
+        args[3] = (int)(unsigned)((unsigned long long)tag >> 32);
+        args[4] = compress;
+        dpi_record(DPI_OP_ZBUFF_SAVE, result, args, 5 + record_name(&args[5], file_name));
+    }
+    return result;
+}
+
+int check_zbuff_save(
+    const char* file_name, //Snapshot
+    int triangles,         //Triangles in the z-buffer
+    long long tag,         //Their tag
+    int compress           //Run-length code it
+){
+    return check_zbuff_save_ctx(GOLD_DEFAULT_CONTEXT, file_name, triangles, tag, compress);
+}
+
+/*
+ *  Replace a context's z-buffer with a snapshot taken for the same
+ *  screen and MSAA. Returns the triangles the snapshot holds and sets
+ *  *tag to their tag, for the caller to check against the prefix of
+ *  its vector. -1 if it can't be read or doesn't fit the context.
+ */
+int check_zbuff_restore_ctx(
+    int ctx,               //gold context
+    const char* file_name, //Snapshot
+    long long* tag         //Tag of the triangles it holds
+){
+    GoldContext* c = gold_ctx(ctx);
+    ZBuffMark mark;
+    ZBuff* zbuff = zbuff_load(file_name, &mark);
+    int result = -1;
+    *tag = 0;
+    if( zbuff != NULL && c->zbuff != NULL && (zbuff->w != c->zbuff->w || zbuff->h != c->zbuff->h ||
+                                              zbuff->config.ss_w != c->zbuff->config.ss_w) ){
+        printf("[ERROR] Snapshot %s is %dx%d at %dx MSAA, the test is %dx%d at %dx\n", file_name,
+               zbuff->w, zbuff->h, zbuff->config.ss, c->zbuff->w, c->zbuff->h, c->zbuff->config.ss);
+        zbuff_free(zbuff);
+    } else if( zbuff != NULL ){
+        zbuff_adopt(c, zbuff);
+        result = (int)mark.triangles;
+        *tag = (long long)mark.tag;
+    }
+
+    if( dpi_recording() ){
+        int args[3 + 65];
+        args[0] = ctx;
+        args[1] = (int)(unsigned)*tag;
+        args[2] = (int)(unsigned)((unsigned long long)*tag >> 32);
+        dpi_record(DPI_OP_ZBUFF_RESTORE, result, args, 3 + record_name(&args[3], file_name));
+    }
+    return result;
+}
+
+int check_zbuff_restore(
+    const char* file_name, //Snapshot
+    long long* tag         //Tag of the triangles it holds
+){
+    return check_zbuff_restore_ctx(GOLD_DEFAULT_CONTEXT, file_name, tag);
+}
+
+/*
+ *  All lanes' fragments of one cycle in a single call. Bit `lane` of
+ *  valid selects the lanes that hit; lanes are applied in order, so
+ *  the result matches calling check_zbuff_process_fragment per lane.
+ */
+int check_zbuff_process_fragments_ctx(
+    int ctx,            //gold context
+    int valid,          //hit valid, one bit per lane
+    const int* frag,    //[lane][x, y, ss_x, ss_y, d, R, G, B]
+    int lanes           //number of lanes in use
+){
+    GoldContext* c = gold_ctx(ctx);
+
+    for( int lane = 0 ; lane < lanes && lane < FUSED_MAX_LANES ; lane++ ){
+        if( (valid >> lane) & 1 ){
+            const int* r = &frag[lane * 8];
+
+            Sample sample;
+            sample.x = r[0];
+            sample.y = r[1];
+
+            Sample subsample;
+            subsample.x = r[2];
+            subsample.y = r[3];
+
+            Fragment f;
+            f.z = r[4];
+            f.R = r[5];
+            f.G = r[6];
+            f.B = r[7];
+
+            frag_push(c, sample, subsample, f);
+        }
+    }
+    frag_publish(c); // one release per cycle for all lanes
+
+    if( dpi_recording() ){
+        int args[3 + 8 * FUSED_MAX_LANES];
+        lanes = lanes < FUSED_MAX_LANES ? lanes : FUSED_MAX_LANES;
+        args[0] = ctx;
+        args[1] = valid;
+        args[2] = lanes;
+        memcpy(&args[3], frag, 8 * lanes * sizeof(int));
+        dpi_record(DPI_OP_FRAGMENTS, 1, args, 3 + 8 * lanes);
+    }
     return 1;
 }
+
+int check_zbuff_process_fragments(
+    int valid,          //hit valid, one bit per lane
+    const int* frag,    //[lane][x, y, ss_x, ss_y, d, R, G, B]
+    int lanes           //number of lanes in use
+){
+    return check_zbuff_process_fragments_ctx(GOLD_DEFAULT_CONTEXT, valid, frag, lanes);
+}
@@ -6,6 +6,14 @@
 #include "svdpi.h"
 #include "stdlib.h"
 
+/*
+ *  Gold state lives in contexts. check_zbuff_open returns a handle
+ *  that the *_ctx calls take; the handle-less calls use context
+ *  GOLD_DEFAULT_CONTEXT, set up by check_zbuff_init.
+ */
+#define GOLD_MAX_CONTEXTS 64
+#define GOLD_DEFAULT_CONTEXT 0
+
 int check_bounding_box(
     int   v0_x,     //triangle
     int   v0_y,     //triangle
@@ -38,6 +46,19 @@ int check_sample_test(
     int   hit        //HIT
 );
 
+int check_sample_test_ctx(
+    int   ctx,       //gold context
+    int   v0_x,      //triangle
+    int   v0_y,      //triangle
+    int   v1_x,      //triangle
+    int   v1_y,      //triangle
+    int   v2_x,      //triangle
+    int   v2_y,      //triangle
+    int   s_x,       //SAMPLE 
+    int   s_y,       //SAMPLE
+    int   hit        //HIT
+);
+
 int check_hit_count(
     int   v0_x,      //triangle
     int   v0_y,      //triangle
@@ -53,13 +74,108 @@ int check_hit_count(
     int   r_val      //Config
 );
 
-ZBuff *zbuff;
+// Deferred hit count: queue now, check on worker threads, report at sync
+int check_hit_count_deferred(
+    int   v0_x,      //triangle
+    int   v0_y,      //triangle
+    int   v1_x,      //triangle
+    int   v1_y,      //triangle
+    int   v2_x,      //triangle
+    int   v2_y,      //triangle
+    int   hits,      //Number of Samples in triangle
+    int   ss_w_lg2,  //Subsample
+    int   screen_w,  //Screen
+    int   screen_h,  //Screen
+    int   r_shift,   //Config
+    int   r_val,     //Config
+    long long sim_time //$time of the check
+);
+
+int check_hit_count_sync();
+
+/*
+ *  Sampled checking for long runs: each context checks every sample
+ *  of its first full_triangles triangles, then rate_per_mille of the
+ *  rest, chosen from seed. Hit counts stay exact, and a hit count
+ *  mismatch re-checks the samples skipped for that triangle. Samples
+ *  a gold-ahead stream confirms are not subject to the policy.
+ */
+int check_sample_policy(
+    int full_triangles,  //triangles checked in full
+    int rate_per_mille,  //share of the other samples that is checked
+    int seed             //sample choice
+);
+
+// Print the coverage achieved so far; returns wrong hits found by re-checks
+int check_sample_policy_report();
+
+int check_hit_count_finish();
+
+// Lanes and error bits of the fused per-cycle checkers
+#define FUSED_MAX_LANES 3
+#define FUSED_SAMPLE_ERR(lane) (1 << (lane))
+#define FUSED_HASH_ERR(lane)   (1 << (8 + (lane)))
+
+int check_hash(
+    int s_x,        //sample
+    int s_y,        //sample
+    int ss_w_lg2,   //Subsample
+    int jitter_x,   //jitter
+    int jitter_y,   //jitter
+    int s_j_x,      //jittered_sample
+    int s_j_y       //jittered_sample
+);
+
+int check_sample_lanes(
+    const int* tri,      //triangle: v0.x v0.y v1.x v1.y v2.x v2.y
+    int   valid_samp,    //sample test stage holds a valid sample
+    const int* sample,   //[lane][x,y] jittered sample at the sample test
+    const int* hit,      //[lane] RTL hit
+    int   hash_valid,    //hash stage values are meaningful (not in reset)
+    const int* hash,     //[lane][s_x,s_y,jitter_x,jitter_y,s_j_x,s_j_y]
+    int   ss_w_lg2,      //Subsample
+    int   lanes          //number of lanes in use
+);
+
+int check_sample_lanes_ctx(
+    int   ctx,           //gold context
+    const int* tri,      //triangle: v0.x v0.y v1.x v1.y v2.x v2.y
+    int   valid_samp,    //sample test stage holds a valid sample
+    const int* sample,   //[lane][x,y] jittered sample at the sample test
+    const int* hit,      //[lane] RTL hit
+    int   hash_valid,    //hash stage values are meaningful (not in reset)
+    const int* hash,     //[lane][s_x,s_y,jitter_x,jitter_y,s_j_x,s_j_y]
+    int   ss_w_lg2,      //Subsample
+    int   lanes          //number of lanes in use
+);
+
+int check_sample_lanes_ahead(
+    int   ctx,           //gold context
+    int   stream,        //gold-ahead stream (gold_ahead.h)
+    const int* tri,      //triangle: v0.x v0.y v1.x v1.y v2.x v2.y
+    int   valid_samp,    //sample test stage holds a valid sample
+    const int* sample,   //[lane][x,y] jittered sample at the sample test
+    const int* hit,      //[lane] RTL hit
+    int   hash_valid,    //hash stage values are meaningful (not in reset)
+    const int* hash,     //[lane][s_x,s_y,jitter_x,jitter_y,s_j_x,s_j_y]
+    int   ss_w_lg2,      //Subsample
+    int   lanes          //number of lanes in use
+);
+
 int check_zbuff_init(
     int w,    //Screen Width
     int h,    //Screen Width
     int ss_w  //Subsample Width
 );
 
+int check_zbuff_open(
+    int w,    //Screen Width
+    int h,    //Screen Width
+    int ss_w  //Subsample Width
+);
+
+int check_zbuff_close(int ctx);
+
 int check_zbuff_process_fragment(
     int x ,   //Hit Loc. X
     int y ,   //Hit Loc. Y
@@ -71,6 +187,62 @@ int check_zbuff_process_fragment(
     int B   //actually a ushort
 );
 
+int check_zbuff_process_fragment_ctx(
+    int ctx , //gold context
+    int x ,   //Hit Loc. X
+    int y ,   //Hit Loc. Y
+    int ss_x ,  //`$ss` Hit loc X
+    int ss_y ,  //`$ss` Hit Loc Y
+    int d , //actually a uint
+    int R , //actually a ushort
+    int G , //actually a ushort
+    int B   //actually a ushort
+);
+
+int check_zbuff_process_fragments(
+    int valid,          //hit valid, one bit per lane
+    const int* frag,    //[lane][x, y, ss_x, ss_y, d, R, G, B]
+    int lanes           //number of lanes in use
+);
+
+int check_zbuff_process_fragments_ctx(
+    int ctx,            //gold context
+    int valid,          //hit valid, one bit per lane
+    const int* frag,    //[lane][x, y, ss_x, ss_y, d, R, G, B]
+    int lanes           //number of lanes in use
+);
+
 int check_zbuff_write_ppm();
 
+int check_zbuff_write_ppm_ctx(
+    int ctx,               //gold context
+    const char* file_name  //Output image
+);
+
+int check_zbuff_save(
+    const char* file_name, //Snapshot
+    int triangles,         //Triangles in the z-buffer
+    long long tag,         //Their tag
+    int compress           //Run-length code it
+);
+
+int check_zbuff_save_ctx(
+    int ctx,               //gold context
+    const char* file_name, //Snapshot
+    int triangles,         //Triangles in the z-buffer
+    long long tag,         //Their tag
+    int compress           //Run-length code it
+);
+
+int check_zbuff_restore(
+    const char* file_name, //Snapshot
+    long long* tag         //Tag of the triangles it holds
+);
+
+int check_zbuff_restore_ctx(
+    int ctx,               //gold context
+    const char* file_name, //Snapshot
+    long long* tag         //Tag of the triangles it holds
+);
+
 #endif
@@ -0,0 +1,620 @@
+#include "helper.h"
+#include "pipeline.h"
+#include "trace_reader.h"
+extern "C"{
+#include "rasterizer.h"
+#include "rast_fixed.h"
+#include "rast_types.h"
+}
+
+#include <stdint.h>
+#include <chrono>
+#include <thread>
+
+/*
+
+   RTL Trace Check
+     Checks a rast.sv signal trace (GENERATE_JSON, see rtl_trace.h)
+     stage by stage against the gold model, without the simulator,
+     and reports the first cycle at which each stage diverges.
+
+     Each stage is checked from its own inputs and outputs, so one
+     wrong stage does not hide or fake errors in the next:
+
+       - bbox: the inputs go down a PIPES_BOX deep delay line that
+         shifts while halt_RnnnnL is high, like bbx_sb; a valid
+         triangle leaving it must come out with get_bounding_box's
+         box and valid bit
+       - iterator: a valid box taken while halt_RnnnnL is high
+         (the WAIT state) must give lane A's grid of that box, in
+         the order test_iterator walks it with <lanes> lanes
+       - hash: PIPES_HASH cycles after a sample goes in, the
+         triangle comes out with the sample moved by jitter_sample
+       - sample test: PIPES_SAMP cycles after a valid sample, the
+         hit is sample_test's (sample_test_rtl with -x), at the
+         sample, with the first vertex's depth and the color
+
+     Cycles are counted from the start of the trace; cycles in
+     reset are not checked. bbox and iterator keep state from cycle
+     to cycle and run on one thread each, the hash and sample test
+     checks are spread over the other workers in chunks.
+
+     Build:
+       gcc -O2 -c rasterizer.c zbuff.c
+       g++ -O2 -pthread -o rtl_trace_check rtlTraceCheck.cpp trace_reader.cpp rast_fixed.cpp \
+           helper.cpp rasterizer.o zbuff.o
+     (add -DRTL_TRACE_ZLIB ... -lz to read compressed traces)
+
+     Usage:
+       rtl_trace_check [-b box] [-h hash] [-s samp] [-l lanes] [-j workers] [-x] <trace>
+
+       Defaults are rast_params.sv: -b 14 -h 3 -s 4, with -l 3.
+*/
+
+#define CHECK_CHUNK 16384   // cycles per chunk
+#define CHECK_DEPTH 64      // chunks queued per stage
+
+enum { STAGE_BBOX, STAGE_ITER, STAGE_HASH, STAGE_SAMPLE, STAGES };
+
+static const char* stage_names[STAGES] = { "bbox", "iterator", "hash", "sample test" };
+static const char* stream_names[STAGES] = { "ComputeBoundingBox", "Iterator", "HashJTree", "SampleTest" };
+
+typedef struct {
+    int box;
+    int hash;
+    int samp;
+    int lanes;
+    bool rtl_widths;  // -x
+} CheckParams;
+
+typedef struct { // consecutive records of one stream
+    long long start;    // cycle of v's first record
+    int overlap;        // leading records already checked by the previous chunk
+    vector<int> v;      // records, elems ints each
+} Chunk;
+
+typedef struct {
+    mutex m;
+    long long checked;
+    long long diverged;
+    long long first;    // cycle, -1 while clean
+    char what[512];
+} StageResult;
+
+typedef struct { // element indices of the signals a stage reads
+    int rst, valid_in, tri_in, color_in, sample_in, screen, sample_size, halt, box;
+    int valid_out, tri_out, color_out, sample_out, hit;
+} StageFields;
+
+static int field(const TraceStream& s, const char* name)
+{
+    for( size_t i = 0 ; i < s.fields.size() ; i++ )
+        if( s.fields[i].name == name )
+            return s.fields[i].first;
+    abort_("RTL trace stream %s has no signal %s", s.name.c_str(), name);
+    return -1;
+}
+
+static void stage_fields(const TraceStream& s, int stage, StageFields& f)
+{
+    memset(&f, -1, sizeof(f));
+    f.rst = field(s, "RESET");
+    switch( stage ){
+    case STAGE_BBOX:
+        f.valid_in = field(s, "valid_in");
+        f.tri_in = field(s, "tri_in");
+        f.screen = field(s, "screen_max");
+        f.sample_size = field(s, "sample_size");
+        f.halt = field(s, "halt");
+        f.valid_out = field(s, "valid_out");
+        f.tri_out = field(s, "tri_out");
+        f.box = field(s, "box");
+        break;
+    case STAGE_ITER:
+        f.valid_in = field(s, "valid_in");
+        f.tri_in = field(s, "tri_in");
+        f.box = field(s, "box");
+        f.sample_size = field(s, "sample_size");
+        f.halt = field(s, "halt");
+        f.tri_out = field(s, "tri_out");
+        f.sample_out = field(s, "sample");
+        f.valid_out = field(s, "valid_sample");
+        break;
+    case STAGE_HASH:
+        f.tri_in = field(s, "tri_in");
+        f.color_in = field(s, "color_in");
+        f.sample_in = field(s, "sample_in");
+        f.valid_in = field(s, "valid_sample_in");
+        f.sample_size = field(s, "sample_size");
+        f.tri_out = field(s, "tri_out");
+        f.color_out = field(s, "color_out");
+        f.sample_out = field(s, "sample_out");
+        f.valid_out = field(s, "valid_sample_out");
+        break;
+    default: // STAGE_SAMPLE
+        f.tri_in = field(s, "tri");
+        f.color_in = field(s, "color_in");
+        f.sample_in = field(s, "sample");
+        f.valid_in = field(s, "valid_sample");
+        f.hit = field(s, "hit");
+        f.valid_out = field(s, "valid_hit");
+        f.color_out = field(s, "color_out");
+        break;
+    }
+}
+
+static void diverged(StageResult& r, long long cycle, const char* fmt, ...)
+{
+    lock_guard<mutex> lock(r.m);
+    r.diverged++;
+    if( r.first >= 0 && r.first <= cycle )
+        return;
+    r.first = cycle;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(r.what, sizeof(r.what), fmt, args);
+    va_end(args);
+}
+
+static void add_checked(StageResult& r, long long n)
+{
+    lock_guard<mutex> lock(r.m);
+    r.checked += n;
+}
+
+// subSample_RnnnnU (one hot) as log2 of the sample grid per pixel side
+static int ss_w_lg2(int sample_size)
+{
+    return sample_size & 1 ? 3 : sample_size & 2 ? 2 : sample_size & 4 ? 1 : 0;
+}
+
+static Triangle triangle_of(const int* tri)
+{
+    Triangle t;
+    memset(&t, 0, sizeof(t));
+    for( int i = 0 ; i < 3 ; i++ ){
+        t.v[i].x = tri[3 * i];
+        t.v[i].y = tri[3 * i + 1];
+        t.v[i].z = tri[3 * i + 2];
+    }
+    return t;
+}
+
+static bool same(const int* a, const int* b, int n)
+{
+    return memcmp(a, b, n * sizeof(int)) == 0;
+}
+
+/*
+ *  bbox: state is the halt-enabled delay line of (valid, triangle)
+ *  between the R10 inputs and the R13 outputs.
+ */
+typedef struct {
+    StageFields f;
+    int elems;
+    deque< vector<int> > line;  // valid, tri[9]; front is the oldest
+} BboxState;
+
+static void bbox_check(BboxState& s, const Chunk& c, StageResult& r)
+{
+    const StageFields& f = s.f;
+    size_t n = c.v.size() / s.elems;
+    long long checked = 0;
+
+    for( size_t i = 0 ; i < n ; i++ ){
+        const int* v = &c.v[i * s.elems];
+        long long cycle = c.start + i;
+
+        if( v[f.rst] ){
+            for( size_t k = 0 ; k < s.line.size() ; k++ )
+                fill(s.line[k].begin(), s.line[k].end(), 0);
+            continue;
+        }
+
+        const vector<int>& head = s.line.front();
+        if( head[0] ){
+            Screen screen;
+            screen.width = v[f.screen];
+            screen.height = v[f.screen + 1];
+            Config config;
+            config.r_shift = RAST_RADIX;
+            config.ss_w_lg2 = ss_w_lg2(v[f.sample_size]);
+
+            BoundingBox bbox = get_bounding_box(triangle_of(&head[1]), screen, config);
+            const int* box = &v[f.box];
+            if( !same(&head[1], &v[f.tri_out], 9) )
+                diverged(r, cycle, "tri_out (%d, %d) (%d, %d) (%d, %d), went in as (%d, %d) (%d, %d) (%d, %d)",
+                         v[f.tri_out], v[f.tri_out + 1], v[f.tri_out + 3], v[f.tri_out + 4],
+                         v[f.tri_out + 6], v[f.tri_out + 7], head[1], head[2], head[4], head[5],
+                         head[7], head[8]);
+            else if( v[f.valid_out] != (int)bbox.valid )
+                diverged(r, cycle, "valid_out %d, gold %d", v[f.valid_out], (int)bbox.valid);
+            else if( bbox.valid && ( box[0] != bbox.lower_left.x || box[1] != bbox.lower_left.y ||
+                                     box[2] != bbox.upper_right.x || box[3] != bbox.upper_right.y ) )
+                diverged(r, cycle, "box (%d, %d) (%d, %d), gold (%d, %d) (%d, %d)",
+                         box[0], box[1], box[2], box[3], bbox.lower_left.x, bbox.lower_left.y,
+                         bbox.upper_right.x, bbox.upper_right.y);
+            checked++;
+        }
+
+        if( v[f.halt] ){
+            vector<int> in(10);
+            in[0] = v[f.valid_in];
+            memcpy(&in[1], &v[f.tri_in], 9 * sizeof(int));
+            s.line.pop_front();
+            s.line.push_back(in);
+        }
+    }
+    add_checked(r, checked);
+}
+
+/*
+ *  iterator: boxes taken in the WAIT state, and where lane A is
+ *  in the oldest one.
+ */
+typedef struct {
+    int tri[9];
+    int box[4];
+    int sub;        // subSample_RnnnnU when it was taken
+} IterBox;
+
+typedef struct {
+    StageFields f;
+    int elems;
+    int lanes;
+    deque<IterBox> boxes;
+    int x, y;       // lane A's next sample in boxes.front()
+} IterState;
+
+// Grid step of the iterator: the sample field above RADIX-3 bits, plus steps samples
+static int grid_step(int v, int sub, int steps)
+{
+    return (int)( (unsigned)( ( v >> ( RAST_RADIX - 3 ) ) + sub * steps ) << ( RAST_RADIX - 3 ) );
+}
+
+static void iter_check(IterState& s, const Chunk& c, StageResult& r)
+{
+    const StageFields& f = s.f;
+    size_t n = c.v.size() / s.elems;
+    long long checked = 0;
+
+    for( size_t i = 0 ; i < n ; i++ ){
+        const int* v = &c.v[i * s.elems];
+        long long cycle = c.start + i;
+
+        if( v[f.rst] ){
+            s.boxes.clear();
+            continue;
+        }
+
+        // Output: lane A's sample of the box taken earlier
+        if( v[f.valid_out] ){
+            checked++;
+            if( s.boxes.empty() ){
+                diverged(r, cycle, "sample (%d, %d) with no box to iterate",
+                         v[f.sample_out], v[f.sample_out + 1]);
+            } else {
+                IterBox& b = s.boxes.front();
+                if( !same(b.tri, &v[f.tri_out], 9) )
+                    diverged(r, cycle, "tri_out (%d, %d) (%d, %d) (%d, %d), box taken for (%d, %d) (%d, %d) (%d, %d)",
+                             v[f.tri_out], v[f.tri_out + 1], v[f.tri_out + 3], v[f.tri_out + 4],
+                             v[f.tri_out + 6], v[f.tri_out + 7], b.tri[0], b.tri[1], b.tri[3], b.tri[4],
+                             b.tri[6], b.tri[7]);
+                else if( v[f.sample_out] != s.x || v[f.sample_out + 1] != s.y )
+                    diverged(r, cycle, "sample (%d, %d), expected (%d, %d) of box (%d, %d) (%d, %d)",
+                             v[f.sample_out], v[f.sample_out + 1], s.x, s.y,
+                             b.box[0], b.box[1], b.box[2], b.box[3]);
+
+                // Step like test_iterator: right, else up <lanes> rows, done at the top right
+                bool right_edge = s.x >= b.box[2];
+                bool top = false;
+                for( int l = 0 ; l < s.lanes ; l++ )
+                    top = top || grid_step(s.y, b.sub, l) >= b.box[3];
+                if( right_edge && top ){
+                    s.boxes.pop_front();
+                    if( !s.boxes.empty() ){
+                        s.x = s.boxes.front().box[0];
+                        s.y = s.boxes.front().box[1];
+                    }
+                } else if( right_edge ){
+                    s.x = b.box[0];
+                    s.y = grid_step(s.y, b.sub, s.lanes);
+                } else {
+                    s.x = grid_step(s.x, b.sub, 1);
+                }
+            }
+        }
+
+        // Input: a valid box is taken in the WAIT state
+        if( v[f.valid_in] && v[f.halt] ){
+            IterBox b;
+            memcpy(b.tri, &v[f.tri_in], sizeof(b.tri));
+            memcpy(b.box, &v[f.box], sizeof(b.box));
+            b.sub = v[f.sample_size];
+            if( s.boxes.empty() ){
+                s.x = b.box[0];
+                s.y = b.box[1];
+            }
+            s.boxes.push_back(b);
+        }
+    }
+    add_checked(r, checked);
+}
+
+// hash: the input record delay cycles before each output record
+static void hash_check(const Chunk& c, int elems, const StageFields& f, int delay, StageResult& r)
+{
+    size_t n = c.v.size() / elems;
+    long long checked = 0;
+
+    for( size_t i = max((size_t)c.overlap, (size_t)delay) ; i < n ; i++ ){
+        const int* out = &c.v[i * elems];
+        const int* in = out - delay * elems;
+        long long cycle = c.start + i;
+        if( out[f.rst] || in[f.rst] )
+            continue;
+
+        if( out[f.valid_out] != in[f.valid_in] ){
+            diverged(r, cycle, "valid_sample_out %d, valid_sample_in %d %d cycles before",
+                     out[f.valid_out], in[f.valid_in], delay);
+            continue;
+        }
+        if( !in[f.valid_in] )
+            continue;
+        checked++;
+
+        Sample sample;
+        sample.x = in[f.sample_in];
+        sample.y = in[f.sample_in + 1];
+        Sample jitter = jitter_sample(sample, ss_w_lg2(in[f.sample_size]));
+        int x = sample.x + (jitter.x << 2);
+        int y = sample.y + (jitter.y << 2);
+
+        if( !same(&in[f.tri_in], &out[f.tri_out], 9) || !same(&in[f.color_in], &out[f.color_out], 3) )
+            diverged(r, cycle, "tri_out/color_out differ from the inputs %d cycles before", delay);
+        else if( out[f.sample_out] != x || out[f.sample_out + 1] != y )
+            diverged(r, cycle, "sample_out (%d, %d), gold (%d, %d) from sample (%d, %d)",
+                     out[f.sample_out], out[f.sample_out + 1], x, y, sample.x, sample.y);
+    }
+    add_checked(r, checked);
+}
+
+// sample test: the sample delay cycles before each hit
+static void sample_check(const Chunk& c, int elems, const StageFields& f, int delay, bool rtl_widths,
+                         StageResult& r)
+{
+    size_t n = c.v.size() / elems;
+    long long checked = 0;
+
+    for( size_t i = max((size_t)c.overlap, (size_t)delay) ; i < n ; i++ ){
+        const int* out = &c.v[i * elems];
+        const int* in = out - delay * elems;
+        long long cycle = c.start + i;
+        if( out[f.rst] || in[f.rst] )
+            continue;
+        if( !in[f.valid_in] ){
+            if( out[f.valid_out] )
+                diverged(r, cycle, "valid_hit 1 for an invalid sample %d cycles before", delay);
+            continue;
+        }
+        checked++;
+
+        Triangle triangle = triangle_of(&in[f.tri_in]);
+        Sample sample;
+        sample.x = in[f.sample_in];
+        sample.y = in[f.sample_in + 1];
+        int hit = rtl_widths ? sample_test_rtl(triangle, sample) : sample_test(triangle, sample);
+
+        if( out[f.valid_out] != hit )
+            diverged(r, cycle, "valid_hit %d, gold %d for sample (%d, %d) in (%d, %d) (%d, %d) (%d, %d)",
+                     out[f.valid_out], hit, sample.x, sample.y, triangle.v[0].x, triangle.v[0].y,
+                     triangle.v[1].x, triangle.v[1].y, triangle.v[2].x, triangle.v[2].y);
+        else if( hit && ( out[f.hit] != sample.x || out[f.hit + 1] != sample.y ||
+                          out[f.hit + 2] != triangle.v[0].z ) )
+            diverged(r, cycle, "hit (%d, %d, %d), expected (%d, %d, %d)", out[f.hit], out[f.hit + 1],
+                     out[f.hit + 2], sample.x, sample.y, triangle.v[0].z);
+        else if( hit && !same(&in[f.color_in], &out[f.color_out], 3) )
+            diverged(r, cycle, "color_out differs from color_in %d cycles before", delay);
+    }
+    add_checked(r, checked);
+}
+
+typedef struct {
+    int stage;
+    Chunk chunk;
+} CheckJob;
+
+typedef struct {
+    const CheckParams* p;
+    const TraceReader* t;
+    int stream[STAGES];
+    StageFields f[STAGES];
+    StageResult result[STAGES];
+} CheckRun;
+
+static void bbox_stage(CheckRun* run, BoundedQueue<Chunk>* q)
+{
+    BboxState s;
+    s.f = run->f[STAGE_BBOX];
+    s.elems = run->t->streams[run->stream[STAGE_BBOX]].elems;
+    s.line.assign(run->p->box, vector<int>(10, 0));
+    Chunk c;
+    while( q->pop(c) )
+        bbox_check(s, c, run->result[STAGE_BBOX]);
+}
+
+static void iter_stage(CheckRun* run, BoundedQueue<Chunk>* q)
+{
+    IterState s;
+    s.f = run->f[STAGE_ITER];
+    s.elems = run->t->streams[run->stream[STAGE_ITER]].elems;
+    s.lanes = run->p->lanes;
+    s.x = s.y = 0;
+    Chunk c;
+    while( q->pop(c) )
+        iter_check(s, c, run->result[STAGE_ITER]);
+    if( !s.boxes.empty() )
+        printf("Note: the trace ends with %zu boxes not fully iterated\n", s.boxes.size());
+}
+
+static void pool_worker(CheckRun* run, BoundedQueue<CheckJob>* q)
+{
+    CheckJob job;
+    while( q->pop(job) ){
+        int elems = run->t->streams[run->stream[job.stage]].elems;
+        if( job.stage == STAGE_HASH )
+            hash_check(job.chunk, elems, run->f[job.stage], run->p->hash, run->result[job.stage]);
+        else
+            sample_check(job.chunk, elems, run->f[job.stage], run->p->samp, run->p->rtl_widths,
+                         run->result[job.stage]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    CheckParams p = { 14, 3, 4, 3, false };
+    int workers = (int)thread::hardware_concurrency();
+    const char* file = NULL;
+
+    for( int i = 1 ; i < argc ; i++ ){
+        if( !strcmp(argv[i], "-x") )
+            p.rtl_widths = true;
+        else if( argv[i][0] == '-' && argv[i][1] && !argv[i][2] && i + 1 < argc ){
+            switch( argv[i][1] ){
+            case 'b': p.box = atoi(argv[++i]); break;
+            case 'h': p.hash = atoi(argv[++i]); break;
+            case 's': p.samp = atoi(argv[++i]); break;
+            case 'l': p.lanes = atoi(argv[++i]); break;
+            case 'j': workers = atoi(argv[++i]); break;
+            default: abort_("Unknown option %s", argv[i]);
+            }
+        }
+        else
+            file = argv[i];
+    }
+    if( file == NULL )
+    {
+        abort_("Usage: rtl_trace_check [-b box] [-h hash] [-s samp] [-l lanes] [-j workers] [-x] <trace>");
+    }
+    if( p.box < 1 || p.hash < 0 || p.samp < 0 || p.lanes < 1 )
+        abort_("Bad pipeline parameters");
+    workers = workers < 1 ? 1 : workers;
+
+    TraceReader t;
+    trace_open(file, t);
+
+    CheckRun run;
+    run.p = &p;
+    run.t = &t;
+    for( int s = 0 ; s < STAGES ; s++ ){
+        run.stream[s] = -1;
+        for( size_t k = 0 ; k < t.streams.size() ; k++ )
+            if( t.streams[k].name == stream_names[s] )
+                run.stream[s] = k;
+        if( run.stream[s] >= 0 )
+            stage_fields(t.streams[run.stream[s]], s, run.f[s]);
+        run.result[s].checked = 0;
+        run.result[s].diverged = 0;
+        run.result[s].first = -1;
+    }
+
+    auto start = chrono::steady_clock::now();
+
+    // bbox and iterator in order on a thread each, hash and sample test on the pool
+    BoundedQueue<Chunk> bbox_q(CHECK_DEPTH), iter_q(CHECK_DEPTH);
+    BoundedQueue<CheckJob> pool_q(CHECK_DEPTH);
+    vector<thread> threads;
+    if( run.stream[STAGE_BBOX] >= 0 )
+        threads.push_back(thread(bbox_stage, &run, &bbox_q));
+    if( run.stream[STAGE_ITER] >= 0 )
+        threads.push_back(thread(iter_stage, &run, &iter_q));
+    for( int i = 0 ; i < workers ; i++ )
+        threads.push_back(thread(pool_worker, &run, &pool_q));
+
+    vector<Chunk> chunks(t.streams.size());
+    vector<int> stage_of(t.streams.size(), -1);
+    for( int s = 0 ; s < STAGES ; s++ )
+        if( run.stream[s] >= 0 )
+            stage_of[run.stream[s]] = s;
+
+    // Hand a full chunk to its stage; hash and sample test chunks start with the records they look back at
+    auto dispatch = [&](int k) {
+        int s = stage_of[k];
+        Chunk& c = chunks[k];
+        int elems = t.streams[k].elems;
+        Chunk next;
+        next.start = c.start + c.v.size() / elems;
+        next.overlap = 0;
+        if( s == STAGE_HASH || s == STAGE_SAMPLE ){
+            size_t keep = min(c.v.size() / elems, (size_t)( s == STAGE_HASH ? p.hash : p.samp ));
+            next.start -= keep;
+            next.overlap = keep;
+            next.v.assign(c.v.end() - keep * elems, c.v.end());
+        }
+        if( s == STAGE_BBOX )
+            bbox_q.push(std::move(c));
+        else if( s == STAGE_ITER )
+            iter_q.push(std::move(c));
+        else {
+            CheckJob job;
+            job.stage = s;
+            job.chunk = std::move(c);
+            pool_q.push(std::move(job));
+        }
+        c = std::move(next);
+    };
+
+    for( size_t k = 0 ; k < chunks.size() ; k++ ){
+        chunks[k].start = 0;
+        chunks[k].overlap = 0;
+    }
+
+    TraceRecord r;
+    long long cycles = 0;
+    while( trace_next(t, r) ){
+        int k = r.stream;
+        if( stage_of[k] < 0 )
+            continue;
+        int elems = t.streams[k].elems;
+        Chunk& c = chunks[k];
+        c.v.insert(c.v.end(), r.v, r.v + elems);
+        if( c.v.size() / elems - c.overlap == CHECK_CHUNK )
+            dispatch(k);
+        cycles = max(cycles, r.cycle + 1);
+    }
+    for( size_t k = 0 ; k < chunks.size() ; k++ )
+        if( stage_of[k] >= 0 && chunks[k].v.size() / t.streams[k].elems > (size_t)chunks[k].overlap )
+            dispatch(k);
+    trace_close(t);
+
+    bbox_q.close();
+    iter_q.close();
+    pool_q.close();
+    for( size_t i = 0 ; i < threads.size() ; i++ )
+        threads[i].join();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printf("\nChecked %lld cycles on %d workers in %.2f s\n", cycles, workers, seconds);
+    printf("  %-12s %12s %10s %12s\n", "stage", "checked", "diverged", "first cycle");
+    bool failed = false;
+    for( int s = 0 ; s < STAGES ; s++ ){
+        if( run.stream[s] < 0 ){
+            printf("  %-12s %12s\n", stage_names[s], "not traced");
+            continue;
+        }
+        StageResult& res = run.result[s];
+        if( res.first >= 0 )
+            printf("  %-12s %12lld %10lld %12lld\n", stage_names[s], res.checked, res.diverged, res.first);
+        else
+            printf("  %-12s %12lld %10lld %12s\n", stage_names[s], res.checked, res.diverged, "-");
+    }
+    for( int s = 0 ; s < STAGES ; s++ ){
+        if( run.stream[s] >= 0 && run.result[s].first >= 0 ){
+            printf("[ERROR] %s diverges at cycle %lld: %s\n", stage_names[s], run.result[s].first,
+                   run.result[s].what);
+            failed = true;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+#include "helper.h"
+#include "trace_reader.h"
+
+/*
+
+   RTL Trace to JSON
+     Expands a rast.sv signal trace (GENERATE_JSON, see rtl_trace.h)
+     into the per-module vector files rast.sv used to $fdisplay
+     itself, for the tools that still read them:
+
+       Rasterizer_vector.json  ComputeBoundingBox_vector.json
+       Iterator_vector.json    HashJTree_vector.json
+       SampleTest_vector.json
+
+     The text is line for line what the $fdisplay calls printed,
+     except that x and z bits, which the DPI record carries as 0,
+     print as 0.
+
+     Build:
+       g++ -O2 -o rtl_trace_json rtlTraceJson.cpp trace_reader.cpp helper.cpp
+     or, to read compressed traces,
+       g++ -O2 -DRTL_TRACE_ZLIB -o rtl_trace_json rtlTraceJson.cpp trace_reader.cpp helper.cpp -lz
+
+     Usage:
+       rtl_trace_json <trace> [out_dir]
+*/
+
+// One element as $fdisplay's %b or %h of the signal
+static char* put_value(char* p, const TraceField& f, int v)
+{
+    unsigned bits = trace_bits(f, v);
+    *p++ = '"';
+    if( f.radix == 'h' ){
+        for( int d = (f.width + 3) / 4 - 1 ; d >= 0 ; d-- )
+            *p++ = "0123456789abcdef"[(bits >> (4 * d)) & 0xf];
+    } else {
+        for( int b = f.width - 1 ; b >= 0 ; b-- )
+            *p++ = '0' + ((bits >> b) & 1);
+    }
+    *p++ = '"';
+    return p;
+}
+
+static char* put_str(char* p, const char* s)
+{
+    while( *s )
+        *p++ = *s++;
+    return p;
+}
+
+// "name": value, with [..] and [[..], [..]] for arrays
+static char* put_field(char* p, const TraceField& f, const int* v)
+{
+    *p++ = '"';
+    p = put_str(p, f.name.c_str());
+    p = put_str(p, "\": ");
+
+    if( f.cols == 0 )
+        return put_value(p, f, v[f.first]);
+
+    int rows = f.rows ? f.rows : 1;
+    if( f.rows )
+        *p++ = '[';
+    for( int r = 0 ; r < rows ; r++ ){
+        if( r )
+            p = put_str(p, ", ");
+        *p++ = '[';
+        for( int c = 0 ; c < f.cols ; c++ ){
+            if( c )
+                p = put_str(p, ", ");
+            p = put_value(p, f, v[f.first + r * f.cols + c]);
+        }
+        *p++ = ']';
+    }
+    if( f.rows )
+        *p++ = ']';
+    return p;
+}
+
+int main(int argc, char **argv)
+{
+    if( argc != 2 && argc != 3 )
+    {
+        abort_("Usage: rtl_trace_json <trace> [out_dir]");
+    }
+    string dir = argc == 3 ? string(argv[2]) + "/" : string();
+
+    TraceReader t;
+    trace_open(argv[1], t);
+
+    vector<FILE*> out(t.streams.size());
+    for( size_t s = 0 ; s < t.streams.size() ; s++ ){
+        string name = dir + t.streams[s].name + "_vector.json";
+        out[s] = fopen(name.c_str(), "w");
+        if( out[s] == NULL )
+            abort_("Failed to Open %s for Write", name.c_str());
+        setvbuf(out[s], NULL, _IOFBF, 1 << 20);
+        fputs("[\n", out[s]);
+    }
+
+    // Longest record: 32 bit elements with quotes and separators, and a name per element
+    vector<char> line(RTL_TRACE_MAX_ELEMS * (36 + sizeof(RtlTraceFieldDesc::name) + 16));
+
+    TraceRecord r;
+    long long records = 0;
+    while( trace_next(t, r) ){
+        const TraceStream& s = t.streams[r.stream];
+        char* p = line.data();
+        *p++ = '{';
+        for( size_t i = 0 ; i < s.fields.size() ; i++ ){
+            p = put_field(p, s.fields[i], r.v);
+            if( i + 1 < s.fields.size() )
+                *p++ = ',';
+            else if( s.flags & RTL_TRACE_CLOSE_LINE )
+                p = put_str(p, "\n},");
+            else
+                p = put_str(p, "},");
+            *p++ = '\n';
+        }
+        fwrite(line.data(), 1, p - line.data(), out[r.stream]);
+        records++;
+    }
+    trace_close(t);
+
+    for( size_t s = 0 ; s < out.size() ; s++ ){
+        fputs("]\n", out[s]);
+        fclose(out[s]);
+    }
+
+    printf("Wrote %lld records of %zu streams\n", records, t.streams.size());
+    return 0;
+}
@@ -0,0 +1,301 @@
+#include "helper.h"
+#include "pipeline.h"
+extern "C"{
+#include "rtl_trace.h"
+}
+
+#ifdef RTL_TRACE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+/*
+ *  Signals of each stream, in the order rast.sv packs a record and
+ *  the JSON printed them. Width 0 is SIGFIG.
+ */
+static const RtlTraceFieldDesc rast_fields[] = {
+  { "RESET",       0, 0, 1, 'b' },
+  { "valid_in",    0, 0, 1, 'b' },
+  { "tri",         3, 3, 0, 'b' },
+  { "color_in",    0, 3, 0, 'b' },
+  { "screen_max",  0, 2, 0, 'b' },
+  { "sample_size", 0, 0, 4, 'b' },
+  { "halt",        0, 0, 1, 'b' },
+  { "valid_hit",   0, 0, 1, 'b' },
+  { "hit",         0, 3, 0, 'b' },
+  { "color_out",   0, 3, 0, 'b' },
+};
+
+static const RtlTraceFieldDesc bbox_fields[] = {
+  { "RESET",       0, 0, 1, 'b' },
+  { "valid_in",    0, 0, 1, 'b' },
+  { "tri_in",      3, 3, 0, 'b' },
+  { "color_in",    0, 3, 0, 'b' },
+  { "screen_max",  0, 2, 0, 'b' },
+  { "sample_size", 0, 0, 4, 'b' },
+  { "halt",        0, 0, 1, 'b' },
+  { "valid_out",   0, 0, 1, 'b' },
+  { "tri_out",     3, 3, 0, 'b' },
+  { "color_out",   0, 3, 0, 'b' },
+  { "box",         2, 2, 0, 'b' },
+};
+
+static const RtlTraceFieldDesc iter_fields[] = {
+  { "RESET",        0, 0, 1, 'b' },
+  { "tri_in",       3, 3, 0, 'b' },
+  { "color_in",     0, 3, 0, 'b' },
+  { "valid_in",     0, 0, 1, 'b' },
+  { "box",          2, 2, 0, 'b' },
+  { "sample_size",  0, 0, 4, 'b' },
+  { "halt",         0, 0, 1, 'b' },
+  { "tri_out",      3, 3, 0, 'b' },
+  { "color_out",    0, 3, 0, 'b' },
+  { "sample",       0, 2, 0, 'b' },
+  { "valid_sample", 0, 0, 1, 'b' },
+};
+
+static const RtlTraceFieldDesc hash_fields[] = {
+  { "RESET",            0, 0, 1, 'b' },
+  { "tri_in",           3, 3, 0, 'b' },
+  { "color_in",         0, 3, 0, 'b' },
+  { "sample_in",        0, 2, 0, 'b' },
+  { "valid_sample_in",  0, 0, 1, 'b' },
+  { "sample_size",      0, 0, 4, 'b' },
+  { "tri_out",          3, 3, 0, 'b' },
+  { "color_out",        0, 3, 0, 'b' },
+  { "sample_out",       0, 2, 0, 'b' },
+  { "valid_sample_out", 0, 0, 1, 'b' },
+};
+
+static const RtlTraceFieldDesc sample_fields[] = {
+  { "RESET",        0, 0, 1, 'b' },
+  { "tri",          3, 3, 0, 'h' },
+  { "color_in",     0, 3, 0, 'h' },
+  { "sample",       0, 2, 0, 'b' },
+  { "valid_sample", 0, 0, 1, 'b' },
+  { "hit",          0, 3, 0, 'h' },
+  { "valid_hit",    0, 0, 1, 'b' },
+  { "color_out",    0, 3, 0, 'h' },
+};
+
+typedef struct {
+  const char*              name;
+  const RtlTraceFieldDesc* fields;
+  int                      count;
+  int                      flags;
+} StreamTable;
+
+#define STREAM( name, fields, flags ) { name, fields, sizeof( fields ) / sizeof( fields[0] ), flags }
+
+static const StreamTable stream_tables[RTL_TRACE_STREAMS] = {
+  STREAM( "Rasterizer",         rast_fields,   0 ),
+  STREAM( "ComputeBoundingBox", bbox_fields,   RTL_TRACE_CLOSE_LINE ),
+  STREAM( "Iterator",           iter_fields,   0 ),
+  STREAM( "HashJTree",          hash_fields,   0 ),
+  STREAM( "SampleTest",         sample_fields, RTL_TRACE_CLOSE_LINE ),
+};
+
+// Largest encoding of one record: stream, mask and a 5 byte varint per element
+#define RECORD_MAX_BYTES ( 1 + 10 + 5 * RTL_TRACE_MAX_ELEMS )
+
+struct RtlTrace {
+  RtlTrace() : blocks( RTL_TRACE_DEPTH ), records( 0 ), bytes( 0 ) {}
+
+  FILE*                        file;
+  int                          compress;
+  int                          elems[RTL_TRACE_STREAMS];
+  int                          prev[RTL_TRACE_STREAMS][RTL_TRACE_MAX_ELEMS];
+  vector<uchar>                block;   // records of the block being filled
+  size_t                       used;
+  BoundedQueue< vector<uchar> > blocks; // full blocks, to the writer thread
+  thread                       writer;
+  long long                    records;
+  long long                    bytes;   // written by the writer thread
+};
+
+static RtlTrace* traces[RTL_TRACE_MAX];
+static mutex traces_m;
+
+static void writer_stage( RtlTrace* t )
+{
+  vector<uchar> raw;
+  vector<uchar> packed;
+
+  while( t->blocks.pop( raw ) ){
+    RtlTraceBlockHeader h = { (uint32_t)raw.size(), (uint32_t)raw.size(), 0 };
+    const uchar* payload = raw.data();
+
+#ifdef RTL_TRACE_ZLIB
+    if( t->compress ){
+      uLongf size = compressBound( raw.size() );
+      packed.resize( size );
+      if( compress2( packed.data(), &size, raw.data(), raw.size(), Z_BEST_SPEED ) == Z_OK &&
+          size < raw.size() ){
+        h.stored = size;
+        h.flags = RTL_TRACE_DEFLATE;
+        payload = packed.data();
+      }
+    }
+#endif
+
+    fwrite( &h, sizeof( h ), 1, t->file );
+    fwrite( payload, 1, h.stored, t->file );
+    t->bytes += sizeof( h ) + h.stored;
+  }
+}
+
+static void block_start( RtlTrace* t )
+{
+  t->block.resize( RTL_TRACE_BLOCK );
+  t->used = 0;
+  memset( t->prev, 0, sizeof( t->prev ) );
+}
+
+static void block_flush( RtlTrace* t )
+{
+  if( t->used == 0 )
+    return;
+  t->block.resize( t->used );
+  t->blocks.push( std::move( t->block ) );
+  t->block = vector<uchar>();
+  block_start( t );
+}
+
+static inline uchar* put_varint( uchar* p, uint64_t v )
+{
+  while( v >= 0x80 ){
+    *p++ = (uchar)( v | 0x80 );
+    v >>= 7;
+  }
+  *p++ = (uchar)v;
+  return p;
+}
+
+int rtl_trace_open( const char* file_name, int sigfig, int compress )
+{
+  RtlTrace* t = new RtlTrace();
+  t->file = fopen( file_name, "wb" );
+  if( t->file == NULL ){
+    printf( "[ERROR] rtl-trace: cannot open %s\n", file_name );
+    delete t;
+    return -1;
+  }
+  t->compress = compress;
+#ifndef RTL_TRACE_ZLIB
+  if( compress )
+    printf( "[WARNING] rtl-trace: built without RTL_TRACE_ZLIB, %s is not compressed\n", file_name );
+#endif
+
+  RtlTraceHeader h = { RTL_TRACE_MAGIC, RTL_TRACE_VERSION, (uint32_t)sigfig, RTL_TRACE_STREAMS };
+  fwrite( &h, sizeof( h ), 1, t->file );
+
+  for( int s = 0 ; s < RTL_TRACE_STREAMS ; s++ ){
+    const StreamTable& table = stream_tables[s];
+    RtlTraceStreamDesc d;
+    memset( &d, 0, sizeof( d ) );
+    strncpy( d.name, table.name, sizeof( d.name ) - 1 );
+    d.fields = table.count;
+    d.flags = table.flags;
+
+    vector<RtlTraceFieldDesc> fields( table.fields, table.fields + table.count );
+    for( size_t i = 0 ; i < fields.size() ; i++ ){
+      if( fields[i].width == 0 )
+        fields[i].width = sigfig;
+      d.elems += ( fields[i].rows ? fields[i].rows : 1 ) * ( fields[i].cols ? fields[i].cols : 1 );
+    }
+    t->elems[s] = d.elems;
+
+    fwrite( &d, sizeof( d ), 1, t->file );
+    fwrite( fields.data(), sizeof( RtlTraceFieldDesc ), fields.size(), t->file );
+  }
+  t->bytes = ftell( t->file );
+
+  block_start( t );
+
+  int handle = -1;
+  {
+    lock_guard<mutex> lock( traces_m );
+    for( int i = 0 ; i < RTL_TRACE_MAX && handle < 0 ; i++ ){
+      if( traces[i] == NULL ){
+        traces[i] = t;
+        handle = i;
+      }
+    }
+  }
+  if( handle < 0 ){
+    printf( "[ERROR] rtl-trace: all %d traces are in use\n", RTL_TRACE_MAX );
+    fclose( t->file );
+    delete t;
+    return -1;
+  }
+
+  t->writer = thread( writer_stage, t );
+  return handle;
+}
+
+static RtlTrace* rtl_trace( int trace )
+{
+  if( trace < 0 || trace >= RTL_TRACE_MAX )
+    return NULL;
+  return traces[trace];
+}
+
+static void rtl_trace_record( int trace, int stream, const int* rec )
+{
+  RtlTrace* t = rtl_trace( trace );
+  if( t == NULL )
+    return;
+
+  if( t->used + RECORD_MAX_BYTES > RTL_TRACE_BLOCK )
+    block_flush( t );
+
+  int* prev = t->prev[stream];
+  uint32_t delta[RTL_TRACE_MAX_ELEMS];
+  uint64_t mask = 0;
+  for( int i = 0 ; i < t->elems[stream] ; i++ ){
+    uint32_t d = (uint32_t)rec[i] - (uint32_t)prev[i];
+    if( d != 0 ){
+      mask |= 1ull << i;
+      delta[i] = ( d << 1 ) ^ (uint32_t)( (int32_t)d >> 31 ); // zigzag
+      prev[i] = rec[i];
+    }
+  }
+
+  uchar* p = t->block.data() + t->used;
+  *p++ = (uchar)stream;
+  p = put_varint( p, mask );
+  for( uint64_t m = mask ; m ; m &= m - 1 )
+    p = put_varint( p, delta[__builtin_ctzll( m )] );
+  t->used = p - t->block.data();
+  t->records++;
+}
+
+void rtl_trace_rast( int trace, const int* rec )   { rtl_trace_record( trace, RTL_TRACE_RAST, rec ); }
+void rtl_trace_bbox( int trace, const int* rec )   { rtl_trace_record( trace, RTL_TRACE_BBOX, rec ); }
+void rtl_trace_iter( int trace, const int* rec )   { rtl_trace_record( trace, RTL_TRACE_ITER, rec ); }
+void rtl_trace_hash( int trace, const int* rec )   { rtl_trace_record( trace, RTL_TRACE_HASH, rec ); }
+void rtl_trace_sample( int trace, const int* rec ) { rtl_trace_record( trace, RTL_TRACE_SAMPLE, rec ); }
+
+int rtl_trace_close( int trace )
+{
+  RtlTrace* t = rtl_trace( trace );
+  if( t == NULL )
+    return 0;
+
+  block_flush( t );
+  t->blocks.close();
+  t->writer.join();
+  fclose( t->file );
+  printf( "rtl-trace: %lld records, %lld bytes\n", t->records, t->bytes );
+
+  {
+    lock_guard<mutex> lock( traces_m );
+    traces[trace] = NULL;
+  }
+  delete t;
+  return 1;
+}
@@ -0,0 +1,100 @@
+#ifndef RTL_TRACE_H
+#define RTL_TRACE_H
+
+#include <stdint.h>
+
+/*
+ *  Per-cycle signal trace of rast.sv (GENERATE_JSON).
+ *
+ *  Every clock, rast.sv hands one record per stream to the DPI calls
+ *  below: the rast ports and the ports of each submodule, one int per
+ *  signal element in the order of the stream's table in rtl_trace.cpp.
+ *  The records are delta encoded into blocks on the simulation thread;
+ *  a writer thread compresses (with zlib when built with
+ *  -DRTL_TRACE_ZLIB) and writes the blocks.
+ *
+ *  trace_reader.h reads the file back, rtl_trace_json (rtlTraceJson.cpp)
+ *  turns it into the *_vector.json files rast.sv used to $fdisplay.
+ *
+ *  The file is an RtlTraceHeader, for each stream an RtlTraceStreamDesc
+ *  followed by its RtlTraceFieldDesc table, then blocks of
+ *
+ *    RtlTraceBlockHeader
+ *    uint8  payload[stored]   zlib stream if RTL_TRACE_DEFLATE, else raw
+ *
+ *  The raw payload is a run of records
+ *
+ *    uint8   stream
+ *    varint  mask           bit i: element i changed
+ *    varint  delta[]        per changed element, zigzag of (new - old)
+ *
+ *  where old is the stream's previous record in the same block (all
+ *  zero at the start of a block), so every block decodes on its own.
+ *  Varints are LEB128: 7 bits per byte, low first, top bit continues.
+ */
+#define RTL_TRACE_MAGIC 0x43525452 // "RTRC"
+#define RTL_TRACE_VERSION 1
+
+#define RTL_TRACE_MAX 16              // open traces
+#define RTL_TRACE_BLOCK (1 << 20)     // raw bytes per block
+#define RTL_TRACE_DEPTH 8             // blocks queued for the writer thread
+#define RTL_TRACE_MAX_ELEMS 64        // signal elements per record
+
+enum { // streams, and the JSON file each one stood for
+    RTL_TRACE_RAST,     // Rasterizer_vector.json
+    RTL_TRACE_BBOX,     // ComputeBoundingBox_vector.json
+    RTL_TRACE_ITER,     // Iterator_vector.json
+    RTL_TRACE_HASH,     // HashJTree_vector.json
+    RTL_TRACE_SAMPLE,   // SampleTest_vector.json
+    RTL_TRACE_STREAMS
+};
+
+#define RTL_TRACE_CLOSE_LINE 1  // stream flag: JSON object closes on its own line
+#define RTL_TRACE_DEFLATE 1     // block flag
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sigfig;    // SIGFIG of the traced rast
+    uint32_t streams;
+} RtlTraceHeader;
+
+typedef struct {
+    char name[32];      // JSON file name stem
+    uint32_t fields;
+    uint32_t elems;     // ints per record
+    uint32_t flags;
+} RtlTraceStreamDesc;
+
+typedef struct { // signal, scalar (rows = cols = 0), [cols] or [rows][cols]
+    char name[24];
+    uint8_t rows;
+    uint8_t cols;
+    uint8_t width;      // bits
+    char radix;         // 'b' or 'h', as the JSON printed it
+} RtlTraceFieldDesc;
+
+typedef struct {
+    uint32_t raw;       // bytes of records
+    uint32_t stored;    // bytes of payload that follow
+    uint32_t flags;
+} RtlTraceBlockHeader;
+
+/*
+ *  Open a trace for a rast with SIGFIG-bit signals. compress asks
+ *  for zlib blocks; without -DRTL_TRACE_ZLIB they are written raw.
+ *  Returns a handle, -1 if the file can't be written.
+ */
+int rtl_trace_open(const char* file_name, int sigfig, int compress);
+
+// One record per stream and clock; a bad handle is ignored
+void rtl_trace_rast(int trace, const int* rec);
+void rtl_trace_bbox(int trace, const int* rec);
+void rtl_trace_iter(int trace, const int* rec);
+void rtl_trace_hash(int trace, const int* rec);
+void rtl_trace_sample(int trace, const int* rec);
+
+// Write the last block, stop the writer thread and release the handle
+int rtl_trace_close(int trace);
+
+#endif
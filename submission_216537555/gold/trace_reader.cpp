@@ -0,0 +1,148 @@
+#include "trace_reader.h"
+
+#ifdef RTL_TRACE_ZLIB
+#include <zlib.h>
+#endif
+
+void trace_open( const char* file_name, TraceReader& t )
+{
+  t.file = fopen( file_name, "rb" );
+  if( t.file == NULL ){
+    abort_( "Failed to Open RTL Trace %s", file_name );
+  }
+
+  RtlTraceHeader h;
+  if( fread( &h, sizeof( h ), 1, t.file ) != 1 ||
+      h.magic != RTL_TRACE_MAGIC || h.version != RTL_TRACE_VERSION || h.streams > 255 ){
+    abort_( "Not an RTL Trace: %s", file_name );
+  }
+  t.sigfig = h.sigfig;
+
+  t.streams.resize( h.streams );
+  for( size_t s = 0 ; s < t.streams.size() ; s++ ){
+    RtlTraceStreamDesc d;
+    if( fread( &d, sizeof( d ), 1, t.file ) != 1 || d.elems > RTL_TRACE_MAX_ELEMS ){
+      abort_( "Broken RTL Trace Header: %s", file_name );
+    }
+    TraceStream& stream = t.streams[s];
+    stream.name = string( d.name, strnlen( d.name, sizeof( d.name ) ) );
+    stream.flags = d.flags;
+    stream.elems = 0;
+
+    for( uint32_t i = 0 ; i < d.fields ; i++ ){
+      RtlTraceFieldDesc fd;
+      if( fread( &fd, sizeof( fd ), 1, t.file ) != 1 || fd.width == 0 || fd.width > 32 ){
+        abort_( "Broken RTL Trace Header: %s", file_name );
+      }
+      TraceField f;
+      f.name = string( fd.name, strnlen( fd.name, sizeof( fd.name ) ) );
+      f.rows = fd.rows;
+      f.cols = fd.cols;
+      f.width = fd.width;
+      f.radix = fd.radix;
+      f.first = stream.elems;
+      f.count = ( f.rows ? f.rows : 1 ) * ( f.cols ? f.cols : 1 );
+      stream.elems += f.count;
+      stream.fields.push_back( f );
+    }
+    if( stream.elems != (int)d.elems ){
+      abort_( "Broken RTL Trace Header: %s", file_name );
+    }
+  }
+
+  t.pos = 0;
+  t.block.clear();
+  t.cycles.assign( t.streams.size(), 0 );
+  t.values.assign( t.streams.size(), vector<int>( RTL_TRACE_MAX_ELEMS, 0 ) );
+}
+
+// Load the next block, false at the end of the file
+static bool trace_block( TraceReader& t )
+{
+  RtlTraceBlockHeader h;
+  if( fread( &h, sizeof( h ), 1, t.file ) != 1 )
+    return false;
+
+  t.block.resize( h.raw );
+  t.pos = 0;
+  if( h.flags & RTL_TRACE_DEFLATE ){
+#ifdef RTL_TRACE_ZLIB
+    t.packed.resize( h.stored );
+    uLongf size = h.raw;
+    if( fread( t.packed.data(), 1, h.stored, t.file ) != h.stored ||
+        uncompress( t.block.data(), &size, t.packed.data(), h.stored ) != Z_OK || size != h.raw ){
+      printf( "[ERROR] RTL trace ends in a broken block\n" );
+      return false;
+    }
+#else
+    abort_( "RTL Trace is compressed, rebuild with -DRTL_TRACE_ZLIB -lz" );
+#endif
+  } else if( h.stored != h.raw || fread( t.block.data(), 1, h.raw, t.file ) != h.raw ){
+    printf( "[ERROR] RTL trace ends in a broken block\n" );
+    return false;
+  }
+
+  // Deltas start over in every block
+  for( size_t s = 0 ; s < t.values.size() ; s++ )
+    fill( t.values[s].begin(), t.values[s].end(), 0 );
+  return true;
+}
+
+static inline bool get_varint( TraceReader& t, uint64_t& v )
+{
+  v = 0;
+  for( int shift = 0 ; t.pos < t.block.size() && shift < 64 ; shift += 7 ){
+    uchar b = t.block[t.pos++];
+    v |= (uint64_t)( b & 0x7f ) << shift;
+    if( !( b & 0x80 ) )
+      return true;
+  }
+  return false;
+}
+
+// Stop at a record that doesn't decode
+static bool trace_broken( TraceReader& t )
+{
+  printf( "[ERROR] RTL trace ends in a broken record\n" );
+  t.block.clear();
+  t.pos = 0;
+  fseek( t.file, 0, SEEK_END );
+  return false;
+}
+
+bool trace_next( TraceReader& t, TraceRecord& r )
+{
+  while( t.pos == t.block.size() ){
+    if( !trace_block( t ) )
+      return false;
+  }
+
+  int stream = t.block[t.pos++];
+  uint64_t mask;
+  if( stream >= (int)t.streams.size() || !get_varint( t, mask ) ||
+      ( t.streams[stream].elems < 64 && mask >> t.streams[stream].elems ) ){
+    return trace_broken( t );
+  }
+
+  int* v = t.values[stream].data();
+  for( ; mask ; mask &= mask - 1 ){
+    uint64_t z;
+    if( !get_varint( t, z ) )
+      return trace_broken( t );
+    uint32_t d = (uint32_t)( z >> 1 ) ^ -(uint32_t)( z & 1 );
+    int i = __builtin_ctzll( mask );
+    v[i] = (int)( (uint32_t)v[i] + d );
+  }
+
+  r.stream = stream;
+  r.cycle = t.cycles[stream]++;
+  r.v = v;
+  return true;
+}
+
+void trace_close( TraceReader& t )
+{
+  if( t.file != NULL )
+    fclose( t.file );
+  t.file = NULL;
+}
@@ -0,0 +1,75 @@
+#if !defined( J_TRACE_READER )
+#define J_TRACE_READER
+
+#include <vector>
+
+#include "helper.h"
+extern "C"{
+#include "rtl_trace.h"
+}
+
+using namespace std;
+
+/*
+ *  Reader for the rast.sv signal traces written by rtl_trace.cpp (see
+ *  rtl_trace.h). Not part of the simulation build; link it with the
+ *  offline tools that read traces:
+ *
+ *    g++ -O2 [-DRTL_TRACE_ZLIB] tool.cpp trace_reader.cpp helper.cpp [-lz]
+ */
+
+typedef struct { // one signal of a stream
+  string name;
+  int    rows;    // 0 unless [rows][cols]
+  int    cols;    // 0 for a scalar
+  int    width;   // bits
+  char   radix;   // 'b' or 'h'
+  int    first;   // index of its first element in a record
+  int    count;   // elements
+} TraceField;
+
+typedef struct {
+  string             name;
+  int                flags;   // RTL_TRACE_CLOSE_LINE
+  int                elems;
+  vector<TraceField> fields;
+} TraceStream;
+
+typedef struct { // one clock of one stream
+  int        stream;
+  long long  cycle;   // records of this stream before this one
+  const int* v;       // elems values, valid until the next trace_next
+} TraceRecord;
+
+typedef struct {
+  FILE*               file;
+  int                 sigfig;
+  vector<TraceStream> streams;
+  vector<uchar>       block;    // raw records of the current block
+  vector<uchar>       packed;
+  size_t              pos;
+  vector<long long>   cycles;   // per stream
+  vector< vector<int> > values; // per stream, the last record
+} TraceReader;
+
+// Read the header; aborts if file_name is not a trace
+void trace_open(const char* file_name, TraceReader& t);
+
+// Next record in simulation order, false at the end of the trace
+bool trace_next(TraceReader& t, TraceRecord& r);
+
+void trace_close(TraceReader& t);
+
+// Field element as the signal's bits, zero extended
+static inline unsigned trace_bits(const TraceField& f, int v)
+{
+  return f.width >= 32 ? (unsigned)v : (unsigned)v & ( ( 1u << f.width ) - 1 );
+}
+
+// Field element sign extended from the signal's width
+static inline int trace_signed(const TraceField& f, int v)
+{
+  return f.width >= 32 ? v : (int)( (unsigned)v << ( 32 - f.width ) ) >> ( 32 - f.width );
+}
+
+#endif
@@ -0,0 +1,160 @@
+#include "helper.h"
+#include "pipeline.h"
+extern "C"{
+#include "tri_feeder.h"
+#include "rast_types.h"
+}
+
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+struct TriFeeder {
+  TriFeeder() : queue( TRI_FEEDER_DEPTH ), next( 0 ), triangles( 0 ), tag( TRIANGLE_TAG_INIT ) {}
+
+  ifstream                             file;
+  BoundedQueue< vector<TriangleLine> > queue;
+  thread                               reader;
+  vector<TriangleLine>                 lines;  // chunk being handed out
+  size_t                               next;
+  int                                  triangles;  // valid ones handed out
+  unsigned long long                   tag;        // and their tag
+};
+
+static TriFeeder* feeders[TRI_FEEDER_MAX];
+static mutex feeders_m;
+
+static void feeder_stage( TriFeeder* f )
+{
+  vector<TriangleLine> chunk;
+  TriangleLine line;
+
+  chunk.reserve( TRI_FEEDER_CHUNK );
+  while( load_triangle_line( f->file, line ) ){
+    chunk.push_back( line );
+    if( chunk.size() == TRI_FEEDER_CHUNK ){
+      if( !f->queue.push( std::move( chunk ) ) )
+        break; // closed by tri_feeder_close
+      chunk = vector<TriangleLine>();
+      chunk.reserve( TRI_FEEDER_CHUNK );
+    }
+  }
+  if( !chunk.empty() )
+    f->queue.push( std::move( chunk ) );
+
+  f->queue.close();
+}
+
+int tri_feeder_open( const char* file_name, int* screen_w, int* screen_h, int* msaa )
+{
+  TriFeeder* f = new TriFeeder();
+  f->file.open( file_name );
+  if( !f->file.is_open() ){
+    printf( "[ERROR] tri-feeder: cannot open %s\n", file_name );
+    delete f;
+    return -1;
+  }
+
+  // load_header aborts on any other format (JB21I meshes included),
+  // the driver gets -1 and reports it instead
+  string format;
+  getline( f->file, format );
+  if( format != "JB21" ){
+    printf( "[ERROR] tri-feeder: %s is not a JB21 vector (\"%s\")\n", file_name, format.c_str() );
+    delete f;
+    return -1;
+  }
+  f->file.seekg( 0 );
+
+  Screen screen;
+  Config config;
+  load_header( f->file, screen, config );
+  *screen_w = screen.width;
+  *screen_h = screen.height;
+  *msaa = config.ss;
+
+  int handle = -1;
+  {
+    lock_guard<mutex> lock( feeders_m );
+    for( int i = 0 ; i < TRI_FEEDER_MAX && handle < 0 ; i++ ){
+      if( feeders[i] == NULL ){
+        feeders[i] = f;
+        handle = i;
+      }
+    }
+  }
+  if( handle < 0 ){
+    printf( "[ERROR] tri-feeder: all %d feeders are in use\n", TRI_FEEDER_MAX );
+    delete f;
+    return -1;
+  }
+
+  f->reader = thread( feeder_stage, f );
+  return handle;
+}
+
+static TriFeeder* tri_feeder( int feeder )
+{
+  if( feeder < 0 || feeder >= TRI_FEEDER_MAX )
+    return NULL;
+  return feeders[feeder];
+}
+
+int tri_feeder_next( int feeder, int* valid, int* vertices, int* tri, int* color )
+{
+  TriFeeder* f = tri_feeder( feeder );
+  if( f == NULL )
+    return 0;
+
+  if( f->next == f->lines.size() ){
+    f->next = 0;
+    if( !f->queue.pop( f->lines ) ){
+      f->lines.clear();
+      return 0;
+    }
+  }
+
+  const TriangleLine& line = f->lines[f->next++];
+  *valid = line.valid;
+  *vertices = line.vertices;
+  memcpy( tri, line.v, sizeof( line.v ) );
+  memcpy( color, line.color, sizeof( line.color ) );
+
+  if( line.valid ){
+    Triangle triangle;
+    triangle_from_line( line, triangle );
+    f->tag = triangle_tag( f->tag, triangle );
+    f->triangles++;
+  }
+  return 1;
+}
+
+long long tri_feeder_mark( int feeder, int* triangles )
+{
+  TriFeeder* f = tri_feeder( feeder );
+  if( f == NULL ){
+    *triangles = 0;
+    return (long long)TRIANGLE_TAG_INIT;
+  }
+
+  *triangles = f->triangles;
+  return (long long)f->tag;
+}
+
+int tri_feeder_close( int feeder )
+{
+  TriFeeder* f = tri_feeder( feeder );
+  if( f == NULL )
+    return 0;
+
+  f->queue.close();
+  f->reader.join();
+
+  {
+    lock_guard<mutex> lock( feeders_m );
+    feeders[feeder] = NULL;
+  }
+  delete f;
+  return 1;
+}
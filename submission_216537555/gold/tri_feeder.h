@@ -0,0 +1,38 @@
+#ifndef TRI_FEEDER_H
+#define TRI_FEEDER_H
+
+/*
+ *  DPI-C triangle feeder for rast_driver.
+ *
+ *  tri_feeder_open parses the JB21 header and starts a thread that
+ *  reads the triangle lines with load_triangle_line, the parser the
+ *  gold model uses, into a bounded queue ahead of the simulation.
+ *  tri_feeder_next then hands the driver one whole triangle per call.
+ *  tri_feeder_mark tells how many valid triangles it has handed out
+ *  and their tag (helper.h), the mark a z-buffer snapshot keeps.
+ *
+ *  Handles are small ints for the DPI; -1 means the file can't be read
+ *  or is not a JB21 vector.
+ */
+
+#define TRI_FEEDER_MAX 16
+#define TRI_FEEDER_CHUNK 256   // lines per queue entry
+#define TRI_FEEDER_DEPTH 16    // chunks read ahead of the driver
+
+// Screen in fixed point, MSAA as in the file
+int tri_feeder_open(const char* file_name, int* screen_w, int* screen_h, int* msaa);
+
+/*
+ *  Next triangle line: valid flag, vertex count, tri[4][3] (x y z
+ *  of each vertex) and color[3]. Returns 1, or 0 at the end of the
+ *  file.
+ */
+int tri_feeder_next(int feeder, int* valid, int* vertices, int* tri, int* color);
+
+// Valid triangles handed out so far, returns their tag
+long long tri_feeder_mark(int feeder, int* triangles);
+
+// Stop the reader thread and release the handle
+int tri_feeder_close(int feeder);
+
+#endif
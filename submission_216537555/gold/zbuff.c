@@ -5,8 +5,37 @@
 #include "limits.h"
 #include "assert.h"
 #include "rast_types.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ZBUFF_SNAPSHOT_MAGIC 0x4e53425a // "ZBSN"
+#define ZBUFF_SNAPSHOT_VERSION 1
+#define ZBUFF_RLE_RUN 0x80000000u      // control word of a run, else of literals
+#define ZBUFF_RLE_MAX 0x7fffffffu
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  int32_t  w;
+  int32_t  h;
+  int32_t  r_shift;
+  int32_t  ss;
+  int32_t  ss_w;
+  int32_t  ss_w_lg2;
+  double   ss_i;
+  int64_t  triangles;
+  uint64_t tag;
+  uint32_t flags;
+  uint32_t reserved;
+  uint64_t frame_bytes;   // as stored, after the header
+  uint64_t depth_bytes;   // as stored, after the frame buffer
+} ZBuffSnapshot;
 
 
 int idx_f(ZBuff *zbuff, int x, int y, int sx, int sy, int c){
@@ -35,7 +64,232 @@ ZBuff* zbuff_init(Screen screen, Config config){
   for(int i = 0; i < zbuff->w*zbuff->h*config.ss; i++){
     zbuff->depth_buffer[i] = UINT_MAX;
   }
+  zbuff->snapshot = NULL;
+  zbuff->snapshot_size = 0;
+
+  return zbuff;
+}
+
+// Back to black, keeping the allocations for the next frame
+void zbuff_clear(ZBuff *zbuff){
+  int n = zbuff->w*zbuff->h*zbuff->config.ss;
+  memset(zbuff->frame_buffer, 0, n*4*sizeof(ushort));
+  for(int i = 0; i < n; i++){
+    zbuff->depth_buffer[i] = UINT_MAX;
+  }
+}
+
+void zbuff_free(ZBuff *zbuff){
+  if(zbuff->snapshot != NULL){
+    munmap(zbuff->snapshot, zbuff->snapshot_size);
+  } else {
+    free(zbuff->frame_buffer);
+    free(zbuff->depth_buffer);
+  }
+  free(zbuff);
+}
+
+// Run-length code n elements of size bytes: a control word, then one
+// element for a run or count elements for literals. Returns the bytes written.
+static uint64_t rle_write(FILE *stream, const uchar *data, size_t n, size_t size){
+  uint64_t bytes = 0;
+  size_t i = 0;
+  while(i < n){
+    size_t run = 1;
+    while(i + run < n && run < ZBUFF_RLE_MAX && !memcmp(data + (i + run)*size, data + i*size, size)){
+      run++;
+    }
+    uint32_t word;
+    if(run >= 3){
+      word = ZBUFF_RLE_RUN | (uint32_t)run;
+      fwrite(&word, sizeof(word), 1, stream);
+      fwrite(data + i*size, size, 1, stream);
+      bytes += sizeof(word) + size;
+      i += run;
+      continue;
+    }
+
+    // literals up to the next run of three
+    size_t count = run;
+    while(i + count < n && count < ZBUFF_RLE_MAX){
+      const uchar *e = data + (i + count)*size;
+      if(i + count + 2 < n && !memcmp(e, e + size, size) && !memcmp(e, e + 2*size, size)){
+        break;
+      }
+      count++;
+    }
+    word = (uint32_t)count;
+    fwrite(&word, sizeof(word), 1, stream);
+    fwrite(data + i*size, size, count, stream);
+    bytes += sizeof(word) + count*size;
+    i += count;
+  }
+  return bytes;
+}
 
+// Decode exactly in_bytes of rle_write output into n elements
+static int rle_read(const uchar *in, uint64_t in_bytes, uchar *out, size_t n, size_t size){
+  uint64_t pos = 0;
+  size_t i = 0;
+  while(i < n){
+    uint32_t word;
+    if(in_bytes - pos < sizeof(word)){
+      return 0;
+    }
+    memcpy(&word, in + pos, sizeof(word));
+    pos += sizeof(word);
+    size_t count = word & ZBUFF_RLE_MAX;
+    if(count == 0 || count > n - i){
+      return 0;
+    }
+    if(word & ZBUFF_RLE_RUN){
+      if(in_bytes - pos < size){
+        return 0;
+      }
+      for(size_t k = 0; k < count; k++){
+        memcpy(out + (i + k)*size, in + pos, size);
+      }
+      pos += size;
+    } else {
+      if(in_bytes - pos < count*size){
+        return 0;
+      }
+      memcpy(out + i*size, in + pos, count*size);
+      pos += count*size;
+    }
+    i += count;
+  }
+  return pos == in_bytes;
+}
+
+// Written to <file_name>.tmp and renamed, so an older snapshot survives a failed save
+int zbuff_save(ZBuff *zbuff, const char *file_name, ZBuffMark mark, int flags){
+  size_t n = (size_t)zbuff->w*zbuff->h*zbuff->config.ss;
+  size_t frame_size = 4*sizeof(ushort);
+  size_t tmp_len = strlen(file_name) + 5;
+  char *tmp = (char*) malloc(tmp_len);
+  snprintf(tmp, tmp_len, "%s.tmp", file_name);
+
+  FILE *stream = fopen(tmp, "wb");
+  if(stream == NULL){
+    printf("[ERROR] zbuff snapshot: cannot write %s\n", tmp);
+    free(tmp);
+    return 0;
+  }
+
+  ZBuffSnapshot hd;
+  memset(&hd, 0, sizeof(hd));
+  hd.magic = ZBUFF_SNAPSHOT_MAGIC;
+  hd.version = ZBUFF_SNAPSHOT_VERSION;
+  hd.w = zbuff->w;
+  hd.h = zbuff->h;
+  hd.r_shift = zbuff->config.r_shift;
+  hd.ss = zbuff->config.ss;
+  hd.ss_w = zbuff->config.ss_w;
+  hd.ss_w_lg2 = zbuff->config.ss_w_lg2;
+  hd.ss_i = zbuff->config.ss_i;
+  hd.triangles = mark.triangles;
+  hd.tag = mark.tag;
+  hd.flags = flags & ZBUFF_SNAPSHOT_RLE;
+  fwrite(&hd, sizeof(hd), 1, stream);
+
+  if(hd.flags & ZBUFF_SNAPSHOT_RLE){
+    hd.frame_bytes = rle_write(stream, (const uchar*)zbuff->frame_buffer, n, frame_size);
+    hd.depth_bytes = rle_write(stream, (const uchar*)zbuff->depth_buffer, n, sizeof(uint));
+  } else {
+    hd.frame_bytes = n*frame_size;
+    hd.depth_bytes = n*sizeof(uint);
+    fwrite(zbuff->frame_buffer, frame_size, n, stream);
+    fwrite(zbuff->depth_buffer, sizeof(uint), n, stream);
+  }
+
+  // the buffer sizes are only known now
+  fseek(stream, 0, SEEK_SET);
+  fwrite(&hd, sizeof(hd), 1, stream);
+  int ok = !ferror(stream);
+  ok = !fclose(stream) && ok;
+  ok = ok && !rename(tmp, file_name);
+  if(!ok){
+    printf("[ERROR] zbuff snapshot: failed to write %s\n", file_name);
+    remove(tmp);
+  }
+  free(tmp);
+  return ok;
+}
+
+// The z-buffer in a snapshot, NULL if it can't be read
+ZBuff* zbuff_load(const char *file_name, ZBuffMark *mark){
+  int fd = open(file_name, O_RDONLY);
+  struct stat st;
+  if(fd < 0 || fstat(fd, &st) || st.st_size < (off_t)sizeof(ZBuffSnapshot)){
+    printf("[ERROR] zbuff snapshot: cannot read %s\n", file_name);
+    if(fd >= 0){
+      close(fd);
+    }
+    return NULL;
+  }
+  size_t file_size = st.st_size;
+  uchar *map = (uchar*) mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED){
+    printf("[ERROR] zbuff snapshot: cannot map %s\n", file_name);
+    return NULL;
+  }
+
+  ZBuffSnapshot hd;
+  memcpy(&hd, map, sizeof(hd));
+  size_t n = 0;
+  int ok = hd.magic == ZBUFF_SNAPSHOT_MAGIC && hd.version == ZBUFF_SNAPSHOT_VERSION &&
+           hd.w > 0 && hd.h > 0 && hd.w <= 65536 && hd.h <= 65536 &&
+           hd.ss_w >= 1 && hd.ss_w <= 8 && hd.ss == hd.ss_w*hd.ss_w &&
+           hd.frame_bytes <= file_size && hd.depth_bytes <= file_size &&
+           sizeof(hd) + hd.frame_bytes + hd.depth_bytes == file_size;
+  if(ok){
+    n = (size_t)hd.w*hd.h*hd.ss;
+    ok = (hd.flags & ZBUFF_SNAPSHOT_RLE) ||
+         (hd.frame_bytes == n*4*sizeof(ushort) && hd.depth_bytes == n*sizeof(uint));
+  }
+  if(!ok){
+    printf("[ERROR] zbuff snapshot: %s is not a z-buffer snapshot\n", file_name);
+    munmap(map, file_size);
+    return NULL;
+  }
+
+  ZBuff *zbuff = (ZBuff*) malloc(sizeof(ZBuff));
+  zbuff->w = hd.w;
+  zbuff->h = hd.h;
+  zbuff->config.r_shift = hd.r_shift;
+  zbuff->config.ss = hd.ss;
+  zbuff->config.ss_i = hd.ss_i;
+  zbuff->config.ss_w = hd.ss_w;
+  zbuff->config.ss_w_lg2 = hd.ss_w_lg2;
+
+  const uchar *frame = map + sizeof(hd);
+  const uchar *depth = frame + hd.frame_bytes;
+  if(hd.flags & ZBUFF_SNAPSHOT_RLE){
+    zbuff->frame_buffer = (ushort*) malloc(n*4*sizeof(ushort));
+    zbuff->depth_buffer = (uint*) malloc(n*sizeof(uint));
+    zbuff->snapshot = NULL;
+    zbuff->snapshot_size = 0;
+    ok = rle_read(frame, hd.frame_bytes, (uchar*)zbuff->frame_buffer, n, 4*sizeof(ushort)) &&
+         rle_read(depth, hd.depth_bytes, (uchar*)zbuff->depth_buffer, n, sizeof(uint));
+    munmap(map, file_size);
+    if(!ok){
+      printf("[ERROR] zbuff snapshot: %s is corrupt\n", file_name);
+      zbuff_free(zbuff);
+      return NULL;
+    }
+  } else {
+    zbuff->frame_buffer = (ushort*) frame;
+    zbuff->depth_buffer = (uint*) depth;
+    zbuff->snapshot = map;
+    zbuff->snapshot_size = file_size;
+  }
+
+  if(mark != NULL){
+    mark->triangles = hd.triangles;
+    mark->tag = hd.tag;
+  }
   return zbuff;
 }
 
@@ -9,10 +9,38 @@ int idx_f(ZBuff *zbuff, int x, int y, int sx, int sy, int c);
 int idx_d(ZBuff *zbuff, int x , int y , int sx , int sy);
 
 ZBuff* zbuff_init(Screen screen, Config config);
+void zbuff_clear(ZBuff *zbuff);
+void zbuff_free(ZBuff *zbuff);
 void eval_ss(ZBuff *zbuff, uchar *rgb, ushort *fb_pix);
 uchar* eval_all_ss(ZBuff *zbuff);
 void write_ppm(ZBuff *zbuff, char *file_name);
 void process_fragment(ZBuff *zbuff, Sample hit_location, Sample subsample, Fragment f);
+
+/*
+ *  Snapshots
+ *
+ *  zbuff_save writes the frame and depth buffers and the config to one
+ *  file: a fixed header, then both buffers exactly as they are in
+ *  memory (host byte order). zbuff_load maps such a file privately and
+ *  points the buffers into it, so a restore reads only the pages that
+ *  are touched and later fragments never write the file back. With
+ *  ZBUFF_SNAPSHOT_RLE both buffers are run-length coded per sample
+ *  instead, which shrinks mostly-empty images by orders of magnitude
+ *  but has to be decoded into fresh buffers on load.
+ *
+ *  The mark says what the z-buffer already holds: how many triangles
+ *  of the vector are in it and the caller's hash of them, so a render
+ *  of an append-only vector can pick up where the snapshot stopped.
+ */
+#define ZBUFF_SNAPSHOT_RLE 1
+
+typedef struct {
+  long long triangles;        // triangles rasterized into it
+  unsigned long long tag;     // caller's check of those triangles, 0 if none
+} ZBuffMark;
+
+int zbuff_save(ZBuff *zbuff, const char *file_name, ZBuffMark mark, int flags);
+ZBuff* zbuff_load(const char *file_name, ZBuffMark *mark);
 // class zbuff
 // {
 //  public:
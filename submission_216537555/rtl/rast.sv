@@ -74,70 +74,42 @@ module rast
     output logic                        hit_valid_R18H_C            // Is this a hit?
 );
     `ifdef GENERATE_JSON
-    integer bbox_file;
-    integer sample_file;
-    integer hash_file;
-    integer iterator_file;
-    integer rast_file;
+    // Per-cycle trace of the rast ports and of each submodule's ports
+    // (gold/rtl_trace.h). One record per stream and clock, its signals
+    // in the order of the stream's table in gold/rtl_trace.cpp;
+    // gold/rtlTraceJson.cpp expands it into the *_vector.json files.
+    // +rtl_trace=<file> names it (rtl_trace.bin), +rtl_trace_compress
+    // asks for zlib blocks.
+    import "DPI-C" function int rtl_trace_open( input string file_name, input int sigfig, input int compress );
+    import "DPI-C" function void rtl_trace_rast( input int trace, input int rec[25] );
+    import "DPI-C" function void rtl_trace_bbox( input int trace, input int rec[35] );
+    import "DPI-C" function void rtl_trace_iter( input int trace, input int rec[35] );
+    import "DPI-C" function void rtl_trace_hash( input int trace, input int rec[32] );
+    import "DPI-C" function void rtl_trace_sample( input int trace, input int rec[23] );
+    import "DPI-C" function int rtl_trace_close( input int trace );
+
+    int rtl_trace = -1;
 
     initial begin
-        bbox_file = $fopen("ComputeBoundingBox_vector.json", "w");
-        $fdisplay(bbox_file, "[");
-
-        sample_file = $fopen("SampleTest_vector.json", "w");
-        $fdisplay(sample_file, "[");
-
-        hash_file = $fopen("HashJTree_vector.json", "w");
-        $fdisplay(hash_file, "[");
-
-        iterator_file = $fopen("Iterator_vector.json", "w");
-        $fdisplay(iterator_file, "[");
+        string trace_file;
+        if( !$value$plusargs("rtl_trace=%s", trace_file) )
+            trace_file = "rtl_trace.bin";
+        rtl_trace = rtl_trace_open(trace_file, SIGFIG, $test$plusargs("rtl_trace_compress"));
+    end
 
-        rast_file = $fopen("Rasterizer_vector.json", "w");
-        $fdisplay(rast_file, "[");
+    final begin
+        void'(rtl_trace_close(rtl_trace));
     end
 
     always @(posedge clk) begin
-        $fdisplay(rast_file, "{\"RESET\": \"%b\",", rst);
-
-        $fdisplay(rast_file, "\"valid_in\": \"%b\",", validTri_R10H);
-
-        $fdisplay(rast_file, "\"tri\": [[\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"]]",
-        tri_R10S[0][0],
-        tri_R10S[0][1],
-        tri_R10S[0][2],
-        tri_R10S[1][0],
-        tri_R10S[1][1],
-        tri_R10S[1][2],
-        tri_R10S[2][0],
-        tri_R10S[2][1],
-        tri_R10S[2][2], 
-        ",");
-
-        $fdisplay(rast_file, "\"color_in\": [\"%b\", \"%b\", \"%b\"]",
-        color_R10U[0],
-        color_R10U[1],
-        color_R10U[2], 
-        ",");
-
-        $fdisplay(rast_file, "\"screen_max\": [\"%b\", \"%b\"],", screen_RnnnnS[0], screen_RnnnnS[1]);
-        $fdisplay(rast_file, "\"sample_size\": \"%b\",", subSample_RnnnnU);
-        $fdisplay(rast_file, "\"halt\": \"%b\",", halt_RnnnnL);
-        $fdisplay(rast_file, "\"valid_hit\": \"%b\",", hit_valid_R18H);
-
-        $fdisplay(rast_file, "\"hit\": [\"%b\", \"%b\", \"%b\"]",
-        hit_R18S[0],
-        hit_R18S[1],
-        hit_R18S[2],
-        ",");
-
-        $fdisplay(rast_file, "\"color_out\": [\"%b\", \"%b\", \"%b\"]},",
-        color_R18U[0],
-        color_R18U[1],
-        color_R18U[2]);
-     //   ",");
-
-       // $fdisplay(rast_file, "},");
+        rtl_trace_rast(rtl_trace, '{rst, validTri_R10H,
+            tri_R10S[0][0], tri_R10S[0][1], tri_R10S[0][2],
+            tri_R10S[1][0], tri_R10S[1][1], tri_R10S[1][2],
+            tri_R10S[2][0], tri_R10S[2][1], tri_R10S[2][2],
+            color_R10U[0], color_R10U[1], color_R10U[2],
+            screen_RnnnnS[0], screen_RnnnnS[1], subSample_RnnnnU, halt_RnnnnL,
+            hit_valid_R18H, hit_R18S[0], hit_R18S[1], hit_R18S[2],
+            color_R18U[0], color_R18U[1], color_R18U[2]});
     end
     `endif
 
@@ -223,65 +195,20 @@ module rast
     // 'is_quad_out': Bits(1)}
     `ifdef GENERATE_JSON
     always @(posedge clk) begin
-        $fdisplay(bbox_file, "{\"RESET\": \"%b\",", rst);
-
-        $fdisplay(bbox_file, "\"valid_in\": \"%b\",", validTri_R10H);
-
-        $fdisplay(bbox_file, "\"tri_in\": [[\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"]]",
-        tri_R10S[0][0],
-        tri_R10S[0][1],
-        tri_R10S[0][2],
-        tri_R10S[1][0],
-        tri_R10S[1][1],
-        tri_R10S[1][2],
-        tri_R10S[2][0],
-        tri_R10S[2][1],
-        tri_R10S[2][2], 
-        ",");
-
-        $fdisplay(bbox_file, "\"color_in\": [\"%b\", \"%b\", \"%b\"]",
-        color_R10U[0],
-        color_R10U[1],
-        color_R10U[2], 
-        ",");
-
-        $fdisplay(bbox_file, "\"screen_max\": [\"%b\", \"%b\"],", screen_RnnnnS[0], screen_RnnnnS[1]);
-
-        $fdisplay(bbox_file, "\"sample_size\": \"%b\",", subSample_RnnnnU);
-
-        $fdisplay(bbox_file, "\"halt\": \"%b\",", halt_RnnnnL);
-
-        $fdisplay(bbox_file, "\"valid_out\": \"%b\",", validTri_R13H);
-
-        $fdisplay(bbox_file, "\"tri_out\": [[\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"]]",
-        tri_R13S[0][0],
-        tri_R13S[0][1],
-        tri_R13S[0][2],
-        tri_R13S[1][0],
-        tri_R13S[1][1],
-        tri_R13S[1][2],
-        tri_R13S[2][0],
-        tri_R13S[2][1],
-        tri_R13S[2][2], 
-        ",");
-
-        $fdisplay(bbox_file, "\"color_out\": [\"%b\", \"%b\", \"%b\"]",
-        color_R13U[0],
-        color_R13U[1],
-        color_R13U[2],
-        ",");
-
-        $fdisplay(bbox_file, "\"box\": [[\"%b\", \"%b\"], [\"%b\", \"%b\"]]",
-        box_R13S[0][0],
-        box_R13S[0][1],
-        box_R13S[1][0],
-        box_R13S[1][1]);
-        //
-        //",");
-
-        $fdisplay(bbox_file, "},");
+        rtl_trace_bbox(rtl_trace, '{rst, validTri_R10H,
+            tri_R10S[0][0], tri_R10S[0][1], tri_R10S[0][2],
+            tri_R10S[1][0], tri_R10S[1][1], tri_R10S[1][2],
+            tri_R10S[2][0], tri_R10S[2][1], tri_R10S[2][2],
+            color_R10U[0], color_R10U[1], color_R10U[2],
+            screen_RnnnnS[0], screen_RnnnnS[1], subSample_RnnnnU, halt_RnnnnL,
+            validTri_R13H,
+            tri_R13S[0][0], tri_R13S[0][1], tri_R13S[0][2],
+            tri_R13S[1][0], tri_R13S[1][1], tri_R13S[1][2],
+            tri_R13S[2][0], tri_R13S[2][1], tri_R13S[2][2],
+            color_R13U[0], color_R13U[1], color_R13U[2],
+            box_R13S[0][0], box_R13S[0][1], box_R13S[1][0], box_R13S[1][1]});
     end
-    `endif 
+    `endif
 
     test_iterator #(
         .SIGFIG     (SIGFIG     ),
@@ -314,65 +241,19 @@ module rast
 
     `ifdef GENERATE_JSON
     always @(posedge clk) begin
-        $fdisplay(iterator_file, "{\"RESET\": \"%b\",", rst);
-
-        $fdisplay(iterator_file, "\"tri_in\": [[\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"]]",
-        tri_R13S[0][0],
-        tri_R13S[0][1],
-        tri_R13S[0][2],
-        tri_R13S[1][0],
-        tri_R13S[1][1],
-        tri_R13S[1][2],
-        tri_R13S[2][0],
-        tri_R13S[2][1],
-        tri_R13S[2][2], 
-        ",");
-
-        $fdisplay(iterator_file, "\"color_in\": [\"%b\", \"%b\", \"%b\"]",
-        color_R13U[0],
-        color_R13U[1],
-        color_R13U[2],
-        ",");
-
-        $fdisplay(iterator_file, "\"valid_in\": \"%b\",", validTri_R13H);
-
-        $fdisplay(iterator_file, "\"box\": [[\"%b\", \"%b\"], [\"%b\", \"%b\"]]",
-        box_R13S[0][0],
-        box_R13S[0][1],
-        box_R13S[1][0],
-        box_R13S[1][1],
-        ",");
-
-        $fdisplay(iterator_file, "\"sample_size\": \"%b\",", subSample_RnnnnU);
-        $fdisplay(iterator_file, "\"halt\": \"%b\",", halt_RnnnnL);
-
-        $fdisplay(iterator_file, "\"tri_out\": [[\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"]]",
-        tri_R14S[0][0],
-        tri_R14S[0][1],
-        tri_R14S[0][2],
-        tri_R14S[1][0],
-        tri_R14S[1][1],
-        tri_R14S[1][2],
-        tri_R14S[2][0],
-        tri_R14S[2][1],
-        tri_R14S[2][2], 
-        ",");
-
-        $fdisplay(iterator_file, "\"color_out\": [\"%b\", \"%b\", \"%b\"]",
-        color_R14U[0],
-        color_R14U[1],
-        color_R14U[2],
-        ",");
-
-        $fdisplay(iterator_file, "\"sample\": [\"%b\", \"%b\"]",
-        sample_R14S[0],
-        sample_R14S[1],
-        ",");
-
-        $fdisplay(iterator_file, "\"valid_sample\": \"%b\"},", validSamp_R14H);
-
-        //$fdisplay(iterator_file, ",");
-    end 
+        rtl_trace_iter(rtl_trace, '{rst,
+            tri_R13S[0][0], tri_R13S[0][1], tri_R13S[0][2],
+            tri_R13S[1][0], tri_R13S[1][1], tri_R13S[1][2],
+            tri_R13S[2][0], tri_R13S[2][1], tri_R13S[2][2],
+            color_R13U[0], color_R13U[1], color_R13U[2], validTri_R13H,
+            box_R13S[0][0], box_R13S[0][1], box_R13S[1][0], box_R13S[1][1],
+            subSample_RnnnnU, halt_RnnnnL,
+            tri_R14S[0][0], tri_R14S[0][1], tri_R14S[0][2],
+            tri_R14S[1][0], tri_R14S[1][1], tri_R14S[1][2],
+            tri_R14S[2][0], tri_R14S[2][1], tri_R14S[2][2],
+            color_R14U[0], color_R14U[1], color_R14U[2],
+            sample_R14S[0], sample_R14S[1], validSamp_R14H});
+    end
     `endif
     //multitest: sample a
     hash_jtree #(
@@ -454,62 +335,18 @@ module rast
     );
     `ifdef GENERATE_JSON
     always @(posedge clk) begin
-        $fdisplay(hash_file, "{\"RESET\": \"%b\",", rst);
-
-        $fdisplay(hash_file, "\"tri_in\": [[\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"]]",
-        tri_R14S[0][0],
-        tri_R14S[0][1],
-        tri_R14S[0][2],
-        tri_R14S[1][0],
-        tri_R14S[1][1],
-        tri_R14S[1][2],
-        tri_R14S[2][0],
-        tri_R14S[2][1],
-        tri_R14S[2][2], 
-        ",");
-
-        $fdisplay(hash_file, "\"color_in\": [\"%b\", \"%b\", \"%b\"]",
-        color_R14U[0],
-        color_R14U[1],
-        color_R14U[2],
-        ",");
-
-        $fdisplay(hash_file, "\"sample_in\": [\"%b\", \"%b\"]",
-        sample_R14S[0],
-        sample_R14S[1],
-        ",");
-
-        $fdisplay(hash_file, "\"valid_sample_in\": \"%b\",", validSamp_R14H);
-
-        $fdisplay(hash_file, "\"sample_size\": \"%b\",", subSample_RnnnnU);
-
-        $fdisplay(hash_file, "\"tri_out\": [[\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"], [\"%b\", \"%b\", \"%b\"]]",
-        tri_R16S[0][0],
-        tri_R16S[0][1],
-        tri_R16S[0][2],
-        tri_R16S[1][0],
-        tri_R16S[1][1],
-        tri_R16S[1][2],
-        tri_R16S[2][0],
-        tri_R16S[2][1],
-        tri_R16S[2][2], 
-        ",");
-
-        $fdisplay(hash_file, "\"color_out\": [\"%b\", \"%b\", \"%b\"]",
-        color_R16U[0],
-        color_R16U[1],
-        color_R16U[2],
-        ",");
-
-        $fdisplay(hash_file, "\"sample_out\": [\"%b\", \"%b\"]",
-        sample_R16S[0],
-        sample_R16S[1],
-        ",");
-
-        $fdisplay(hash_file, "\"valid_sample_out\": \"%b\"},", validSamp_R16H);
-
-       // $fdisplay(hash_file, ",");
-    end 
+        rtl_trace_hash(rtl_trace, '{rst,
+            tri_R14S[0][0], tri_R14S[0][1], tri_R14S[0][2],
+            tri_R14S[1][0], tri_R14S[1][1], tri_R14S[1][2],
+            tri_R14S[2][0], tri_R14S[2][1], tri_R14S[2][2],
+            color_R14U[0], color_R14U[1], color_R14U[2],
+            sample_R14S[0], sample_R14S[1], validSamp_R14H, subSample_RnnnnU,
+            tri_R16S[0][0], tri_R16S[0][1], tri_R16S[0][2],
+            tri_R16S[1][0], tri_R16S[1][1], tri_R16S[1][2],
+            tri_R16S[2][0], tri_R16S[2][1], tri_R16S[2][2],
+            color_R16U[0], color_R16U[1], color_R16U[2],
+            sample_R16S[0], sample_R16S[1], validSamp_R16H});
+    end
     `endif
     // multitest: sample a
     sampletest #(
@@ -584,57 +421,15 @@ module rast
     // signals in the magma module
     `ifdef GENERATE_JSON
     always @(posedge clk) begin
-        $fdisplay(sample_file, "{\"RESET\": \"%b\",", rst);
-
-        $fdisplay(sample_file, "\"tri\": [[\"%h\", \"%h\", \"%h\"], [\"%h\", \"%h\", \"%h\"], [\"%h\", \"%h\", \"%h\"]]",
-        tri_R16S[0][0],
-        tri_R16S[0][1],
-        tri_R16S[0][2],
-        tri_R16S[1][0],
-        tri_R16S[1][1],
-        tri_R16S[1][2],
-        tri_R16S[2][0],
-        tri_R16S[2][1],
-        tri_R16S[2][2], 
-        ",");
-
-        $fdisplay(sample_file, "\"color_in\": [\"%h\", \"%h\", \"%h\"]",
-        color_R16U[0],
-        color_R16U[1],
-        color_R16U[2],
-        ",");
-
-        $fdisplay(sample_file, "\"sample\": [\"%b\", \"%b\"]",
-        sample_R16S[0],
-        sample_R16S[1],
-        ",");
-
-        $fdisplay(sample_file, "\"valid_sample\": \"%b\",", validSamp_R16H);
-
-        $fdisplay(sample_file, "\"hit\": [\"%h\", \"%h\", \"%h\"]",
-        hit_R18S[0],
-        hit_R18S[1],
-        hit_R18S[2],
-        ",");
-
-        $fdisplay(sample_file, "\"valid_hit\": \"%b\",", hit_valid_R18H);
-
-        $fdisplay(sample_file, "\"color_out\": [\"%h\", \"%h\", \"%h\"]",
-        color_R18U[0],
-        color_R18U[1],
-        color_R18U[2]
-        );
-
-        $fdisplay(sample_file, "},");
+        rtl_trace_sample(rtl_trace, '{rst,
+            tri_R16S[0][0], tri_R16S[0][1], tri_R16S[0][2],
+            tri_R16S[1][0], tri_R16S[1][1], tri_R16S[1][2],
+            tri_R16S[2][0], tri_R16S[2][1], tri_R16S[2][2],
+            color_R16U[0], color_R16U[1], color_R16U[2],
+            sample_R16S[0], sample_R16S[1], validSamp_R16H,
+            hit_R18S[0], hit_R18S[1], hit_R18S[2], hit_valid_R18H,
+            color_R18U[0], color_R18U[1], color_R18U[2]});
     end
-
-    final begin
-        $fdisplay(bbox_file, "]");
-        $fdisplay(sample_file, "]");
-        $fdisplay(hash_file, "]");
-        $fdisplay(iterator_file, "]");
-        $fdisplay(rast_file, "]");
-    end 
     `endif
 
 endmodule
@@ -24,6 +24,20 @@
  *
  * ***************************************************************************/
 
+// Gold-ahead expected sample stream (+goldahead), see gold/gold_ahead.h
+import "DPI-C" function int gold_ahead_open( input string file_name );
+import "DPI-C" function int gold_ahead_close( input int stream );
+// Offline golden stream (+golden=<file>), written by rasterizer_gold --golden
+import "DPI-C" function int golden_stream_open( input string file_name );
+
+// Triangle feeder: the test file is parsed by the gold model's loader, see gold/tri_feeder.h
+import "DPI-C" function int tri_feeder_open( input string file_name, output int screen_w,
+                                             output int screen_h, output int msaa );
+import "DPI-C" function int tri_feeder_next( input int feeder, output int valid, output int vertices,
+                                             output int tri[4][3], output int color[3] );
+import "DPI-C" function longint tri_feeder_mark( input int feeder, output int triangles );
+import "DPI-C" function int tri_feeder_close( input int feeder );
+
 module rast_driver
 #(
     parameter SIGFIG = 24, // Bits in color and position.
@@ -46,8 +60,10 @@ module rast_driver
     output int                          ss_w_lg2_RnnnnS
 );
 
-    logic   signed   [SIGFIG-1:0]  tmp_tri_R10S[VERTS-1:0][AXIS-1:0] ; // Output: 4 Sets X,Y Fixed Point Values
-    logic   unsigned [SIGFIG-1:0]  tmp_color_R10U[COLORS-1:0];
+    int             feed_tri[4][3];   // triangle from the feeder, 4 vertices x (x,y,z)
+    int             feed_color[3];
+    int             feed_valid;
+    int             screen_w, screen_h;
 
 
     int signed      mini = -1024;
@@ -59,14 +75,22 @@ module rast_driver
 
     // for controlling the input file
     string  testname;
-    string  format_header;
-    int     fh; //test file handle
-    int     count;
+    int     feeder; //triangle feeder handle
     int     msaa;
     int     line_num;
     int     num_vertices;
 
     logic   TestFinish ;
+    int     gold_stream = -1; // gold-ahead stream handle, -1 when off
+    string  golden_file;      // precomputed golden stream, replaces +goldahead
+
+    int     skip = 0;         // valid triangles already in a restored z-buffer, not driven
+    longint skip_tag;         // their tag, as the snapshot recorded it
+    int     fed = 0;          // triangles taken from the feeder, skipped ones included
+    int     mark_triangles;   // valid triangles fed, for checkpoints (tri_feeder_mark)
+    longint mark_tag;         // and their tag
+    int     checkpoint_every = 0; // +zbuff_checkpoint_every=<n>
+    event   checkpoint;       // the pipe is drained after every checkpoint_every triangles
 
     assign ss_w_lg2_RnnnnS = ss_w_lg2;
 
@@ -104,19 +128,13 @@ module rast_driver
     begin
         $display("time=%10t ************** Driver Is Initializing Test from File *****************", $time);
 
-        // open test file:
-        fh = $fopen(testname,"r");
-        line_num = 1;
-        assert (fh) else $fatal(2, "ERROR: Cannot open file %s", testname);
-        assert (!$feof(fh)) else $fatal(2, "ERROR: File -->%s<--is empty",testname);
-
-        // read the screen parameters
-        count = $fscanf(fh, "%s" , format_header );
-        assert(format_header=="JB21") else $fatal(2, "Error: Incorrect File Type" );
-
-        count = $fscanf(fh, "%6x %6x %d", screen_RnnnnS[0], screen_RnnnnS[1], msaa);
-        line_num = line_num+1;
-        assert (count==3) else $fatal(2, "ERROR: Cannot find screen params");
+        // open test file and read the screen parameters
+        feeder = tri_feeder_open(testname, screen_w, screen_h, msaa);
+        line_num = 2;
+        assert (feeder >= 0) else $fatal(2, "ERROR: Cannot open file %s", testname);
+        mark_tag = tri_feeder_mark(feeder, mark_triangles);
+        screen_RnnnnS[0] = screen_w;
+        screen_RnnnnS[1] = screen_h;
         $display ("Setting screen params: w=%0d h=%0d msaa=%0d", screen_RnnnnS[0]>>10, screen_RnnnnS[1]>>10, msaa);
         case (msaa)
             1: begin
@@ -139,6 +157,19 @@ module rast_driver
                 assert (0) else $fatal(2, "ERROR: Illigal MSAA input %d", msaa);
         endcase // case(msaa)
 
+        // replay a precomputed golden stream, or start the gold model
+        // on the same file, running ahead of the RTL
+        if ($value$plusargs("golden=%s", golden_file)) begin
+            gold_stream = golden_stream_open(golden_file);
+            $display("time=%10t ************** Golden stream %0d from -->%s<-- *****************", $time, gold_stream, golden_file);
+        end
+        else if ($test$plusargs("goldahead")) begin
+            gold_stream = gold_ahead_open(testname);
+            $display("time=%10t ************** Gold-ahead stream %0d for -->%s<-- *****************", $time, gold_stream, testname);
+        end
+
+        void'($value$plusargs("zbuff_checkpoint_every=%d", checkpoint_every));
+
     end
     endtask
 
@@ -154,53 +185,67 @@ module rast_driver
         // wait a couple of cycles for the design to learn the parameters
         repeat (2) @(posedge clk);
 
-        // Now start driving the signals
-        while (!$feof(fh)) begin
+        // the restored z-buffer already holds the first skip triangles
+        assert (skip == 0 || gold_stream < 0)
+            else $fatal(2, "ERROR: +zbuff_restore cannot be combined with +goldahead or +golden");
+        while (mark_triangles < skip && tri_feeder_next(feeder, feed_valid, num_vertices, feed_tri, feed_color)) begin
+            fed = fed + 1;
+            line_num = line_num + 1;
+            mark_tag = tri_feeder_mark(feeder, mark_triangles);
+        end
+        assert (skip == 0 || mark_triangles == skip && mark_tag == skip_tag)
+            else $fatal(2, "ERROR: The restored z-buffer does not hold the first %0d triangles of %s", skip, testname);
+
+        // Now start driving the signals, one whole triangle per feeder call
+        while (tri_feeder_next(feeder, feed_valid, num_vertices, feed_tri, feed_color)) begin
             // Wait until the design is ready (unhalted)
             while( !halt_RnnnnL ) @(posedge clk);
 
-                // read a triangle from the file\
-                // Need to fix conversion tool to include depth
-                // Data is strongly dependent on parameterization
-                // This is brittle code!!!
-                // Need some indirection to make this better
-                count = $fscanf(fh, "%1b %1d %6x %6x %6x %6x %6x %6x %6x %6x %6x %6x %6x %6x %6x %6x %6x",
-                    validTri_R10H, num_vertices,
-                    tmp_tri_R10S[0][0], tmp_tri_R10S[0][1], tmp_tri_R10S[0][2],
-                    tmp_tri_R10S[1][0], tmp_tri_R10S[1][1], tmp_tri_R10S[1][2],
-                    tmp_tri_R10S[2][0], tmp_tri_R10S[2][1], tmp_tri_R10S[2][2],
-                    tmp_tri_R10S[3][0], tmp_tri_R10S[3][1], tmp_tri_R10S[3][2],
-                    tmp_color_R10U[0],   tmp_color_R10U[1], tmp_color_R10U[2] );
+                validTri_R10H = feed_valid[0];
 
                 for( eachVertsA = 0 ; eachVertsA < VERTS ; eachVertsA++ ) begin
-                    tri_R10S[eachVertsA][0] = tmp_tri_R10S[eachVertsA][0] ;
-                    tri_R10S[eachVertsA][1] = tmp_tri_R10S[eachVertsA][1] ;
-                    tri_R10S[eachVertsA][2] = tmp_tri_R10S[eachVertsA][2] ;
+                    tri_R10S[eachVertsA][0] = feed_tri[eachVertsA][0] ;
+                    tri_R10S[eachVertsA][1] = feed_tri[eachVertsA][1] ;
+                    tri_R10S[eachVertsA][2] = feed_tri[eachVertsA][2] ;
                 end
 
-                color_R10U[0] = tmp_color_R10U[0];
-                color_R10U[1] = tmp_color_R10U[1];
-                color_R10U[2] = tmp_color_R10U[2];
+                color_R10U[0] = feed_color[0];
+                color_R10U[1] = feed_color[1];
+                color_R10U[2] = feed_color[2];
 
-                // make sure we read a triangle with either 3 or 4 vertices
-                assert (num_vertices==3 || num_vertices==4)
-                    else $fatal(2, "ERROR: Wrong number of vertices for triangle at line %0d", line_num);
+                // the feeder stops at a line without 3 or 4 vertices
                 assert (VERTS==3 && num_vertices==3 || VERTS==4)
                     else $fatal(2, "Error: Input contains triangle pairs, should only contain singles at line %0d", line_num);
 
-                // If we were able to read the line, continue, else finish this simulation
-                if (count!=-1) begin
-                    assert (count==17) else $fatal(2, "ERROR: Cannot read triangle at line %0d", line_num);
                 line_num = line_num+1;
                 @(posedge clk);
-            end
-        end // while (!$feof(fh))
-    $fclose(fh);
+                fed = fed + 1;
+
+                // drain the pipe so the z-buffer holds exactly fed triangles
+                if (checkpoint_every > 0 && fed % checkpoint_every == 0) begin
+                    validTri_R10H = 1'b0;
+                    WaitIdle();
+                    repeat (15) @(posedge clk);
+                    mark_tag = tri_feeder_mark(feeder, mark_triangles);
+                    -> checkpoint;
+                end
+        end // while (tri_feeder_next)
+    mark_tag = tri_feeder_mark(feeder, mark_triangles);
+    void'(tri_feeder_close(feeder));
 
     // stop stressing the design
     validTri_R10H =  1'b0;
 
-    // Wait until the design is done processing (unhalted)
+    WaitIdle();
+    TestFinish = 1'b1;
+    $display("time=%10t ************** Driver Is Done *****************", $time);
+
+    end
+    endtask // RunTest
+
+    // Wait until the design is done processing and the pipe is clean
+    task WaitIdle;
+    begin
     while( ! halt_RnnnnL ) @(posedge clk);
     @(posedge clk);
     @(posedge clk);
@@ -212,12 +257,14 @@ module rast_driver
     @(posedge clk);
     while( ! halt_RnnnnL ) @(posedge clk);
 
-    // Now let the pipe clean and finish
+    // Now let the pipe clean
     repeat(10) @(posedge clk);
-    TestFinish = 1'b1;
-    $display("time=%10t ************** Driver Is Done *****************", $time);
+    end
+    endtask // WaitIdle
 
+    final begin
+        if (gold_stream >= 0)
+            void'(gold_ahead_close(gold_stream));
     end
-    endtask // RunTest
 
 endmodule
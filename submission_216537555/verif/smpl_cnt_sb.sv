@@ -9,6 +9,20 @@
  *  both scoreboards should detect if a triangle
  *  generates any incorrect fragments
  *
+ *  The count check is off by default (on, in sync
+ *  mode, with smpl_lanes_sb's +sample_rate). Select it with
+ *      +hitcnt=sync      check each triangle in place
+ *      +hitcnt=deferred  queue each triangle to gold
+ *                        worker threads, mismatches are
+ *                        reported at sync_hit_count()
+ *                        and at the end of simulation
+ *
+ *  The count adds the hits of all three sample lanes
+ *  (A, B and the multitest lane C). The original
+ *  counter only added A and B, which undercounted
+ *  whenever lane C hit; that went unnoticed while the
+ *  count check itself was commented out.
+ *
  *
  */
 
@@ -35,17 +49,26 @@ import "DPI" pure function int check_hit_count(
     int   r_val        //Congig
 );
 
-// Import the DPI function for checking the hash module
-import "DPI" pure function int check_hash(
-    int s_x,           //sample
-    int s_y,           //sample
-    int ss_w_lg2,      //Subsample
-    int jitter_x,      //jitter
-    int jitter_y,      //jitter
-    int s_j_x,         //jittered_sample
-    int s_j_y          //jittered_sample
+// Deferred variant: queued to gold worker threads, reported at sync
+import "DPI-C" function int check_hit_count_deferred(
+    input int   v0_x,   //triangle
+    input int   v0_y,        //triangle
+    input int   v1_x,        //triangle
+    input int   v1_y,        //triangle
+    input int   v2_x,        //triangle
+    input int   v2_y,        //triangle
+    input int   hits,        //Number of Samples in triangle
+    input int   ss_w_lg2,    //Subsample
+    input int   screen_w,    //Screen
+    input int   screen_h,    //Screen
+    input int   r_shift,     //Config
+    input int   r_val,       //Congig
+    input longint sim_time   //Time of check
 );
-// END CODE HERE
+
+import "DPI-C" function int check_hit_count_sync();
+import "DPI-C" function int check_hit_count_finish();
+
 
 module smpl_cnt_sb
 #(
@@ -74,29 +97,10 @@ module smpl_cnt_sb
     input logic        [SIGFIG-1:0]     screen_RnnnnS[1:0],      // Screen Size
     input logic        [3:0]            subSample_RnnnnU,    // Flag for subsample
 
-    input logic signed [SIGFIG-1:0]     s_x_RnnS,
-    input logic signed [SIGFIG-1:0]     s_y_RnnS,
-    input logic signed [7:0]            jitter_x_RnnS,
-    input logic signed [7:0]            jitter_y_RnnS,
-    input logic signed [SIGFIG-1:0]     s_j_x_RnnS,
-    input logic signed [SIGFIG-1:0]     s_j_y_RnnS,
-
     // multitest: sample b
     input logic                         hit_valid_R18H_B,
-    input logic signed [SIGFIG-1:0]     s_x_RnnS_B,
-    input logic signed [SIGFIG-1:0]     s_y_RnnS_B,
-    input logic signed [7:0]            jitter_x_RnnS_B,
-    input logic signed [7:0]            jitter_y_RnnS_B,
-    input logic signed [SIGFIG-1:0]     s_j_x_RnnS_B,
-    input logic signed [SIGFIG-1:0]     s_j_y_RnnS_B,
-    // multitest: sample b
-    input logic                         hit_valid_R18H_C,
-    input logic signed [SIGFIG-1:0]     s_x_RnnS_C,
-    input logic signed [SIGFIG-1:0]     s_y_RnnS_C,
-    input logic signed [7:0]            jitter_x_RnnS_C,
-    input logic signed [7:0]            jitter_y_RnnS_C,
-    input logic signed [SIGFIG-1:0]     s_j_x_RnnS_C,
-    input logic signed [SIGFIG-1:0]     s_j_y_RnnS_C
+    // multitest: sample c
+    input logic                         hit_valid_R18H_C
  );
 
 
@@ -112,22 +116,24 @@ module smpl_cnt_sb
     int file;
     int one;
     int ss_w_lg2;
+    string hitcnt_mode;
     assign one = 1 ;
     //Helper Signals
 
     //Bench Logic
     int   hit_count;
     int   hit_count_next;
-    logic incr;
-    logic incr_by_two;
-    logic keep;
+    int   lane_hits;
     logic reset_to_zero;
-    logic reset_to_one;
-    logic reset_to_two;
     //Bench Logic
 
     initial begin
         file = $fopen(FILENAME,"w");
+        if( !$value$plusargs("hitcnt=%s", hitcnt_mode) )
+            hitcnt_mode = "off";
+        // sampled sample checking relies on exact hit counts
+        if( hitcnt_mode == "off" && $test$plusargs("sample_rate=") )
+            hitcnt_mode = "sync";
     end
 
     always_comb begin
@@ -139,76 +145,66 @@ module smpl_cnt_sb
         endcase
     end
 
-    // Call the DPI function that checks that the hash produces the correct jittered samples
-    // Should only be called if reset is not asserted
+    // Hash checks for all lanes are done by smpl_lanes_sb
+
+    //Check that the Number of Hits is Correct
     always @( posedge clk ) begin
         #10;
-        if (~rst) begin
-            if (one != check_hash(
-                    int'(s_x_RnnS), 
-                    int'(s_y_RnnS), 
-                    int'(ss_w_lg2),
-                    int'(jitter_x_RnnS), 
-                    int'(jitter_y_RnnS),
-                    int'(s_j_x_RnnS),
-                    int'(s_j_y_RnnS))) 
-            assert(0) else $error("Hash check failed");
+        if( reset_to_zero && validSamp_RnnH && hitcnt_mode == "sync" ) begin
+            if(one != check_hit_count(
+                    int'(tri_RnnS[0][0]),   //triangle
+                    int'(tri_RnnS[0][1]),   //triangle
+                    int'(tri_RnnS[1][0]),   //triangle
+                    int'(tri_RnnS[1][1]),   //triangle
+                    int'(tri_RnnS[2][0]),   //triangle
+                    int'(tri_RnnS[2][1]),   //triangle
+                    hit_count,               //Number of Samples in triangle
+                    ss_w_lg2,                //Subsample
+                    int'(screen_RnnnnS[0] ), //Screen
+                    int'(screen_RnnnnS[1] ), //Screen
+                    RADIX,                   //Config
+                    int'( 128'd1 << RADIX )  //Congig
+                    )) begin
+                $fwrite( file , "@%0t: Hit Count ERROR!!!!\n" , $time );
+                assert( 0 ) else $error( "time=%10t ERROR: Hit count check failed", $time );
+            end
         end
-    end
-    // multitest: sample b
-    always @( posedge clk ) begin
-        #10;
-        if (~rst) begin
-            if (one != check_hash(
-                    int'(s_x_RnnS_B), 
-                    int'(s_y_RnnS_B), 
-                    int'(ss_w_lg2),
-                    int'(jitter_x_RnnS_B), 
-                    int'(jitter_y_RnnS_B),
-                    int'(s_j_x_RnnS_B),
-                    int'(s_j_y_RnnS_B))) 
-            assert(0) else $error("Hash check failed");
+        if( reset_to_zero && validSamp_RnnH && hitcnt_mode == "deferred" ) begin
+            void'(check_hit_count_deferred(
+                    int'(tri_RnnS[0][0]),   //triangle
+                    int'(tri_RnnS[0][1]),   //triangle
+                    int'(tri_RnnS[1][0]),   //triangle
+                    int'(tri_RnnS[1][1]),   //triangle
+                    int'(tri_RnnS[2][0]),   //triangle
+                    int'(tri_RnnS[2][1]),   //triangle
+                    hit_count,               //Number of Samples in triangle
+                    ss_w_lg2,                //Subsample
+                    int'(screen_RnnnnS[0] ), //Screen
+                    int'(screen_RnnnnS[1] ), //Screen
+                    RADIX,                   //Config
+                    int'( 128'd1 << RADIX ), //Congig
+                    longint'($time)          //Time of check
+                    ));
         end
     end
-    // multitest: sample c 
-    always @( posedge clk ) begin
-        #10;
-        if (~rst) begin
-            if (one != check_hash(
-                    int'(s_x_RnnS_C), 
-                    int'(s_y_RnnS_C), 
-                    int'(ss_w_lg2),
-                    int'(jitter_x_RnnS_C), 
-                    int'(jitter_y_RnnS_C),
-                    int'(s_j_x_RnnS_C),
-                    int'(s_j_y_RnnS_C))) 
-            assert(0) else $error("Hash check failed");
+
+    //Wait for deferred hit count checks and report their mismatches
+    task sync_hit_count;
+        int errors;
+    begin
+        if( hitcnt_mode == "deferred" ) begin
+            errors = check_hit_count_sync();
+            if( errors != 0 ) begin
+                $fwrite( file , "@%0t: %0d Hit Count ERRORS!!!!\n" , $time, errors );
+                assert( 0 ) else $error( "time=%10t ERROR: %0d deferred hit count checks failed", $time, errors );
+            end
         end
     end
-    // END CODE HERE
+    endtask
 
-    //Check that the Number of Hits is Correct
-    always @( posedge clk ) begin
-        #10;
-        if( reset_to_zero && validSamp_RnnH ) begin
-            //if(one != check_hit_count(
-            //        int'(tri_RnnS[0][0]),   //triangle
-            //        int'(tri_RnnS[0][1]),   //triangle
-            //        int'(tri_RnnS[1][0]),   //triangle
-            //        int'(tri_RnnS[1][1]),   //triangle
-            //        int'(tri_RnnS[2][0]),   //triangle
-            //        int'(tri_RnnS[2][1]),   //triangle
-            //        hit_count,               //Number of Samples in triangle
-            //        ss_w_lg2,                //Subsample
-            //        int'(screen_RnnnnS[0] ), //Screen
-            //        int'(screen_RnnnnS[1] ), //Screen
-            //        RADIX,                   //Config
-            //        int'( 128'd1 << RADIX )  //Congig
-            //        )) begin
-
-            //    $finish();
-            //end
-        end
+    final begin
+        if( hitcnt_mode == "deferred" && check_hit_count_finish() != 0 )
+            $display( "ERROR: deferred hit count checks failed after the last sync" );
     end
 
     //Sample hit Counter for
@@ -231,21 +227,11 @@ module smpl_cnt_sb
     always_comb begin
 
         reset_to_zero = (tri_Rn1S != tri_RnnS) ; //New triangle
-        reset_to_one = (reset_to_zero && hit_valid_R18H) || (reset_to_zero && hit_valid_R18H_B); //New triangle with hit
-        reset_to_two = (reset_to_zero && hit_valid_R18H) && (reset_to_zero && hit_valid_R18H_B); //New triangle with hit
-        incr_by_two = hit_valid_R18H && hit_valid_R18H_B; //both samples hit
-        incr = hit_valid_R18H | hit_valid_R18H_B;
-        keep = ~hit_valid_R18H && ~hit_valid_R18H_B ;
-
-        priority case( 1'b1 )
-            (reset_to_two): hit_count_next = 2;
-            (reset_to_one): hit_count_next = 1;
-            (reset_to_zero): hit_count_next = 0;
-            (incr_by_two): hit_count_next = hit_count + 2;
-            (incr): hit_count_next = hit_count + 1 ;
-            (keep): hit_count_next = hit_count ;
-            default: hit_count_next = 0;
-        endcase // case ( 1'b1 )
+        //All three lanes hit into the same triangle (lane C was not counted before)
+        lane_hits = int'(hit_valid_R18H) + int'(hit_valid_R18H_B) + int'(hit_valid_R18H_C);
+
+        //New triangle starts from this cycle's hits, otherwise accumulate
+        hit_count_next = reset_to_zero ? lane_hits : hit_count + lane_hits ;
     end
     //Sample Hit Counter
 
@@ -0,0 +1,304 @@
+/*
+ * smpl_lanes_sb
+ *
+ *   Fused Sample Lanes Score Board
+ *
+ *   Checks the hash stage (jitter and jittered sample)
+ *   and the sample test stage (hit) of all three sample
+ *   lanes with a single DPI call per clock, instead of
+ *   one check_hash and one check_sample_test per lane.
+ *
+ *   With +goldahead (or +golden=<file>) the expected hits
+ *   come from the gold stream rast_driver opened.
+ *
+ *   With +sample_rate=<per mille> only that share of the
+ *   samples is checked, after every sample of the first
+ *   +sample_full=<n> triangles (default 1000), chosen by
+ *   +sample_seed=<s>. The hit count check is then forced
+ *   on, and the coverage is reported at the end.
+ *
+ *   Output error to file and stdout
+ *
+ */
+
+  /****************************************************************************
+ * Change bar:
+ * -----------
+ * Date           Author    Description
+ * Sep 22, 2012   jingpu    ported from John's original code to Genesis
+ *
+ * ***************************************************************************/
+
+import "DPI-C" function int check_sample_lanes_ctx(
+    input int   ctx,            //gold context
+    input int   tri_v[6],       //triangle
+    input int   valid_samp,     //sample test stage valid
+    input int   sample[3][2],   //jittered SAMPLE per lane
+    input int   hit[3],         //HIT per lane
+    input int   hash_valid,     //hash stage valid
+    input int   hash[3][6],     //sample, jitter, jittered sample per lane
+    input int   ss_w_lg2,       //Subsample
+    input int   lanes           //lanes in use
+);
+
+// Same check, hits compared against a gold-ahead stream first
+import "DPI-C" function int check_sample_lanes_ahead(
+    input int   ctx,            //gold context
+    input int   stream,         //gold-ahead stream
+    input int   tri_v[6],       //triangle
+    input int   valid_samp,     //sample test stage valid
+    input int   sample[3][2],   //jittered SAMPLE per lane
+    input int   hit[3],         //HIT per lane
+    input int   hash_valid,     //hash stage valid
+    input int   hash[3][6],     //sample, jitter, jittered sample per lane
+    input int   ss_w_lg2,       //Subsample
+    input int   lanes           //lanes in use
+);
+
+// Sampled checking policy, see gold/rasterizer_sv_interface.h
+import "DPI-C" function int check_sample_policy(
+    input int   full_triangles, //triangles checked in full
+    input int   rate_per_mille, //share of the other samples checked
+    input int   seed            //sample choice
+);
+import "DPI-C" function int check_sample_policy_report();
+
+module smpl_lanes_sb
+#(
+    parameter SIGFIG = 24, // Bits in color and position.
+    parameter RADIX = 10, // Fraction bits in color and position
+    parameter VERTS = 3, // Maximum Vertices in triangle
+    parameter AXIS = 3, // Number of axis foreach vertex 3 is (x,y,z).
+    parameter COLORS = 3, // Number of color channels
+    parameter PIPE_DEPTH = 3, // Number of Pipe Stages in sample module
+    parameter LANES = 3, // Sample lanes (A, B, C)
+    parameter FILENAME = "sb_log/smpl_lanes_sb.log" // Log file name
+)
+(
+    input logic signed   [SIGFIG-1:0]   tri_R16S[VERTS-1:0][AXIS-1:0],  // 4 Sets X,Y Fixed Point Values
+    input logic                         validSamp_R16H,
+    input logic signed   [SIGFIG-1:0]   sample_R16S[1:0],
+    input logic signed   [SIGFIG-1:0]   sample_R16S_B[1:0],
+    input logic signed   [SIGFIG-1:0]   sample_R16S_C[1:0],
+
+    input logic                         clk,                // Clock
+    input logic                         rst,                // Reset
+    input int                           ctx,                // Gold context (zbuff.ctx)
+    input int                           gold_stream,        // Gold-ahead stream, -1 for none
+
+    input logic                         hit_valid_R18H,
+    input logic                         hit_valid_R18H_B,
+    input logic                         hit_valid_R18H_C,
+
+    input logic        [3:0]            subSample_RnnnnU,    // Flag for subsample
+
+    input logic signed [SIGFIG-1:0]     s_x_RnnS,
+    input logic signed [SIGFIG-1:0]     s_y_RnnS,
+    input logic signed [7:0]            jitter_x_RnnS,
+    input logic signed [7:0]            jitter_y_RnnS,
+    input logic signed [SIGFIG-1:0]     s_j_x_RnnS,
+    input logic signed [SIGFIG-1:0]     s_j_y_RnnS,
+    // multitest: sample b
+    input logic signed [SIGFIG-1:0]     s_x_RnnS_B,
+    input logic signed [SIGFIG-1:0]     s_y_RnnS_B,
+    input logic signed [7:0]            jitter_x_RnnS_B,
+    input logic signed [7:0]            jitter_y_RnnS_B,
+    input logic signed [SIGFIG-1:0]     s_j_x_RnnS_B,
+    input logic signed [SIGFIG-1:0]     s_j_y_RnnS_B,
+    // multitest: sample c
+    input logic signed [SIGFIG-1:0]     s_x_RnnS_C,
+    input logic signed [SIGFIG-1:0]     s_y_RnnS_C,
+    input logic signed [7:0]            jitter_x_RnnS_C,
+    input logic signed [7:0]            jitter_y_RnnS_C,
+    input logic signed [SIGFIG-1:0]     s_j_x_RnnS_C,
+    input logic signed [SIGFIG-1:0]     s_j_y_RnnS_C
+);
+
+    //Pipe Signals for Later Evaluation
+    logic signed   [SIGFIG-1:0] tri_RnnS[VERTS-1:0][AXIS-1:0];    // 4 Sets X,Y Fixed Point Values
+    logic                       validSamp_RnnH;
+    logic signed   [SIGFIG-1:0] sample_RnnS[1:0];
+    logic signed   [SIGFIG-1:0] sample_RnnS_B[1:0];
+    logic signed   [SIGFIG-1:0] sample_RnnS_C[1:0];
+    //Pipe Signals for Later Evaluation
+
+    //Helper Signals
+    int file;
+    int ss_w_lg2;
+    int errors;
+    string lane_name[3] = '{"A", "B", "C"};
+    //Helper Signals
+
+    //DPI Arguments
+    int tri_v[6];
+    int sample[3][2];
+    int hit[3];
+    int hash[3][6];
+    //DPI Arguments
+
+    //Sampled checking
+    int sample_full;
+    int sample_rate;
+    int sample_seed;
+
+    initial begin
+        file = $fopen(FILENAME,"w");
+        if( $value$plusargs("sample_rate=%d", sample_rate) ) begin
+            if( !$value$plusargs("sample_full=%d", sample_full) )
+                sample_full = 1000;
+            if( !$value$plusargs("sample_seed=%d", sample_seed) )
+                sample_seed = 1;
+            void'(check_sample_policy( sample_full, sample_rate, sample_seed ));
+        end
+    end
+
+    final begin
+        if( check_sample_policy_report() != 0 )
+            $display( "ERROR: sample test errors found re-checking triangles with bad hit counts" );
+    end
+
+    always_comb begin
+        unique case( 1'b1 )
+            ( subSample_RnnnnU[0] ): ss_w_lg2 = 3;
+            ( subSample_RnnnnU[1] ): ss_w_lg2 = 2;
+            ( subSample_RnnnnU[2] ): ss_w_lg2 = 1;
+            ( subSample_RnnnnU[3] ): ss_w_lg2 = 0;
+        endcase
+    end
+
+    //Check all lanes' hash and sample test in one call
+    always @(posedge clk) begin
+        #100;
+        if( ~rst ) begin
+            tri_v = '{ int'(tri_RnnS[0][0]), int'(tri_RnnS[0][1]),
+                       int'(tri_RnnS[1][0]), int'(tri_RnnS[1][1]),
+                       int'(tri_RnnS[2][0]), int'(tri_RnnS[2][1]) };
+
+            sample = '{ '{ int'(sample_RnnS[0]),   int'(sample_RnnS[1])   },
+                        '{ int'(sample_RnnS_B[0]), int'(sample_RnnS_B[1]) },
+                        '{ int'(sample_RnnS_C[0]), int'(sample_RnnS_C[1]) } };
+
+            hit = '{ int'(hit_valid_R18H), int'(hit_valid_R18H_B), int'(hit_valid_R18H_C) };
+
+            hash = '{ '{ int'(s_x_RnnS),   int'(s_y_RnnS),   int'(jitter_x_RnnS),
+                         int'(jitter_y_RnnS),   int'(s_j_x_RnnS),   int'(s_j_y_RnnS)   },
+                      '{ int'(s_x_RnnS_B), int'(s_y_RnnS_B), int'(jitter_x_RnnS_B),
+                         int'(jitter_y_RnnS_B), int'(s_j_x_RnnS_B), int'(s_j_y_RnnS_B) },
+                      '{ int'(s_x_RnnS_C), int'(s_y_RnnS_C), int'(jitter_x_RnnS_C),
+                         int'(jitter_y_RnnS_C), int'(s_j_x_RnnS_C), int'(s_j_y_RnnS_C) } };
+
+            if( gold_stream >= 0 )
+                errors = check_sample_lanes_ahead( ctx, gold_stream, tri_v, int'(validSamp_RnnH),
+                                                   sample, hit, 1, hash, ss_w_lg2, LANES );
+            else
+                errors = check_sample_lanes_ctx( ctx, tri_v, int'(validSamp_RnnH), sample, hit,
+                                                 1, hash, ss_w_lg2, LANES );
+
+            for( int lane = 0 ; lane < LANES ; lane++ ) begin
+                if( errors[8+lane] ) begin
+                    $fwrite( file , "@%0t: Hash ERROR on lane %s!!!!\n" , $time, lane_name[lane] );
+                    assert( 0 ) else $error( "time=%10t ERROR: Hash check failed on lane %s", $time, lane_name[lane] );
+                end
+
+                if( errors[lane] ) begin
+                    $fwrite( file , "@%0t: Sample Test ERROR on lane %s!!!!\n\t\t" , $time, lane_name[lane] );
+                    $fwrite( file , "uP.v_0.x: %f\t" , (1.0 * tri_RnnS[0][0]) / (1 << RADIX));
+                    $fwrite( file , "uP.v_0.y: %f\t" , (1.0 * tri_RnnS[0][1]) / (1 << RADIX));
+                    $fwrite( file , "uP.v_1.x: %f\t" , (1.0 * tri_RnnS[1][0]) / (1 << RADIX));
+                    $fwrite( file , "uP.v_1.y: %f\t" , (1.0 * tri_RnnS[1][1]) / (1 << RADIX));
+
+                    $fwrite( file , "\n\t\t" );
+                    $fwrite( file , "uP.v_2.x: %f\t" , (1.0 * tri_RnnS[2][0]) / (1 << RADIX));
+                    $fwrite( file , "uP.v_2.y: %f\t" , (1.0 * tri_RnnS[2][1]) / (1 << RADIX));
+
+                    $fwrite( file , "\n\t\t" );
+
+                    $fwrite( file , "sample.x:%f\t",  (1.0 * sample[lane][0]) / (1 << RADIX));
+                    $fwrite( file , "sample.y:%f\t",  (1.0 * sample[lane][1]) / (1 << RADIX));
+                    $fwrite( file , "hit:%b\n" , hit[lane] );
+
+                    assert( 0 ) else $error( "time=%10t ERROR: Sample Test Check Failed on lane %s", $time, lane_name[lane] );
+                end
+            end
+        end
+    end
+
+/* Pipe Required Signals */
+    dff3 #(
+        .WIDTH          (SIGFIG     ),
+        .ARRAY_SIZE1    (VERTS      ),
+        .ARRAY_SIZE2    (AXIS       ),
+        .PIPE_DEPTH     (PIPE_DEPTH ),
+        .RETIME_STATUS  (0          )
+    )
+    d_01
+    (
+        .clk    (clk        ),
+        .reset  (rst        ),
+        .en     (1'b1       ),
+        .in     (tri_R16S   ),
+        .out    (tri_RnnS   )
+    );
+
+    dff2 #(
+        .WIDTH          (SIGFIG     ),
+        .ARRAY_SIZE     (2          ),
+        .PIPE_DEPTH     (PIPE_DEPTH ),
+        .RETIME_STATUS  (0          )
+    )
+    d_03
+    (
+        .clk    (clk        ),
+        .reset  (rst        ),
+        .en     (1'b1       ),
+        .in     (sample_R16S),
+        .out    (sample_RnnS)
+    );
+
+    dff2 #(
+        .WIDTH          (SIGFIG     ),
+        .ARRAY_SIZE     (2          ),
+        .PIPE_DEPTH     (PIPE_DEPTH ),
+        .RETIME_STATUS  (0          )
+    )
+    d_03_B
+    (
+        .clk    (clk            ),
+        .reset  (rst            ),
+        .en     (1'b1           ),
+        .in     (sample_R16S_B  ),
+        .out    (sample_RnnS_B  )
+    );
+
+    dff2 #(
+        .WIDTH          (SIGFIG     ),
+        .ARRAY_SIZE     (2          ),
+        .PIPE_DEPTH     (PIPE_DEPTH ),
+        .RETIME_STATUS  (0          )
+    )
+    d_03_C
+    (
+        .clk    (clk            ),
+        .reset  (rst            ),
+        .en     (1'b1           ),
+        .in     (sample_R16S_C  ),
+        .out    (sample_RnnS_C  )
+    );
+
+    dff #(
+        .WIDTH          (1          ),
+        .PIPE_DEPTH     (PIPE_DEPTH ),
+        .RETIME_STATUS  (0          ) // No retime
+    )
+    d_04
+    (
+        .clk    (clk            ),
+        .reset  (rst            ),
+        .en     (1'b1           ),
+        .in     (validSamp_R16H ),
+        .out    (validSamp_RnnH )
+    );
+
+/* Pipe Required Signals */
+
+endmodule
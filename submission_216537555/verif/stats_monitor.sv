@@ -0,0 +1,65 @@
+/*
+ * Statistics monitor
+ *
+ * Hands the handshake signals of rast to the per-triangle statistics
+ * collector in gold/rast_stats.cpp every clock. Off unless the run has
+ * +rast_stats=<prefix>; the collector writes <prefix>.csv and
+ * <prefix>.json at the end of the simulation.
+ */
+
+// Statistics collector, see gold/rast_stats.h
+import "DPI-C" function int rast_stats_open( input string prefix, input int pipes_box,
+                                             input int pipes_hash, input int pipes_samp );
+import "DPI-C" function void rast_stats_cycle( input int stats, input int signals );
+import "DPI-C" function int rast_stats_close( input int stats );
+
+module stats_monitor
+#(
+    parameter PIPES_BOX = 3, // Number of Pipe Stages in bbox module
+    parameter PIPES_HASH = 2, // Number of pipe stages in hash module
+    parameter PIPES_SAMP = 4 // Number of Pipe Stages in sample module
+)
+(
+    input logic clk,                // Clock
+    input logic rst,                // Reset
+
+    input logic validTri_R10H,      // Triangle offered to bbox
+    input logic halt_RnnnnL,        // bbox may advance
+    input logic validTri_R13H,      // Box offered to the iterator
+    input logic validSamp_R14H,     // Iterator sample
+    input logic validSamp_R16H,     // Lane A sample at sampletest
+    input logic validSamp_R16H_B,   // multitest: sample b
+    input logic validSamp_R16H_C,   // multitest: sample c
+    input logic hit_valid_R18H,
+    input logic hit_valid_R18H_B,
+    input logic hit_valid_R18H_C
+);
+
+    // Bits as RAST_STATS_* in gold/rast_stats.h
+    logic [10:0] signals;
+    assign signals = { hit_valid_R18H_C, hit_valid_R18H_B, hit_valid_R18H,
+                       validSamp_R16H_C, validSamp_R16H_B, validSamp_R16H,
+                       validSamp_R14H, validTri_R13H, halt_RnnnnL, validTri_R10H, rst };
+
+    int    stats = -1;
+    string stats_prefix;
+
+    initial begin
+        if ($value$plusargs("rast_stats=%s", stats_prefix)) begin
+            stats = rast_stats_open(stats_prefix, PIPES_BOX, PIPES_HASH, PIPES_SAMP);
+        end
+    end
+
+    always @(posedge clk) begin
+        if (stats >= 0) begin
+            rast_stats_cycle(stats, int'(signals));
+        end
+    end
+
+    final begin
+        if (stats >= 0) begin
+            void'(rast_stats_close(stats));
+        end
+    end
+
+endmodule
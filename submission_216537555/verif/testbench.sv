@@ -178,7 +178,7 @@ module testbench
         .subSample_RnnnnU   (subSample_RnnnnU                   )  // Flag for subsample
     );
 
-    smpl_sb #(
+    smpl_lanes_sb #(
         .SIGFIG     (SIGFIG     ),
         .RADIX      (RADIX      ),
         .VERTS      (VERTS      ),
@@ -186,92 +186,23 @@ module testbench
         .COLORS     (COLORS     ),
         .PIPE_DEPTH (PIPES_SAMP )
     )
-    smpl_sb
-    (
-        .tri_R16S       (top_rast.rast.tri_R16S         ), // 4 Sets X,Y Fixed Point Values
-        .color_R16U     (top_rast.rast.color_R16U       ), // triangle Color
-        .validSamp_R16H (top_rast.rast.validSamp_R16H   ),
-        .sample_R16S    (top_rast.rast.sample_R16S      ), // Will change for JIT -todo
-
-        .clk            (clk                            ), // Clock
-        .rst            (rst                            ), // Reset
-
-        .hit_R18S       (hit_R18S                       ),
-        .color_R18U     (color_R18U                     ), // triangle Color
-        .hit_valid_R18H (hit_valid_R18H                 )
-    );
-    // multitest: sample b
-    smpl_sb #(
-        .SIGFIG     (SIGFIG     ),
-        .RADIX      (RADIX      ),
-        .VERTS      (VERTS      ),
-        .AXIS       (AXIS       ),
-        .COLORS     (COLORS     ),
-        .PIPE_DEPTH (PIPES_SAMP )
-    )
-    smpl_sb_B
-    (
-        .tri_R16S       (top_rast.rast.tri_R16S         ), // 4 Sets X,Y Fixed Point Values
-        .color_R16U     (top_rast.rast.color_R16U       ), // triangle Color
-        .validSamp_R16H (top_rast.rast.validSamp_R16H   ),
-        .sample_R16S    (top_rast.rast.sample_R16S_B      ), // Will change for JIT -todo
-
-        .clk            (clk                            ), // Clock
-        .rst            (rst                            ), // Reset
-
-        .hit_R18S       (hit_R18S_B                       ),
-        .color_R18U     (color_R18U_B                     ), // triangle Color
-        .hit_valid_R18H (hit_valid_R18H_B                 )
-    );
-    // multitest: sample c
-    smpl_sb #(
-        .SIGFIG     (SIGFIG     ),
-        .RADIX      (RADIX      ),
-        .VERTS      (VERTS      ),
-        .AXIS       (AXIS       ),
-        .COLORS     (COLORS     ),
-        .PIPE_DEPTH (PIPES_SAMP )
-    )
-    smpl_sb_C
-    (
-        .tri_R16S       (top_rast.rast.tri_R16S         ), // 4 Sets X,Y Fixed Point Values
-        .color_R16U     (top_rast.rast.color_R16U       ), // triangle Color
-        .validSamp_R16H (top_rast.rast.validSamp_R16H   ),
-        .sample_R16S    (top_rast.rast.sample_R16S_C      ), // Will change for JIT -todo
-
-        .clk            (clk                            ), // Clock
-        .rst            (rst                            ), // Reset
-
-        .hit_R18S       (hit_R18S_C                       ),
-        .color_R18U     (color_R18U_C                     ), // triangle Color
-        .hit_valid_R18H (hit_valid_R18H_C                 )
-    );
-
-    smpl_cnt_sb #(
-        .SIGFIG     (SIGFIG         ),
-        .RADIX      (RADIX          ),
-        .VERTS      (VERTS          ),
-        .AXIS       (AXIS           ),
-        .COLORS     (COLORS         ),
-        .PIPE_DEPTH (PIPES_SAMP + 1 )
-    )
-    smpl_cnt_sb
+    smpl_lanes_sb
     (
         .tri_R16S           (top_rast.rast.tri_R16S         ), // 4 Sets X,Y Fixed Point Values
-        .color_R16U         (top_rast.rast.color_R16U       ), // triangle Color
         .validSamp_R16H     (top_rast.rast.validSamp_R16H   ),
-        .sample_R16S        (top_rast.rast.sample_R16S      ), // Will change for JIT -todo
+        .sample_R16S        (top_rast.rast.sample_R16S      ),
+        .sample_R16S_B      (top_rast.rast.sample_R16S_B    ), // multitest: sample b
+        .sample_R16S_C      (top_rast.rast.sample_R16S_C    ), // multitest: sample c
 
         .clk                (clk                            ), // Clock
         .rst                (rst                            ), // Reset
+        .ctx                (zbuff.ctx                      ), // Gold context
+        .gold_stream        (rast_driver.gold_stream        ), // Gold-ahead stream
 
-        .hit_R18S           (hit_R18S                       ),
-        .color_R18U         (color_R18U                     ), // triangle Color
         .hit_valid_R18H     (hit_valid_R18H                 ),
         .hit_valid_R18H_B   (hit_valid_R18H_B               ), // multitest: sample b
         .hit_valid_R18H_C   (hit_valid_R18H_C               ), // multitest: sample c
 
-        .screen_RnnnnS      (screen_RnnnnS                  ), // Screen Size
         .subSample_RnnnnU   (subSample_RnnnnU               ), // Flag for subsample
 
         .s_x_RnnS           (top_rast.rast.hash_jtree.sample_R14S[0]        ),
@@ -296,6 +227,34 @@ module testbench
         .s_j_y_RnnS_C         (top_rast.rast.hash_jtree_C.sample_jitted_R14S[1] )
     );
 
+    smpl_cnt_sb #(
+        .SIGFIG     (SIGFIG         ),
+        .RADIX      (RADIX          ),
+        .VERTS      (VERTS          ),
+        .AXIS       (AXIS           ),
+        .COLORS     (COLORS         ),
+        .PIPE_DEPTH (PIPES_SAMP + 1 )
+    )
+    smpl_cnt_sb
+    (
+        .tri_R16S           (top_rast.rast.tri_R16S         ), // 4 Sets X,Y Fixed Point Values
+        .color_R16U         (top_rast.rast.color_R16U       ), // triangle Color
+        .validSamp_R16H     (top_rast.rast.validSamp_R16H   ),
+        .sample_R16S        (top_rast.rast.sample_R16S      ), // Will change for JIT -todo
+
+        .clk                (clk                            ), // Clock
+        .rst                (rst                            ), // Reset
+
+        .hit_R18S           (hit_R18S                       ),
+        .color_R18U         (color_R18U                     ), // triangle Color
+        .hit_valid_R18H     (hit_valid_R18H                 ),
+        .hit_valid_R18H_B   (hit_valid_R18H_B               ), // multitest: sample b
+        .hit_valid_R18H_C   (hit_valid_R18H_C               ), // multitest: sample c
+
+        .screen_RnnnnS      (screen_RnnnnS                  ), // Screen Size
+        .subSample_RnnnnU   (subSample_RnnnnU               )  // Flag for subsample
+    );
+
 
     /*****************************************
     *
@@ -328,6 +287,32 @@ module testbench
         .hit_valid_R18H_C (hit_valid_R18H_C           ) // multitest: sample c
     );
 
+    stats_monitor #(
+        .PIPES_BOX  (PIPES_BOX  ),
+        .PIPES_HASH (PIPES_HASH ),
+        .PIPES_SAMP (PIPES_SAMP )
+    )
+    stats_mon
+    (
+        .clk                (clk                            ), // Clock
+        .rst                (rst                            ), // Reset
+
+        .validTri_R10H      (validTri_R10H                  ),
+        .halt_RnnnnL        (top_rast.rast.halt_RnnnnL      ),
+        .validTri_R13H      (top_rast.rast.validTri_R13H    ),
+        .validSamp_R14H     (top_rast.rast.validSamp_R14H   ),
+        .validSamp_R16H     (top_rast.rast.validSamp_R16H   ),
+        .validSamp_R16H_B   (top_rast.rast.validSamp_R16H_B ), // multitest: sample b
+        .validSamp_R16H_C   (top_rast.rast.validSamp_R16H_C ), // multitest: sample c
+        .hit_valid_R18H     (hit_valid_R18H                 ),
+        .hit_valid_R18H_B   (hit_valid_R18H_B               ), // multitest: sample b
+        .hit_valid_R18H_C   (hit_valid_R18H_C               )  // multitest: sample c
+    );
+
+    // Mid-test checkpoints, +zbuff_checkpoint_every=<n>
+    always @(rast_driver.checkpoint)
+        zbuff.checkpoint(rast_driver.mark_triangles, rast_driver.mark_tag);
+
    /*****************************************
     * Main simulation task
     *****************************************/
@@ -346,6 +331,8 @@ module testbench
         repeat (15) @(posedge clk);
 
         zbuff.init_buffers();
+        rast_driver.skip = zbuff.restored; // resuming from +zbuff_restore
+        rast_driver.skip_tag = zbuff.restored_tag;
         repeat (15) @(posedge clk);
 
         $display("time=%10t ************** Runnning Test *****************", $time);
@@ -366,6 +353,9 @@ module testbench
             $toggle_stop(); //activity factor extraction end
         end
 
+        smpl_cnt_sb.sync_hit_count();
+
+        zbuff.checkpoint(rast_driver.mark_triangles, rast_driver.mark_tag);
         zbuff.write_image();
 
         if ($test$plusargs("af")) begin
@@ -123,6 +123,10 @@ module testbench_magma
         .hit_valid_R18H     (hit_valid_R18H     ) //Is sample hit valid
     );
 
+    // Mid-test checkpoints, +zbuff_checkpoint_every=<n>
+    always @(rast_driver.checkpoint)
+        zbuff.checkpoint(rast_driver.mark_triangles, rast_driver.mark_tag);
+
     /*****************************************
      * Main simulation task
      *****************************************/
@@ -141,6 +145,8 @@ module testbench_magma
         repeat (15) @(posedge clk);
 
         zbuff.init_buffers();
+        rast_driver.skip = zbuff.restored; // resuming from +zbuff_restore
+        rast_driver.skip_tag = zbuff.restored_tag;
         repeat (15) @(posedge clk);
 
         $display("time=%10t ************** Runnning Test *****************", $time);
@@ -161,6 +167,7 @@ module testbench_magma
             $toggle_stop(); //activity factor extraction end
         end
 
+        zbuff.checkpoint(rast_driver.mark_triangles, rast_driver.mark_tag);
         zbuff.write_image();
 
         if ($test$plusargs("af")) begin
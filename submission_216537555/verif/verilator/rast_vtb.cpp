@@ -0,0 +1,384 @@
+#include "Vrast.h"
+#include "verilated.h"
+#if VM_TRACE
+#include "verilated_fst_c.h"
+#endif
+
+#include "helper.h"
+extern "C"{
+#include "rasterizer.h"
+#include "rast_types.h"
+#include "zbuff.h"
+}
+
+#include <chrono>
+#include <deque>
+#include <memory>
+
+/*
+
+   Rast Verilator Testbench
+     C++ top for a Verilator build of rast, in place of
+     verif/testbench.sv when no commercial simulator is around.
+
+     Triangles come from the vector through load_triangle_line
+     and are driven like rast_driver does: one line per cycle
+     while halt_RnnnnL is high. Every triangle is rasterized by
+     the gold model as it goes in, and every RTL fragment is
+     checked in the cycle it comes out:
+       - it must hit (jittered sample_test_setup, the test the
+         gold hit count is taken with) a triangle in flight
+         with its depth and color, the oldest one still short of
+         its gold hit count if several do; older triangles are
+         then done and their hit counts are compared with the
+         gold model
+       - it is resolved into a z-buffer exactly like zbuff.sv,
+         which is compared with the gold z-buffer at the end
+
+     Build and run with verif/verilator/run-verilator.sh, which
+     verilates rtl/vlog.vf with --threads and, for TRACE=1,
+     --trace-fst.
+
+     Usage:
+       Vrast [--fst <wave.fst>] [--out <image.ppm>] <vector> [+verilator+...]
+*/
+
+#define VTB_SIGFIG 24          // rast_params SIGFIG
+#define VTB_RADIX 10           // rast_params RADIX
+#define VTB_FB_L2 11           // zbuff.sv FB_L2
+#define VTB_RESET_CYCLES 45    // as verif/testbench.sv
+#define VTB_DRAIN_CYCLES 15    // after the driver is done, as verif/testbench.sv
+#define VTB_STALL_CYCLES 10000000 // halted this long: the design is hung
+#define VTB_MAX_REPORT 10      // errors printed per kind
+
+typedef struct {
+  Triangle      triangle;
+  TriangleSetup setup;    // shared by the gold hit count and produces
+  long          line;      // in the vector, for messages
+  int           expected; // gold hit count
+  int           hits;     // RTL fragments attributed so far
+} InFlight;
+
+typedef struct {
+  Screen screen;
+  Config config;
+  ZBuff* rtl_z;
+  ZBuff* gold_z;
+
+  deque<InFlight> flight;  // valid triangles driven, oldest first
+
+  uint64_t cycles;
+  long     triangles;
+  uint64_t fragments;
+  uint64_t bad_fragments;  // no triangle in flight produces them
+  long     bad_counts;     // triangles with the wrong number of hits
+} Checker;
+
+static inline int sext( IData v )
+{
+  return (int)( v << ( 32 - VTB_SIGFIG ) ) >> ( 32 - VTB_SIGFIG );
+}
+
+static inline IData field( int v )
+{
+  return (IData)v & ( ( 1u << VTB_SIGFIG ) - 1 );
+}
+
+// Triangle retired: the RTL is past it, its hit count is final
+static void retire( Checker& c )
+{
+  InFlight& t = c.flight.front();
+  if( t.hits != t.expected ){
+    if( c.bad_counts++ < VTB_MAX_REPORT )
+      printf( "[ERROR] line %ld: RTL hits %d, gold hits %d\n", t.line, t.hits, t.expected );
+  }
+  c.flight.pop_front();
+}
+
+static bool produces( const Checker& c, const InFlight& t, Sample sample, uint depth,
+                      const uint* color )
+{
+  const ColorVertex3D& v0 = t.triangle.v[0];
+  if( ( (uint)v0.z & ( ( 1u << VTB_SIGFIG ) - 1 ) ) != depth )
+    return false;
+  if( v0.R != (ushort)color[0] || v0.G != (ushort)color[1] || v0.B != (ushort)color[2] )
+    return false;
+
+  Sample jitter = jitter_sample( sample, c.config.ss_w_lg2 );
+  Sample jittered;
+  jittered.x = sample.x + ( jitter.x << 2 );
+  jittered.y = sample.y + ( jitter.y << 2 );
+  return sample_test_setup( &t.setup, jittered );
+}
+
+static void check_fragment( Checker& c, const IData* hit, const IData* color_out )
+{
+  Sample sample;
+  sample.x = sext( hit[0] );
+  sample.y = sext( hit[1] );
+  uint depth = hit[2];
+  uint color[3] = { color_out[0], color_out[1], color_out[2] };
+
+  c.fragments++;
+
+  // Neighbors in a mesh share depth and color, so a sample they both
+  // cover goes to the oldest one still owed hits
+  size_t k = c.flight.size();
+  size_t first = c.flight.size();
+  for( size_t i = 0 ; i < c.flight.size() && k == c.flight.size() ; i++ ){
+    if( !produces( c, c.flight[i], sample, depth, color ) )
+      continue;
+    if( first == c.flight.size() )
+      first = i;
+    if( c.flight[i].hits < c.flight[i].expected )
+      k = i;
+  }
+  if( k == c.flight.size() )
+    k = first;
+
+  if( k == c.flight.size() ){
+    if( c.bad_fragments++ < VTB_MAX_REPORT )
+      printf( "[ERROR] cycle %llu: fragment (%d, %d) z=%06x color=%06x %06x %06x "
+              "matches no triangle in flight\n", (unsigned long long)c.cycles,
+              sample.x, sample.y, depth, color[0], color[1], color[2] );
+  } else {
+    for( ; k > 0 ; k-- )
+      retire( c );
+    c.flight.front().hits++;
+  }
+
+  // Resolve it like zbuff.sv does
+  int ss_shift = VTB_RADIX - c.config.ss_w_lg2;
+  Sample pixel;
+  pixel.x = ( sample.x >> VTB_RADIX ) & ( ( 1 << VTB_FB_L2 ) - 1 );
+  pixel.y = ( sample.y >> VTB_RADIX ) & ( ( 1 << VTB_FB_L2 ) - 1 );
+  Sample subsample;
+  subsample.x = ( sample.x >> ss_shift ) & ( c.config.ss_w - 1 );
+  subsample.y = ( sample.y >> ss_shift ) & ( c.config.ss_w - 1 );
+
+  Fragment f;
+  f.z = depth;
+  f.R = color[0];
+  f.G = color[1];
+  f.B = color[2];
+  process_fragment( c.rtl_z, pixel, subsample, f );
+}
+
+struct Bench {
+  unique_ptr<VerilatedContext> context;
+  unique_ptr<Vrast>            top;
+#if VM_TRACE
+  VerilatedFstC*               fst = NULL;
+#endif
+  Checker                      check;
+};
+
+// One clock; the hits are taken after the rising edge, as zbuff.sv does
+static void tick( Bench& b )
+{
+  Vrast* top = b.top.get();
+
+  top->clk = 1;
+  top->eval();
+  b.context->timeInc( 1 );
+#if VM_TRACE
+  if( b.fst )
+    b.fst->dump( b.context->time() );
+#endif
+
+  if( !top->rst ){
+    if( top->hit_valid_R18H )
+      check_fragment( b.check, &top->hit_R18S[0], &top->color_R18U[0] );
+    if( top->hit_valid_R18H_B )
+      check_fragment( b.check, &top->hit_R18S_B[0], &top->color_R18U_B[0] );
+    if( top->hit_valid_R18H_C )
+      check_fragment( b.check, &top->hit_R18S_C[0], &top->color_R18U_C[0] );
+  }
+
+  top->clk = 0;
+  top->eval();
+  b.context->timeInc( 1 );
+#if VM_TRACE
+  if( b.fst )
+    b.fst->dump( b.context->time() );
+#endif
+
+  b.check.cycles++;
+}
+
+static void wait_unhalted( Bench& b )
+{
+  uint64_t stalled = 0;
+  while( !b.top->halt_RnnnnL ){
+    if( stalled++ == VTB_STALL_CYCLES )
+      abort_( "rast halted for %d cycles at cycle %llu", VTB_STALL_CYCLES,
+              (unsigned long long)b.check.cycles );
+    tick( b );
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const char* file_in = NULL;
+  const char* file_out = NULL;
+  const char* fst_file = NULL;
+
+  for( int i = 1 ; i < argc ; i++ ){
+    if( argv[i][0] == '+' )
+      continue; // +verilator+ options, see commandArgs
+    if( !strcmp( argv[i], "--out" ) && i + 1 < argc )
+      file_out = argv[++i];
+    else if( !strcmp( argv[i], "--fst" ) && i + 1 < argc )
+      fst_file = argv[++i];
+    else
+      file_in = argv[i];
+  }
+  if( file_in == NULL )
+    abort_( "Usage: Vrast [--fst <wave.fst>] [--out <image.ppm>] <vector>" );
+
+  ifstream myfile( file_in );
+  if( !myfile.is_open() )
+    abort_( "Failed to Open Vector File for Read" );
+
+  Bench b;
+  Checker& c = b.check;
+  load_header( myfile, c.screen, c.config );
+  c.config.r_shift = VTB_RADIX;
+  c.rtl_z = zbuff_init( c.screen, c.config );
+  c.gold_z = zbuff_init( c.screen, c.config );
+  c.cycles = 0;
+  c.triangles = 0;
+  c.fragments = 0;
+  c.bad_fragments = 0;
+  c.bad_counts = 0;
+
+  b.context.reset( new VerilatedContext );
+  b.context->commandArgs( argc, argv );
+#if VM_TRACE
+  if( fst_file )
+    b.context->traceEverOn( true );
+#else
+  if( fst_file )
+    printf( "[WARNING] built without --trace-fst, %s is not written\n", fst_file );
+#endif
+  b.top.reset( new Vrast( b.context.get() ) );
+#if VM_TRACE
+  if( fst_file ){
+    b.fst = new VerilatedFstC;
+    b.top->trace( b.fst, 99 );
+    b.fst->open( fst_file );
+  }
+#endif
+
+  Vrast* top = b.top.get();
+  top->clk = 0;
+  top->rst = 1;
+  top->validTri_R10H = 0;
+  top->screen_RnnnnS[0] = field( c.screen.width );
+  top->screen_RnnnnS[1] = field( c.screen.height );
+  top->subSample_RnnnnU = 8 >> c.config.ss_w_lg2;
+  top->eval();
+
+  for( int i = 0 ; i < VTB_RESET_CYCLES ; i++ )
+    tick( b );
+  top->rst = 0;
+
+  // a couple of cycles for the design to learn the parameters
+  tick( b );
+  tick( b );
+
+  auto start = chrono::steady_clock::now();
+
+  TriangleLine tl;
+  long line = 3; // after the JB21 and screen lines
+  while( load_triangle_line( myfile, tl ) ){
+    if( tl.vertices != 3 )
+      abort_( "Error: Input contains triangle pairs, should only contain singles at line %ld", line );
+
+    wait_unhalted( b );
+
+    top->validTri_R10H = tl.valid != 0;
+    for( int v = 0 ; v < 3 ; v++ )
+      for( int a = 0 ; a < 3 ; a++ )
+        top->tri_R10S[v][a] = field( tl.v[v][a] );
+    for( int k = 0 ; k < 3 ; k++ )
+      top->color_R10U[k] = field( tl.color[k] );
+
+    if( tl.valid ){
+      InFlight t;
+      for( int v = 0 ; v < 3 ; v++ ){
+        t.triangle.v[v].x = tl.v[v][0];
+        t.triangle.v[v].y = tl.v[v][1];
+        t.triangle.v[v].z = tl.v[v][2];
+        t.triangle.v[v].R = tl.color[0];
+        t.triangle.v[v].G = tl.color[1];
+        t.triangle.v[v].B = tl.color[2];
+      }
+      t.line = line;
+      t.hits = 0;
+      t.setup = triangle_setup( t.triangle );
+      t.expected = rasterize_triangle_setup( t.triangle, &t.setup, c.gold_z, c.screen, c.config );
+      c.flight.push_back( t );
+      c.triangles++;
+    }
+
+    tick( b );
+    line++;
+  }
+  myfile.close();
+
+  // stop stressing the design and let it drain, as rast_driver does
+  top->validTri_R10H = 0;
+  for( int i = 0 ; i < 4 ; i++ ){
+    wait_unhalted( b );
+    tick( b );
+    tick( b );
+  }
+  for( int i = 0 ; i < 10 ; i++ )
+    tick( b );
+  for( int i = 0 ; i < VTB_DRAIN_CYCLES ; i++ )
+    tick( b );
+
+  while( !c.flight.empty() )
+    retire( c );
+
+  double seconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+
+  // Compare the resolved images
+  uchar* rtl_img = eval_all_ss( c.rtl_z );
+  uchar* gold_img = eval_all_ss( c.gold_z );
+  long bad_pixels = 0;
+  for( long p = 0 ; p < (long)c.rtl_z->w * c.rtl_z->h ; p++ ){
+    if( memcmp( &rtl_img[3 * p], &gold_img[3 * p], 3 ) ){
+      if( bad_pixels++ < VTB_MAX_REPORT )
+        printf( "[ERROR] pixel (%ld, %ld): RTL %02x%02x%02x, gold %02x%02x%02x\n",
+                p % c.rtl_z->w, p / c.rtl_z->w,
+                rtl_img[3 * p], rtl_img[3 * p + 1], rtl_img[3 * p + 2],
+                gold_img[3 * p], gold_img[3 * p + 1], gold_img[3 * p + 2] );
+    }
+  }
+  free( rtl_img );
+  free( gold_img );
+
+  if( file_out )
+    write_ppm( c.rtl_z, (char*)file_out );
+
+  top->final();
+#if VM_TRACE
+  if( b.fst ){
+    b.fst->close();
+    delete b.fst;
+  }
+#endif
+
+  printf( "\nTriangles: %ld  Fragments: %llu  Cycles: %llu  (%.2f s, %.0f cycles/s)\n",
+          c.triangles, (unsigned long long)c.fragments, (unsigned long long)c.cycles,
+          seconds, seconds > 0 ? c.cycles / seconds : 0.0 );
+  printf( "Errors: %llu fragments, %ld hit counts, %ld pixels\n",
+          (unsigned long long)c.bad_fragments, c.bad_counts, bad_pixels );
+
+  zbuff_free( c.rtl_z );
+  zbuff_free( c.gold_z );
+
+  return c.bad_fragments || c.bad_counts || bad_pixels ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+#!/bin/bash
+
+# Verilate rast with the C++ top in rast_vtb.cpp and run one vector
+#   run-verilator.sh <vector> [image.ppm]
+# THREADS=<n> verilates with --threads <n> (default 1)
+# TRACE=1 builds with FST waveforms and writes rast.fst
+# RTL_TRACE=1 builds with GENERATE_JSON and writes rtl_trace.bin
+
+cd "$(dirname "$0")/../.."
+ROOT=$PWD
+
+THREADS=${THREADS:-1}
+OBJ=verif/verilator/obj_dir_t$THREADS
+TRACE_FLAGS=""
+RUN_FLAGS=""
+if [ "$TRACE" = "1" ]; then
+    OBJ=${OBJ}_fst
+    TRACE_FLAGS="--trace-fst --trace-structs"
+    RUN_FLAGS="--fst rast.fst"
+fi
+RTL_TRACE_SRC=""
+if [ "$RTL_TRACE" = "1" ]; then
+    OBJ=${OBJ}_json
+    TRACE_FLAGS="$TRACE_FLAGS +define+GENERATE_JSON"
+    RTL_TRACE_SRC="gold/rtl_trace.cpp"
+fi
+mkdir -p $OBJ
+
+# the gold model's C files are built as C, like for rasterizer_gold
+gcc -O2 -c gold/rasterizer.c -o $OBJ/rasterizer.o || exit 1
+gcc -O2 -c gold/zbuff.c -o $OBJ/zbuff.o || exit 1
+
+verilator --cc --exe --build -j 0 -O3 --x-assign fast --x-initial fast \
+    -Wno-fatal --top-module rast --threads $THREADS $TRACE_FLAGS \
+    --Mdir $OBJ -o Vrast \
+    -CFLAGS "-O2 -I$ROOT/gold" \
+    -f rtl/vlog.vf \
+    verif/verilator/rast_vtb.cpp gold/helper.cpp $RTL_TRACE_SRC \
+    $ROOT/$OBJ/rasterizer.o $ROOT/$OBJ/zbuff.o || exit 1
+
+$OBJ/Vrast $RUN_FLAGS ${2:+--out $2} $1
@@ -46,11 +46,12 @@
  */
 
 
-import "DPI" pure function
-int check_zbuff_init(
-    int w,    //Screen Width
-    int h,    //Screen Width
-    int ss_w  //Subsample Width
+// Opens a gold context owned by this zbuff instance, returns its handle
+import "DPI-C" function
+int check_zbuff_open(
+    input int w,    //Screen Width
+    input int h,    //Screen Width
+    input int ss_w  //Subsample Width
 );
 
 import "DPI" pure function
@@ -65,8 +66,37 @@ int check_zbuff_process_fragment(
     int B   //actually a ushort
 );
 
-import "DPI" pure function
-int check_zbuff_write_ppm();
+// All lanes' fragments for one clock, applied in lane order
+import "DPI-C" function
+int check_zbuff_process_fragments_ctx(
+    input int ctx ,         //Gold context
+    input int valid ,       //Hit valid, one bit per lane
+    input int frag[3][8] ,  //[lane][x, y, ss_x, ss_y, d, R, G, B]
+    input int lanes         //Lanes in use
+);
+
+import "DPI-C" function
+int check_zbuff_write_ppm_ctx(
+    input int ctx ,         //Gold context
+    input string file_name  //Output image
+);
+
+// Z-buffer snapshots, see gold/zbuff.h
+import "DPI-C" function
+int check_zbuff_save_ctx(
+    input int ctx ,         //Gold context
+    input string file_name ,//Snapshot
+    input int triangles ,   //Triangles in the z-buffer
+    input longint tag ,     //Their tag
+    input int compress      //Run-length code it
+);
+
+import "DPI-C" function
+int check_zbuff_restore_ctx(
+    input int ctx ,         //Gold context
+    input string file_name ,//Snapshot
+    output longint tag      //Tag of the triangles it holds
+);
 
 
 module zbuff
@@ -225,48 +255,26 @@ module zbuff
 
     end
 
+    int ctx;  // gold context of this instance, from check_zbuff_open
+    int restored;  // triangles already in the z-buffer restored by +zbuff_restore
+    longint restored_tag; // their tag, rast_driver checks it against its vector
+    string snapshot_file;
+    int frag_valid;
+    int frag[3][8];
+
     always @(posedge clk) begin
         #25;
-        if( hit_valid_R18H && ~rst ) begin
-            check_zbuff_process_fragment(  x_ind ,   //Hit Loc. X
-                y_ind ,   //Hit Loc. Y
-                x_ss_ind ,  //SS Hit loc X
-                y_ss_ind ,  //SS Hit Loc Y
-                depth , //actually a uint
-                color[0] , //actually a ushort
-                color[1] , //actually a ushort
-                color[2]  //actually a ushort
-            ) ;
-        end
-    end
-    //multitest: sample b
-    always @(posedge clk) begin
-        #25;
-        if( hit_valid_R18H_B && ~rst ) begin
-            check_zbuff_process_fragment(  x_ind_B ,   //Hit Loc. X
-                y_ind_B ,   //Hit Loc. Y
-                x_ss_ind_B ,  //SS Hit loc X
-                y_ss_ind_B ,  //SS Hit Loc Y
-                depth_B , //actually a uint
-                color_B[0] , //actually a ushort
-                color_B[1] , //actually a ushort
-                color_B[2]  //actually a ushort
-            ) ;
-        end
-    end
-    //multitest: sample c
-    always @(posedge clk) begin
-        #25;
-        if( hit_valid_R18H_C && ~rst ) begin
-            check_zbuff_process_fragment(  x_ind_C ,   //Hit Loc. X
-                y_ind_C ,   //Hit Loc. Y
-                x_ss_ind_C ,  //SS Hit loc X
-                y_ss_ind_C ,  //SS Hit Loc Y
-                depth_C , //actually a uint
-                color_C[0] , //actually a ushort
-                color_C[1] , //actually a ushort
-                color_C[2]  //actually a ushort
-            ) ;
+        frag_valid = rst ? 0 : { hit_valid_R18H_C , hit_valid_R18H_B , hit_valid_R18H };
+        if( frag_valid != 0 ) begin
+            frag = '{ '{ x_ind ,   y_ind ,   x_ss_ind ,   y_ss_ind ,   depth ,
+                         color[0] ,   color[1] ,   color[2]   },
+                      //multitest: sample b
+                      '{ x_ind_B , y_ind_B , x_ss_ind_B , y_ss_ind_B , depth_B ,
+                         color_B[0] , color_B[1] , color_B[2] },
+                      //multitest: sample c
+                      '{ x_ind_C , y_ind_C , x_ss_ind_C , y_ss_ind_C , depth_C ,
+                         color_C[0] , color_C[1] , color_C[2] } };
+            check_zbuff_process_fragments_ctx( ctx , frag_valid , frag , 3 ) ;
         end
     end
 
@@ -275,11 +283,19 @@ module zbuff
         $display("time=%10t ************** Initializing FB and ZB *****************", $time);
         #10;
 
-        check_zbuff_init( x_max,    //Screen Width
+        ctx = check_zbuff_open( x_max,    //Screen Width
                 y_max,    //Screen Width
                 ss_max  //Subsample Width
                 );
 
+        // Resume from a checkpoint: the driver skips what it holds
+        restored = 0;
+        if ($value$plusargs("zbuff_restore=%s", snapshot_file)) begin
+            restored = check_zbuff_restore_ctx( ctx , snapshot_file , restored_tag );
+            assert (restored >= 0) else $fatal(2, "ERROR: Cannot restore z-buffer snapshot %s", snapshot_file);
+            $display("time=%10t ************** Restored %0d triangles from %s *****************", $time, restored, snapshot_file);
+        end
+
         $display("time=%10t ************** Finished Init FB and ZB *****************", $time);
     end
     endtask
@@ -291,7 +307,7 @@ module zbuff
         $display("time=%10t ************** Writing Final Image to File *****************", $time);
         #10;
 
-       check_zbuff_write_ppm( );
+       check_zbuff_write_ppm_ctx( ctx , "verif_out.ppm" );
         #10;
 
         $display("time=%10t ************** Finished Final Image to File *****************", $time);
@@ -299,5 +315,18 @@ module zbuff
     end
     endtask //write_image
 
+    // Save the z-buffer to +zbuff_checkpoint=<file> once the first
+    // triangles of the test are all in it; +zbuff_checkpoint_rle compresses.
+    // tag is rast_driver's tag of those triangles, as rasterizer_gold --resume keeps
+    task checkpoint(input int triangles, input longint tag);
+    begin
+        if ($value$plusargs("zbuff_checkpoint=%s", snapshot_file)) begin
+            assert (check_zbuff_save_ctx( ctx , snapshot_file , triangles , tag , $test$plusargs("zbuff_checkpoint_rle") ))
+                else $error("ERROR: Cannot save z-buffer snapshot %s", snapshot_file);
+            $display("time=%10t ************** Checkpoint of %0d triangles to %s *****************", $time, triangles, snapshot_file);
+        end
+    end
+    endtask //checkpoint
+
 endmodule
 